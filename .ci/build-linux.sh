@@ -13,6 +13,12 @@ CXX_COMPILER=$1
 rm -rf /gt/gtirb-pprinter/gtirb/build /gt/gtirb-pprinter/gtirb/CMakeCache.txt /gt/gtirb-pprinter/gtirb/CMakeFiles /gt/gtirb-pprinter/gtirb/CMakeScripts
 cd /gt/gtirb-pprinter/gtirb/ && cmake ./ -Bbuild -DCMAKE_CXX_COMPILER=$CXX_COMPILER && cd build &&  make && make install
 
+# Install the GTIRB Python API, which the tests use to build small IRs. The
+# tests that need it are skipped where it is not installed.
+if command -v pip3 > /dev/null && [ -d /gt/gtirb-pprinter/gtirb/build/python ]; then
+  pip3 install /gt/gtirb-pprinter/gtirb/build/python
+fi
+
 # Build gtirb-pprinter
 rm -rf /gt/gtirb-pprinter/build /gt/gtirb-pprinter/CMakeCache.txt /gt/gtirb-pprinter/CMakeFiles /gt/gtirb-pprinter/CMakeScripts
 mkdir -p /gt/gtirb-pprinter/build
@@ -0,0 +1,276 @@
+"""Fit the coefficients of gtirb_pprint::PrintCostModel to measured runs.
+
+    python3 benchmarks/calibrate_cost_model.py a.gtirb b.gtirb [more ...]
+
+For each module of each IR, the features the model reads (instructions,
+data bytes, blocks, symbols and symbolic expressions) are taken from
+gtirb-pprinter --estimate. The module is then printed to a file, its
+instructions are counted in a listing-json print, and its assembly is
+assembled with `as`. The time and peak memory of each process are read
+with wait4, and a run with --estimate, which loads the IR without printing
+it, gives the cost of loading. The median of --runs runs is kept.
+
+The coefficients are fitted by least squares through the origin and
+printed as the fields of PrintCostModel, ready to be pasted into
+PrettyPrinter.hpp or set on a PrintCostModel. Each fit needs more modules
+than it has coefficients, so use several IRs of different shapes. The
+linker's coefficients are not fitted: the linker runs inside
+gtirb-binary-printer, and its cost cannot be told apart from printing.
+"""
+import argparse
+import json
+import os
+import statistics
+import subprocess
+import tempfile
+import time
+from pathlib import Path
+
+
+def measure(args, stdout=subprocess.DEVNULL):
+    """Run args and return its wall time in seconds and its peak resident
+    set size in bytes."""
+    start = time.perf_counter()
+    process = subprocess.Popen(args, stdout=stdout)
+    _, status, usage = os.wait4(process.pid, 0)
+    seconds = time.perf_counter() - start
+    # The process is reaped here, so Popen must not wait for it.
+    process.returncode = os.WEXITSTATUS(status) if os.WIFEXITED(status) else 1
+    if process.returncode != 0:
+        raise subprocess.CalledProcessError(process.returncode, args)
+    # ru_maxrss is in kilobytes on Linux.
+    return seconds, usage.ru_maxrss * 1024
+
+
+def median_run(runs, args, stdout_path=None):
+    """Return the median time and peak memory of runs runs of args."""
+    results = []
+    for _ in range(runs):
+        if stdout_path is None:
+            results.append(measure(args))
+        else:
+            with open(stdout_path, "w") as out:
+                results.append(measure(args, out))
+    return (
+        statistics.median(r[0] for r in results),
+        statistics.median(r[1] for r in results),
+    )
+
+
+def estimates(ir):
+    """Return the estimate of each module of ir, and of the whole job."""
+    output = subprocess.check_output(
+        ["gtirb-pprinter", "--ir", str(ir), "--estimate"],
+        universal_newlines=True,
+    )
+    lines = [json.loads(line) for line in output.splitlines() if line]
+    return lines[:-1], lines[-1]
+
+
+def count_instructions(ir, module):
+    """Return the number of instructions printed for module, or None if
+    the listing cannot be printed for its format."""
+    result = subprocess.run(
+        [
+            "gtirb-pprinter",
+            "--ir",
+            str(ir),
+            "-m",
+            str(module),
+            "--syntax",
+            "listing-json",
+        ],
+        stdout=subprocess.PIPE,
+        stderr=subprocess.DEVNULL,
+        universal_newlines=True,
+    )
+    if result.returncode != 0:
+        return None
+    return result.stdout.count('"kind":"instruction"')
+
+
+def least_squares(rows, targets):
+    """Return the coefficients x minimizing |rows x - targets|, with no
+    constant term. A tiny ridge keeps features that always move together
+    from making the system singular."""
+    n = len(rows[0])
+    a = [[0.0] * n for _ in range(n)]
+    b = [0.0] * n
+    for row, target in zip(rows, targets):
+        for i in range(n):
+            b[i] += row[i] * target
+            for j in range(n):
+                a[i][j] += row[i] * row[j]
+    for i in range(n):
+        a[i][i] += 1e-9 * (a[i][i] or 1)
+    # Gaussian elimination with partial pivoting.
+    for col in range(n):
+        pivot = max(range(col, n), key=lambda r: abs(a[r][col]))
+        a[col], a[pivot] = a[pivot], a[col]
+        b[col], b[pivot] = b[pivot], b[col]
+        for r in range(col + 1, n):
+            factor = a[r][col] / a[col][col]
+            for c in range(col, n):
+                a[r][c] -= factor * a[col][c]
+            b[r] -= factor * b[col]
+    x = [0.0] * n
+    for i in reversed(range(n)):
+        x[i] = (b[i] - sum(a[i][j] * x[j] for j in range(i + 1, n))) / a[i][i]
+    return x
+
+
+def fit(name, samples, features, target, coefficients):
+    """Fit target from features over samples, and return the coefficients
+    by name. Skip the fit if there are too few samples."""
+    usable = [s for s in samples if s.get(target) is not None]
+    if len(usable) <= len(features):
+        print(
+            "# %s: %d modules measured, more than %d are needed"
+            % (name, len(usable), len(features))
+        )
+        return {}
+    rows = [[s[f] for f in features] for s in usable]
+    x = least_squares(rows, [s[target] for s in usable])
+    return dict(zip(coefficients, x))
+
+
+def ratio(samples, numerator, denominator):
+    """Return the ratio of the sums of two measures over samples."""
+    den = sum(s[denominator] for s in samples)
+    return sum(s[numerator] for s in samples) / den if den else None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("irs", nargs="+", help="GTIRB files to measure")
+    parser.add_argument("--runs", type=int, default=3)
+    parser.add_argument("--assembler", default="as")
+    args = parser.parse_args()
+
+    samples = []
+    loads = []
+    for ir in args.irs:
+        modules, _ = estimates(ir)
+        load_seconds, load_memory = median_run(
+            args.runs, ["gtirb-pprinter", "--ir", str(ir), "--estimate"]
+        )
+        loads.append(
+            {
+                "file_bytes": Path(ir).stat().st_size,
+                "seconds": load_seconds,
+                "memory": load_memory,
+            }
+        )
+        with tempfile.TemporaryDirectory() as out_dir:
+            for module in modules:
+                i = module["module"]
+                asm = Path(out_dir, "module%d.s" % i)
+                seconds, memory = median_run(
+                    args.runs,
+                    ["gtirb-pprinter", "--ir", str(ir), "-m", str(i)],
+                    asm,
+                )
+                as_seconds, as_memory = median_run(
+                    args.runs,
+                    [args.assembler, str(asm), "-o", str(asm) + ".o"],
+                )
+                instructions = count_instructions(ir, i)
+                sample = dict(module)
+                sample.update(
+                    {
+                        "blocks": module["code_blocks"]
+                        + module["data_blocks"],
+                        "measured_instructions": instructions,
+                        "measured_output_bytes": asm.stat().st_size,
+                        "print_seconds": max(seconds - load_seconds, 0),
+                        "print_memory": max(memory - load_memory, 0),
+                        "assemble_seconds": as_seconds,
+                        "assemble_memory": as_memory,
+                    }
+                )
+                samples.append(sample)
+                print(
+                    "# %s module %d: %d bytes in %.3f s, %d KB"
+                    % (
+                        ir,
+                        i,
+                        sample["measured_output_bytes"],
+                        seconds,
+                        memory // 1024,
+                    )
+                )
+
+    model = {}
+    counted = [s for s in samples if s["measured_instructions"]]
+    if counted:
+        model["bytesPerInstruction"] = ratio(
+            counted, "code_bytes", "measured_instructions"
+        )
+        # Fit the rest against the instructions that were printed.
+        for s in counted:
+            s["instructions"] = s["measured_instructions"]
+    model.update(
+        fit(
+            "output bytes",
+            samples,
+            [
+                "instructions",
+                "data_bytes",
+                "symbolic_expressions",
+                "symbols",
+                "blocks",
+            ],
+            "measured_output_bytes",
+            [
+                "outputBytesPerInstruction",
+                "outputBytesPerDataByte",
+                "outputBytesPerSymbolicExpression",
+                "outputBytesPerSymbol",
+                "outputBytesPerBlock",
+            ],
+        )
+    )
+    model.update(
+        fit(
+            "printer memory",
+            samples,
+            ["blocks", "symbols", "symbolic_expressions"],
+            "print_memory",
+            [
+                "memoryBytesPerBlock",
+                "memoryBytesPerSymbol",
+                "memoryBytesPerSymbolicExpression",
+            ],
+        )
+    )
+    model.update(
+        fit(
+            "printing time",
+            samples,
+            ["instructions", "data_bytes", "symbolic_expressions"],
+            "print_seconds",
+            [
+                "secondsPerInstruction",
+                "secondsPerDataByte",
+                "secondsPerSymbolicExpression",
+            ],
+        )
+    )
+    model["irMemoryPerFileByte"] = ratio(loads, "memory", "file_bytes")
+    model["loadSecondsPerFileByte"] = ratio(loads, "seconds", "file_bytes")
+    model["assembleMemoryPerOutputByte"] = ratio(
+        samples, "assemble_memory", "measured_output_bytes"
+    )
+    model["assembleSecondsPerOutputByte"] = ratio(
+        samples, "assemble_seconds", "measured_output_bytes"
+    )
+
+    print("struct PrintCostModel {")
+    for name, value in model.items():
+        if value is not None:
+            print("  double %s = %.3g;" % (name, value))
+    print("};")
+
+
+if __name__ == "__main__":
+    main()
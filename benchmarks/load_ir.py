@@ -0,0 +1,66 @@
+"""Compare loading an IR from a mapped file with loading it from a stream.
+
+    python3 benchmarks/load_ir.py big.gtirb [more.gtirb ...]
+
+gtirb-pprinter --estimate loads the IR and only counts what its modules
+hold, so its run time and peak memory are about those of the load. Each IR
+is loaded --runs times in each mode: given with --ir, it is mapped into
+memory by gtirb_pprint::loadIR; piped into the standard input, it is read
+through a stream. The median times and peak resident set sizes, read with
+wait4, are reported with one line per IR and mode. The pages of a mapped
+file count toward the peak while it is parsed.
+"""
+import argparse
+import os
+import statistics
+import subprocess
+import time
+
+
+def load(ir, mapped):
+    """Load ir once and return the time taken and the peak memory in
+    bytes."""
+    args = ["gtirb-pprinter", "--estimate"]
+    if mapped:
+        args += ["--ir", str(ir)]
+    with open(ir, "rb") as stdin:
+        start = time.perf_counter()
+        process = subprocess.Popen(
+            args,
+            stdin=subprocess.DEVNULL if mapped else stdin,
+            stdout=subprocess.DEVNULL,
+        )
+        _, status, usage = os.wait4(process.pid, 0)
+        seconds = time.perf_counter() - start
+    # The process is reaped here, so Popen must not wait for it.
+    process.returncode = os.WEXITSTATUS(status) if os.WIFEXITED(status) else 1
+    if process.returncode != 0:
+        raise subprocess.CalledProcessError(process.returncode, args)
+    # ru_maxrss is in kilobytes on Linux.
+    return seconds, usage.ru_maxrss * 1024
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("irs", nargs="+", help="GTIRB files to load")
+    parser.add_argument("--runs", type=int, default=5)
+    args = parser.parse_args()
+
+    print(
+        "%-40s %-8s %14s %10s %10s"
+        % ("ir", "mode", "bytes", "time (s)", "peak (MB)")
+    )
+    for ir in args.irs:
+        size = os.path.getsize(ir)
+        for mode, mapped in [("mapped", True), ("stream", False)]:
+            runs = [load(ir, mapped) for _ in range(args.runs)]
+            seconds = statistics.median(s for s, _ in runs)
+            peak = statistics.median(m for _, m in runs)
+            print(
+                "%-40s %-8s %14d %10.3f %10.1f"
+                % (ir, mode, size, seconds, peak / 2 ** 20)
+            )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,64 @@
+"""Measure what --minimal saves: the size of the assembly of each module and
+the time the assembler takes on it, with and without the option.
+
+    python3 benchmarks/minimal_output.py big.gtirb [more.gtirb ...]
+
+Each IR is printed with gtirb-pprinter --asm, once as is and once with
+--minimal, and every module's assembly is assembled with `as` --runs
+times. The median times are reported, with one line per IR and option.
+"""
+import argparse
+import statistics
+import subprocess
+import tempfile
+import time
+from pathlib import Path
+
+
+def print_ir(ir, out_dir, extra_args):
+    """Print all the modules of ir into out_dir and return their files."""
+    asm = Path(out_dir, "module.s")
+    subprocess.run(
+        ["gtirb-pprinter", "--ir", str(ir), "--asm", str(asm), *extra_args],
+        check=True,
+        stdout=subprocess.DEVNULL,
+    )
+    return sorted(Path(out_dir).glob("module*.s"))
+
+
+def assemble_seconds(files, assembler, runs):
+    """Return the median time taken to assemble all of files."""
+    times = []
+    for _ in range(runs):
+        start = time.perf_counter()
+        for f in files:
+            subprocess.run(
+                [assembler, str(f), "-o", str(f.with_suffix(".o"))],
+                check=True,
+            )
+        times.append(time.perf_counter() - start)
+    return statistics.median(times)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("irs", nargs="+", help="GTIRB files to print")
+    parser.add_argument("--runs", type=int, default=5)
+    parser.add_argument("--assembler", default="as")
+    args = parser.parse_args()
+
+    print("%-40s %-8s %14s %10s" % ("ir", "mode", "bytes", "as (s)"))
+    for ir in args.irs:
+        sizes = {}
+        for mode, extra_args in [("default", []), ("minimal", ["--minimal"])]:
+            with tempfile.TemporaryDirectory() as out_dir:
+                files = print_ir(ir, out_dir, extra_args)
+                sizes[mode] = sum(f.stat().st_size for f in files)
+                seconds = assemble_seconds(files, args.assembler, args.runs)
+            print("%-40s %-8s %14d %10.3f" % (ir, mode, sizes[mode], seconds))
+        saved = 1 - sizes["minimal"] / sizes["default"]
+        print("%-40s %-8s %13.1f%%" % (ir, "saved", 100 * saved))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,72 @@
+"""Measure the peak memory that --release-modules saves when linking.
+
+gtirb-binary-printer builds a binary from each IR, with and without the
+option.
+
+    python3 benchmarks/release_modules.py big.gtirb [more.gtirb ...]
+
+Each IR is linked --runs times in each mode, and the peak memory logged by
+gtirb-binary-printer is read from its output. The median peaks and times
+are reported, with one line per IR and mode.
+"""
+import argparse
+import re
+import statistics
+import subprocess
+import tempfile
+import time
+from pathlib import Path
+
+PEAK = re.compile(r"Peak memory:\s*(\d+) MB")
+
+
+def link(ir, out_dir, extra_args):
+    """Link ir into a binary in out_dir and return the peak memory in MB
+    and the time taken."""
+    start = time.perf_counter()
+    result = subprocess.run(
+        [
+            "gtirb-binary-printer",
+            "--ir",
+            str(ir),
+            "--binary",
+            str(Path(out_dir, "binary")),
+            *extra_args,
+        ],
+        check=True,
+        stdout=subprocess.PIPE,
+        universal_newlines=True,
+    )
+    seconds = time.perf_counter() - start
+    match = PEAK.search(result.stdout)
+    if not match:
+        raise RuntimeError("gtirb-binary-printer did not log its peak memory")
+    return int(match.group(1)), seconds
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("irs", nargs="+", help="GTIRB files to link")
+    parser.add_argument("--runs", type=int, default=3)
+    args = parser.parse_args()
+
+    print("%-40s %-8s %10s %10s" % ("ir", "mode", "peak (MB)", "time (s)"))
+    for ir in args.irs:
+        peaks = {}
+        for mode, extra_args in [
+            ("default", []),
+            ("release", ["--release-modules"]),
+        ]:
+            runs = []
+            for _ in range(args.runs):
+                with tempfile.TemporaryDirectory() as out_dir:
+                    runs.append(link(ir, out_dir, extra_args))
+            peaks[mode] = statistics.median(peak for peak, _ in runs)
+            seconds = statistics.median(s for _, s in runs)
+            print("%-40s %-8s %10d %10.3f" % (ir, mode, peaks[mode], seconds))
+        saved = 1 - peaks["release"] / peaks["default"]
+        print("%-40s %-8s %9.1f%%" % (ir, "saved", 100 * saved))
+
+
+if __name__ == "__main__":
+    main()
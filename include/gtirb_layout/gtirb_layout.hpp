@@ -17,9 +17,19 @@
 
 #include "Export.hpp"
 #include <gtirb/Module.hpp>
+#include <unordered_map>
 
 namespace gtirb_layout {
 bool GTIRB_LAYOUT_EXPORT_API layoutModule(gtirb::Module& M);
+/// Addresses for the byte intervals of a module.
+using AddressMap =
+    std::unordered_map<const gtirb::ByteInterval*, gtirb::Addr>;
+/// Compute addresses for the byte intervals of a module without merging or
+/// modifying them: intervals joined by fallthrough edges are placed back to
+/// back. Return false if a code block falls through into another section,
+/// or into a block that cannot directly follow it.
+bool GTIRB_LAYOUT_EXPORT_API computeModuleAddresses(const gtirb::Module& M,
+                                                    AddressMap& Addresses);
 bool GTIRB_LAYOUT_EXPORT_API removeModuleLayout(gtirb::Module& M);
 } // namespace gtirb_layout
 
@@ -43,7 +43,11 @@ protected:
     void printOpIndirect(std::ostream& os,
                        const gtirb::SymbolicExpression* symbolic,
                        const cs_insn& inst, uint64_t index) override;
-    std::optional<std::string> getForwardedSymbolName(const gtirb::Symbol* symbol, bool inData) const override;
+    bool printForwardedSymbolName(std::ostream& os, const gtirb::Symbol* symbol, bool inData) const override;
+    bool isPCRelative(const cs_insn& inst) const override;
+    bool isNop(const cs_insn& inst) const override;
+    void printPassthroughInstructions(std::ostream& os, const cs_insn* first,
+                                      const cs_insn* last) override;
 
     void printOpRawValue(std::ostream& os, const cs_insn& inst, uint64_t index);
     void printOpPrefetch(std::ostream& os, const arm64_prefetch_op prefetch);
@@ -16,6 +16,8 @@
 #define GTIRB_PP_GAS_PRINTER_H
 
 #include "ElfPrettyPrinter.hpp"
+#include <string>
+#include <unordered_map>
 
 namespace gtirb_pprint {
 
@@ -36,8 +38,20 @@ protected:
   void printOpIndirect(std::ostream& os,
                        const gtirb::SymbolicExpression* symbolic,
                        const cs_insn& inst, uint64_t index) override;
+  void adaptSharedInstruction(cs_insn& inst, const uint8_t* bytes) override;
 
 private:
+  /// The AT&T mnemonic and operand order of an instruction decoded in Intel
+  /// syntax: operand i is Intel operand order[i].
+  struct AttForm {
+    char mnemonic[CS_MNEMONIC_SIZE];
+    uint8_t order[sizeof(cs_x86::operands) / sizeof(cs_x86_op)];
+  };
+  /// The forms of the shared instructions adapted so far, keyed by the
+  /// parts of their encoding that decide the form.
+  std::unordered_map<std::string, AttForm> attForms;
+  std::string attFormKey;
+
   static volatile bool registered;
 };
 
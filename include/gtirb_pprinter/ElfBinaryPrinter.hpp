@@ -19,6 +19,7 @@
 
 #include <gtirb/gtirb.hpp>
 
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -28,6 +29,9 @@ class ElfBinaryPrinter : public BinaryPrinter {
 private:
   std::string compiler = "gcc";
   bool debug = false;
+  std::optional<uint64_t> incbinThreshold;
+  std::function<void(gtirb::Module&)> prepareModule;
+  bool releaseModules = false;
   std::optional<std::string>
   getInfixLibraryName(const std::string& library) const;
   std::optional<std::string>
@@ -48,6 +52,27 @@ public:
   ElfBinaryPrinter& operator=(const ElfBinaryPrinter&) = default;
   ElfBinaryPrinter& operator=(ElfBinaryPrinter&&) = default;
 
+  /// Write runs of non-symbolic data of at least \p threshold bytes to
+  /// temporary binary files included with `.incbin`, instead of printing
+  /// them in the temporary assembly files.
+  void setIncbinThreshold(uint64_t threshold) { incbinThreshold = threshold; }
+
+  /// Run \p prepare on each module before indexing and printing it, on the
+  /// next module while the current one is printed. Modules without
+  /// addresses are printed with computed ones and need not be laid out.
+  void setPrepareModule(std::function<void(gtirb::Module&)> prepare) {
+    prepareModule = std::move(prepare);
+  }
+
+  /// Remove the AuxData, the blocks, with their CFG nodes, and the symbolic
+  /// expressions of each module once its assembly is written and the next
+  /// module is indexed, so that they do not stay in memory while the other
+  /// modules are printed and the compiler runs. The bytes of the module
+  /// are kept. The compiler arguments are computed before printing. The
+  /// modules cannot be printed again afterwards, and must not refer to
+  /// each other's symbols.
+  void setReleaseModules(bool release) { releaseModules = release; }
+
   int link(std::string outputFilename,
            const std::vector<std::string>& extraCompilerArgs,
            const std::vector<std::string>& userLibraryPaths,
@@ -38,7 +38,11 @@ public:
   const std::string& global() const override { return GlobalDirective; }
   const std::string& align() const override { return AlignDirective; }
 
+  bool hasNopsDirective() const override { return true; }
+  bool hasEndbr64() const override { return true; }
+
   const std::string& type() const { return TypeDirective; }
+  const std::string& inst() const { return InstDirective; }
 
 private:
   const std::string CommentStyle{"#"};
@@ -58,6 +62,7 @@ private:
   const std::string GlobalDirective{".globl"};
   const std::string AlignDirective{".align"};
   const std::string TypeDirective{".type"};
+  const std::string InstDirective{".inst"};
 };
 
 class ElfPrettyPrinter : public PrettyPrinterBase {
@@ -0,0 +1,119 @@
+//===- ListingPrinter.hpp ---------------------------------------*- C++ -*-===//
+//
+//  Copyright (C) 2020 GrammaTech, Inc.
+//
+//  This code is licensed under the MIT license. See the LICENSE file in the
+//  project root for license terms.
+//
+//  This project is sponsored by the Office of Naval Research, One Liberty
+//  Center, 875 N. Randolph Street, Arlington, VA 22203 under contract #
+//  N68335-17-C-0700.  The content of the information does not necessarily
+//  reflect the position or policy of the Government and no official
+//  endorsement should be inferred.
+//
+//===----------------------------------------------------------------------===//
+#ifndef GTIRB_PP_LISTING_PRINTER_H
+#define GTIRB_PP_LISTING_PRINTER_H
+
+#include "ElfPrettyPrinter.hpp"
+
+namespace gtirb_pprint {
+
+/// Prints a machine-readable listing of a module instead of assembly: one
+/// record per instruction and per data object, written as soon as it is
+/// produced. Each record holds the address, the size, the UUID of the
+/// enclosing block, the mnemonic and operands as printed by Capstone, the
+/// names of the symbols referenced by its symbolic expressions, and the
+/// names of the enclosing function and section.
+///
+/// In the binary format, the listing starts with the 8 bytes "GTLIST01".
+/// Every record is a little-endian uint32 payload length followed by the
+/// payload:
+///
+///   uint8  kind (0: instruction, 1: data)
+///   uint64 address
+///   uint64 size
+///   byte[16] block UUID
+///   string mnemonic, operands, function, section
+///   uint32 number of symbol references, each a string
+///
+/// where a string is a uint32 length followed by that many bytes. The JSON
+/// format writes the same fields as one JSON object per line.
+class ListingPrinter : public ElfPrettyPrinter {
+public:
+  ListingPrinter(gtirb::Context& context, gtirb::Module& module,
+                 const ElfSyntax& syntax, const PrintingPolicy& policy,
+                 bool json, cs_arch arch, cs_mode mode);
+
+protected:
+  void printHeader(std::ostream& os) override;
+  void printFooter(std::ostream& os) override;
+  void printSectionHeader(std::ostream& os, const gtirb::Addr addr) override;
+  void printSectionHeaderFor(std::ostream& os, const gtirb::Section& section,
+                             const gtirb::Addr addr) override;
+  void printSectionFooter(std::ostream& os,
+                          const std::optional<const gtirb::Addr> addr,
+                          const gtirb::Addr last) override;
+
+  gtirb::Addr printBlockOrWarning(std::ostream& os, const gtirb::CodeBlock& x,
+                                  gtirb::Addr last) override;
+  gtirb::Addr printDataBlockOrWarning(std::ostream& os,
+                                      const gtirb::DataBlock& x,
+                                      gtirb::Addr last) override;
+  void printBlock(std::ostream& os, const gtirb::CodeBlock& x) override;
+  void printDataBlock(std::ostream& os,
+                      const gtirb::DataBlock& dataObject) override;
+  // Labels are not listed, also not the ones at the end of the module.
+  void printSymbolDefinitionsAtAddress(std::ostream& os, gtirb::Addr ea,
+                                       bool inData) override;
+
+  // Operands are taken from Capstone's text, so these are never called.
+  void printOpRegdirect(std::ostream& os, const cs_insn& inst,
+                        unsigned int reg) override;
+  void printOpImmediate(std::ostream& os,
+                        const gtirb::SymbolicExpression* symbolic,
+                        const cs_insn& inst, uint64_t index) override;
+  void printOpIndirect(std::ostream& os,
+                       const gtirb::SymbolicExpression* symbolic,
+                       const cs_insn& inst, uint64_t index) override;
+
+private:
+  struct Record {
+    bool isCode;
+    gtirb::Addr addr;
+    uint64_t size;
+    const gtirb::UUID& block;
+    std::string_view mnemonic;
+    std::string_view operands;
+    const std::string& function;
+    const std::string& section;
+  };
+
+  /// Write a record, referring to the symbols used by the symbolic
+  /// expressions in its bytes.
+  void printRecord(std::ostream& os, const Record& record);
+
+  bool json;
+  /// The payload of the record being written, reused across records.
+  std::string buffer;
+  std::vector<const gtirb::Symbol*> symbols;
+
+  static volatile bool registered;
+};
+
+class ListingPrinterFactory : public PrettyPrinterFactory {
+public:
+  explicit ListingPrinterFactory(bool json) : json(json) {}
+
+  const PrintingPolicy& defaultPrintingPolicy() const override;
+  std::unique_ptr<PrettyPrinterBase>
+  create(gtirb::Context& context, gtirb::Module& module,
+         const PrintingPolicy& policy) override;
+
+private:
+  bool json;
+};
+
+} // namespace gtirb_pprint
+
+#endif /* GTIRB_PP_LISTING_PRINTER_H */
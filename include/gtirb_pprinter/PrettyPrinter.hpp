@@ -16,27 +16,36 @@
 #define GTIRB_PP_PRETTY_PRINTER_H
 
 #include "Export.hpp"
+#include "SourceMap.hpp"
 #include "Syntax.hpp"
 
 #include <gtirb/gtirb.hpp>
+#include <gtirb_layout/gtirb_layout.hpp>
 
+#include <algorithm>
 #include <boost/range/any_range.hpp>
 #include <capstone/capstone.h>
 #include <cstdint>
+#include <deque>
+#include <fstream>
+#include <functional>
 #include <initializer_list>
-#include <iosfwd>
 #include <list>
 #include <map>
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <unordered_set>
+#include <variant>
 #include <vector>
 
 /// \brief Pretty-print GTIRB representations.
 namespace gtirb_pprint {
 
 struct PrintingPolicy;
+struct ModuleIndex;
 class PrettyPrinterFactory;
 class PrettyPrinterBase;
 
@@ -79,6 +88,123 @@ void setDefaultSyntax(const std::string& format, const std::string& syntax);
 /// Return the default syntax for a file format.
 std::optional<std::string> getDefaultSyntax(const std::string& format);
 
+/// Write the outputs of all the shards of a module, printed with
+/// PrettyPrinter::setShard, as the output of printing the module whole.
+/// The shard files can be given in any order.
+///
+/// \param paths the files holding the output of each shard
+/// \param os    the stream to write the merged output to
+///
+/// \return a condition indicating if a file could not be read, or if the
+/// files are not exactly the shards of one module, or condition 0 if there
+/// were no errors.
+std::error_condition mergeShards(const std::vector<std::string>& paths,
+                                 std::ostream& os);
+
+/// Return a hash of the contents of the file at \p path, or nothing if it
+/// cannot be read. It identifies an IR file for PrettyPrinter::setSidecar.
+std::optional<std::string> hashIRFile(const std::string& path);
+
+/// Load the IR in the file at \p path. The file is mapped into memory while
+/// it is parsed, instead of being read through a stream buffer; files that
+/// cannot be mapped (e.g. pipes) are read as a stream. Return null if the IR
+/// cannot be read.
+///
+/// A mapped file that is truncated during the load kills the process with
+/// SIGBUS. Read files that may be rewritten meanwhile, such as those of a
+/// long-running server, through a stream instead.
+gtirb::IR* loadIR(gtirb::Context& context, const std::string& path);
+
+/// Call \p prepare and then \p consume on each module of \p ir, in order.
+/// \p prepare runs on the next module in another thread while \p consume
+/// runs on the current one, so neither may touch other modules. This is
+/// meant for indexing a module while the previous one is printed.
+///
+/// \param ir      the IR whose modules are visited
+/// \param prepare the step run ahead, e.g. building the ModuleIndex
+/// \param consume the step run in order, e.g. printing the module; if it
+///                returns false, no further module is visited
+/// \param finish  if set, the step run on a module after \p consume, once
+///                the next module is prepared; it runs alone, so it may
+///                change the IR, e.g. its CFG
+///
+/// \return \c false if \p consume stopped the iteration.
+bool pipelineModules(
+    gtirb::IR& ir, const std::function<void(gtirb::Module&)>& prepare,
+    const std::function<bool(gtirb::Module&)>& consume,
+    const std::function<void(gtirb::Module&)>& finish = nullptr);
+
+/// The coefficients of the model used by estimatePrint. The defaults are
+/// rough averages over x86-64 ELF binaries printed with the default
+/// options; benchmarks/calibrate_cost_model.py fits them to runs measured
+/// on given IRs.
+struct PrintCostModel {
+  /// Average size of an instruction, for ISAs with variable sizes.
+  double bytesPerInstruction = 3.8;
+  double outputBytesPerInstruction = 36;
+  double outputBytesPerDataByte = 8;
+  double outputBytesPerSymbolicExpression = 24;
+  double outputBytesPerSymbol = 40;
+  double outputBytesPerBlock = 16;
+  /// Memory used by the printer on top of the loaded IR.
+  double memoryBytesPerBlock = 200;
+  double memoryBytesPerSymbol = 150;
+  double memoryBytesPerSymbolicExpression = 64;
+  double secondsPerInstruction = 2e-6;
+  double secondsPerDataByte = 5e-8;
+  double secondsPerSymbolicExpression = 1e-6;
+  /// Memory and time to load an IR, per byte of its file.
+  double irMemoryPerFileByte = 3;
+  double loadSecondsPerFileByte = 1e-8;
+  /// Memory and time of the assembler, per byte of the assembly it reads.
+  /// These and the linker's costs are guesses, not measurements. The
+  /// calibration script fits the assembler's, but not the linker's.
+  double assembleMemoryPerOutputByte = 2;
+  double assembleSecondsPerOutputByte = 3e-8;
+  /// Memory and time of the linker, per byte of code and data it links.
+  double linkMemoryPerBinaryByte = 4;
+  double linkSecondsPerBinaryByte = 2e-8;
+};
+
+/// What a module holds, and the predicted cost of printing it.
+struct PrintEstimate {
+  uint64_t codeBytes = 0;
+  uint64_t dataBytes = 0;
+  uint64_t codeBlocks = 0;
+  uint64_t dataBlocks = 0;
+  uint64_t symbols = 0;
+  uint64_t symbolicExpressions = 0;
+
+  uint64_t instructions = 0;
+  uint64_t outputBytes = 0;
+  /// Memory used by the printer on top of the loaded IR.
+  uint64_t memoryBytes = 0;
+  double seconds = 0;
+  /// Memory and time of assembling the printed assembly.
+  uint64_t assembleMemoryBytes = 0;
+  double assembleSeconds = 0;
+};
+
+/// Predict the cost of printing \p module from the sizes of its blocks and
+/// the numbers of its symbols and symbolic expressions. Nothing is decoded
+/// and no AuxData is read, so this takes a small fraction of the time
+/// printing would.
+PrintEstimate estimatePrint(const gtirb::Module& module,
+                            const PrintCostModel& model = PrintCostModel());
+
+/// Write the estimates of printing each module of \p ir, and of the whole
+/// job, as one JSON object per line. The job loads the IR from a file of
+/// \p irFileBytes bytes and prints its modules one after the other, so its
+/// peak memory is the loaded IR plus the printer of the largest module.
+///
+/// If \p compile is true, the job is the binary printer's: the assembly of
+/// each module is then assembled and all of them are linked, while the IR
+/// stays loaded. The estimates then include the time of these steps, and
+/// the peak memory includes the largest of them.
+void writePrintEstimates(std::ostream& os, const gtirb::IR& ir,
+                         uint64_t irFileBytes, bool compile = false,
+                         const PrintCostModel& model = PrintCostModel());
+
 /// The primary interface for pretty-printing GTIRB objects. The typical flow
 /// is to create a PrettyPrinter, configure it (e.g., set the output syntax,
 /// enable/disable debugging messages, etc.), then print one or more IR objects.
@@ -124,6 +250,124 @@ public:
   /// \param functionName name of the function to keep
   void keepFunction(const std::string& functionName);
 
+  /// Only print the selected functions, sections and address ranges. A
+  /// function extends from its entry to the next function entry or to the
+  /// end of its section. Selected functions are printed even if they are
+  /// skipped by default.
+  ///
+  /// \param functionName name of the function to print
+  void selectFunction(const std::string& functionName);
+
+  /// \param sectionName name of the section to print
+  void selectSection(const std::string& sectionName);
+
+  /// \param begin the address of the first block to print
+  /// \param end   the address after the last block to print
+  void selectAddressRange(uint64_t begin, uint64_t end);
+
+  /// Write runs of non-symbolic data of at least \p threshold bytes to the
+  /// binary file \p path and include them in the assembly with `.incbin`
+  /// instead of printing them as individual bytes. The directives name the
+  /// file by its absolute path, so the assembly can be assembled from any
+  /// directory as long as the file stays in place. An empty path disables
+  /// this.
+  ///
+  /// \param path      the binary file to write the data to
+  /// \param threshold the minimum length of a data run written to the file
+  void setIncbinFile(const std::string& path, uint64_t threshold = 4096);
+
+  /// Print instructions that have no symbolic operands, no labels and no
+  /// PC-relative encoding as raw bytes (`.byte` on x86, `.inst` on AArch64)
+  /// instead of disassembling them. Consecutive raw instructions are
+  /// coalesced into one directive unless comments are requested.
+  ///
+  /// \param passthrough whether to print such instructions as raw bytes
+  /// \param comments    whether to annotate each raw instruction with its
+  ///                    disassembly in a trailing comment
+  void setPassthrough(bool passthrough, bool comments = false);
+
+  /// Omit the decorative comments, bars, prologue padding and indentation
+  /// that are only there for readers, producing the smallest assembly that
+  /// still assembles to the same code. Debugging output is not affected.
+  ///
+  /// \param minimal whether to print minimal assembly
+  void setMinimal(bool minimal);
+
+  /// Let the assembly use features that only newer assemblers accept:
+  /// `.nops N` for runs of padding NOPs (GNU as 2.31) and the endbr64
+  /// instruction (GNU as 2.29). Without them, padding is printed as one
+  /// `nop` per instruction and endbr64 as a `nop`. Both are off by default.
+  ///
+  /// \param nopsDirective whether to merge padding into `.nops` directives
+  /// \param endbr64       whether to print endbr64 instructions
+  void setAssemblerFeatures(bool nopsDirective, bool endbr64);
+
+  /// Keep the render cache of each target in a file in directory \p dir,
+  /// so that later runs, also on other IRs, reuse the decoded and formatted
+  /// text of non-symbolic instructions. Cache files written by another
+  /// printer or Capstone version are ignored and rewritten. An empty path
+  /// disables this.
+  ///
+  /// \param dir an existing directory holding the cache files
+  void setRenderCacheDir(const std::string& dir);
+
+  /// Set the maximum number of distinct instructions whose text is kept in
+  /// the render cache.
+  ///
+  /// \param size the number of cached instructions, zero disables the cache
+  void setRenderCacheSize(uint64_t size);
+
+  /// Keep the printed text of each function and section chunk in a file in
+  /// directory \p dir, keyed by a hash of everything the text is printed
+  /// from: the bytes, the symbols, the symbolic expressions, the CFI
+  /// directives, the layout of the blocks and the policy. Later runs, also
+  /// on other IRs, copy the text of unchanged chunks instead of printing
+  /// them. An empty path disables this.
+  ///
+  /// \param dir an existing directory holding the cache files
+  void setOutputCacheDir(const std::string& dir);
+
+  /// Keep a sidecar file for each module and target in directory \p dir,
+  /// holding the decoded instructions and the indexes of the module, so
+  /// that later prints of the same IR skip decoding them and building the
+  /// indexes. The files are keyed by \p irHash, which has to identify the
+  /// contents of the IR the modules are printed from (see hashIRFile).
+  /// Sidecars of other IRs, layouts, printer or Capstone versions are
+  /// ignored and rebuilt. Printers of the same IR, e.g. the shards of a
+  /// module, merge what they decoded into the same file. An empty path
+  /// disables this.
+  ///
+  /// \param dir    an existing directory holding the sidecar files
+  /// \param irHash the content hash of the IR
+  void setSidecar(const std::string& dir, const std::string& irHash);
+
+  /// Write a SourceMap of the printed assembly to \p path, mapping output
+  /// lines and offsets to the addresses, blocks and functions they were
+  /// printed from. An empty path disables this.
+  ///
+  /// \param path the file to write the source map to
+  void setSourceMapFile(const std::string& path);
+
+  /// Print only shard \p index of \p count of each module. The blocks of a
+  /// module are split into \p count contiguous runs of about the same size,
+  /// starting at function entries or section starts, so that every process
+  /// printing a shard of the same module agrees on the split. The output
+  /// starts with a comment line describing the shard, which mergeShards
+  /// uses to check and join the shards. A count of 1 prints the whole
+  /// module. Sharding is ignored when printing selected regions.
+  ///
+  /// \param index the shard to print, from 0 to count - 1
+  /// \param count the number of shards
+  void setShard(size_t index, size_t count);
+
+  /// Print with \p index instead of building the indexes of the module on
+  /// every call, e.g. to keep them with a module printed many times. The
+  /// index must have been built for the module being printed. A null
+  /// pointer builds them again on every call.
+  ///
+  /// \param index the indexes of the module printed next
+  void setModuleIndex(std::shared_ptr<const ModuleIndex> index);
+
   /// Pretty-print the IR module to a stream. The default output target is
   /// deduced from the file format of the IR if it is not explicitly set with
   /// \link setTarget.
@@ -133,16 +377,86 @@ public:
   /// \param module      the module to pretty-print
   ///
   /// \return a condition indicating if there was an error, or condition 0 if
-  /// there were no errors.
+  /// there were no errors. The condition is std::errc::address_not_available
+  /// if the module has no addresses and none can be computed.
   std::error_condition print(std::ostream& stream, gtirb::Context& context,
                              gtirb::Module& module) const;
 
+  /// Pretty-print the IR module for several targets in a single traversal of
+  /// the module. The printers of the targets share the module indexes and
+  /// the block order, and each block is printed for every target before
+  /// moving on to the next one. No incbin file or source map is written.
+  ///
+  /// \param outputs the targets to print and the streams to print them to
+  /// \param context context to use for allocating AuxData objects if needed
+  /// \param module  the module to pretty-print
+  ///
+  /// \return a condition indicating if there was an error, or condition 0 if
+  /// there were no errors. The condition is std::errc::address_not_available
+  /// if the module has no addresses and none can be computed.
+  std::error_condition
+  print(const std::vector<std::pair<std::tuple<std::string, std::string>,
+                                    std::ostream*>>& outputs,
+        gtirb::Context& context, gtirb::Module& module) const;
+
+  /// Print the functions that differ between two versions of a module as a
+  /// unified diff of their assembly. Functions are matched by name, or by
+  /// entry address if the name is missing or ambiguous, and compared by a
+  /// digest of their bytes, symbols and symbolic expressions. Only the
+  /// functions whose digests differ are printed.
+  ///
+  /// \param stream     the stream to print the diff to
+  /// \param oldContext the context of the old module
+  /// \param oldModule  the old version of the module
+  /// \param context    the context of the new module
+  /// \param module     the new version of the module
+  ///
+  /// \return a condition indicating if there was an error, or condition 0 if
+  /// there were no errors. The condition is std::errc::address_not_available
+  /// if either module has no addresses and none can be computed.
+  std::error_condition printDiff(std::ostream& stream,
+                                 gtirb::Context& oldContext,
+                                 gtirb::Module& oldModule,
+                                 gtirb::Context& context,
+                                 gtirb::Module& module) const;
+
 private:
+  friend class PrintSession;
+
+  /// Return the target set with setTarget, or the default one of the
+  /// module's format.
+  std::tuple<std::string, std::string>
+  getTarget(const gtirb::Module& module) const;
+
+  /// Return the default policy of the factory configured as requested.
+  PrintingPolicy
+  getPolicy(const PrettyPrinterFactory& factory,
+            const std::tuple<std::string, std::string>& target) const;
+
   std::set<std::string> m_skip_funcs;
   std::set<std::string> m_keep_funcs;
   std::string m_format;
   std::string m_syntax;
   DebugStyle m_debug;
+  std::string m_incbin_file;
+  uint64_t m_incbin_threshold = 4096;
+  bool m_passthrough = false;
+  bool m_passthrough_comments = false;
+  bool m_minimal = false;
+  bool m_nops_directive = false;
+  bool m_endbr64 = false;
+  std::string m_render_cache_dir;
+  uint64_t m_render_cache_size = 65536;
+  std::string m_output_cache_dir;
+  std::string m_sidecar_dir;
+  std::string m_ir_hash;
+  std::string m_source_map_file;
+  size_t m_shard = 0;
+  size_t m_shard_count = 1;
+  std::shared_ptr<const ModuleIndex> m_module_index;
+  std::set<std::string> m_select_functions;
+  std::set<std::string> m_select_sections;
+  std::vector<std::pair<uint64_t, uint64_t>> m_select_ranges;
 };
 
 struct PrintingPolicy {
@@ -158,6 +472,183 @@ struct PrintingPolicy {
   std::unordered_set<std::string> arraySections;
 
   DebugStyle debug = NoDebug;
+
+  /// If not empty, runs of at least incbinThreshold bytes of non-symbolic
+  /// data are written to this file and included with `.incbin`.
+  std::string incbinFile;
+  uint64_t incbinThreshold = 4096;
+
+  /// Print position-independent, non-symbolic instructions as raw bytes,
+  /// optionally followed by their disassembly in a comment.
+  bool passthrough = false;
+  bool passthroughComments = false;
+
+  /// Print no bars, header comments or indentation.
+  bool minimal = false;
+
+  /// Assembler features the output may use if the syntax supports them.
+  bool nopsDirective = false;
+  bool endbr64 = false;
+
+  /// The maximum number of distinct instructions whose text is cached.
+  /// Zero disables the render cache.
+  uint64_t renderCacheSize = 65536;
+  /// If not empty, the render cache is loaded from and saved to this file.
+  std::string renderCacheFile;
+
+  /// If not empty, the printed chunks are cached in this file, which
+  /// is kept below outputCacheLimit bytes.
+  std::string outputCacheFile;
+  uint64_t outputCacheLimit = uint64_t{1} << 30;
+
+  /// If not empty, the decoded instructions and the indexes of the module
+  /// are loaded from and saved to a file in this directory, named after
+  /// sidecarKey and the UUID of the module. sidecarKey has to identify the
+  /// contents of the IR and the target.
+  std::string sidecarDir;
+  std::string sidecarKey;
+
+  /// If any of these are set, only the blocks in the selected functions,
+  /// sections and address ranges are printed.
+  std::unordered_set<std::string> selectFunctions;
+  std::unordered_set<std::string> selectSections;
+  std::vector<std::pair<uint64_t, uint64_t>> selectRanges;
+
+  /// If not empty, a SourceMap of the output is written to this file.
+  std::string sourceMapFile;
+
+  /// If shardCount is more than 1, only this shard of the module is printed.
+  size_t shard = 0;
+  size_t shardCount = 1;
+
+  /// The indexes of the module, if they are shared with other printers.
+  std::shared_ptr<const ModuleIndex> index;
+};
+
+/// The parts of a printer's state that do not depend on the target, built
+/// once per module and shared by the printers of all targets.
+///
+/// The printers find every address through the index. A module without
+/// addresses is printed with the ones gtirb_layout::computeModuleAddresses
+/// gives its byte intervals, which are kept here instead of being set on
+/// the module.
+struct ModuleIndex {
+  ModuleIndex() = default;
+  ModuleIndex(gtirb::Context& context, gtirb::Module& module);
+
+  /// A code block or a data block.
+  using Block =
+      std::variant<const gtirb::CodeBlock*, const gtirb::DataBlock*>;
+
+  /// False if the module has no addresses and none can be computed, in
+  /// which case the index is empty and the module cannot be printed.
+  bool laidOut = true;
+
+  /// Function entries and function last blocks, sorted by address.
+  std::vector<gtirb::Addr> functionEntry;
+  std::vector<gtirb::Addr> functionLastBlock;
+
+  /// The blocks of the module in printing order: by address, with code
+  /// blocks before data blocks at the same address.
+  std::vector<Block> blocks;
+
+  /// Compute the addresses of the byte intervals of \p module if it has
+  /// none, and index its byte intervals, sections and symbols by address.
+  /// Return false if the addresses cannot be computed.
+  bool indexAddresses(const gtirb::Module& module);
+
+  /// Return the address of a node as the module gives it, or as computed
+  /// if the module has no addresses.
+  std::optional<gtirb::Addr> addressOf(const gtirb::ByteInterval& x) const;
+  std::optional<gtirb::Addr> addressOf(const gtirb::CodeBlock& x) const;
+  std::optional<gtirb::Addr> addressOf(const gtirb::DataBlock& x) const;
+  std::optional<gtirb::Addr> addressOf(const gtirb::Section& x) const;
+  std::optional<gtirb::Addr> addressOf(const gtirb::Symbol& x) const;
+  std::optional<uint64_t> sizeOf(const gtirb::Section& x) const;
+  /// Return the address and the size of a block.
+  std::pair<gtirb::Addr, uint64_t> extentOf(const Block& block) const;
+  /// Return the indexes in blocks of the first block starting at or after
+  /// \p begin and of the first one starting at or after \p end.
+  std::pair<size_t, size_t> findBlocksAt(gtirb::Addr begin,
+                                         gtirb::Addr end) const;
+
+  /// Return the first section starting at \p addr, or null.
+  const gtirb::Section* findSectionAt(gtirb::Addr addr) const;
+  /// Return the first section holding \p addr, or null.
+  const gtirb::Section* findSectionOn(gtirb::Addr addr) const;
+  /// Return whether a data block holds \p addr.
+  bool hasDataBlocksOn(gtirb::Addr addr) const;
+
+  /// Call \p f with the address of each byte interval overlapping
+  /// [begin, end) and the interval, in address order.
+  template <typename F>
+  void forEachIntervalOn(gtirb::Addr begin, gtirb::Addr end, F&& f) const {
+    forEachExtentOn(intervals, begin, end,
+                    [&f](const Extent<gtirb::ByteInterval>& e) {
+                      f(e.address, *e.node);
+                    });
+  }
+
+  /// An address range of a node, with the largest end address of the
+  /// ranges up to it in address order. The ranges on an address start
+  /// after the last one whose largest end is not past it.
+  template <typename NodeT> struct Extent {
+    gtirb::Addr address;
+    uint64_t size;
+    gtirb::Addr maxEnd;
+    const NodeT* node;
+  };
+  std::vector<Extent<gtirb::ByteInterval>> intervals;
+  std::vector<Extent<gtirb::Section>> sections;
+
+  /// The symbols with an address, sorted by address, if the addresses were
+  /// computed. Otherwise the module's own index is used.
+  std::vector<std::pair<gtirb::Addr, const gtirb::Symbol*>> symbols;
+
+  /// The addresses computed for the byte intervals of a module without
+  /// addresses. Empty if the module has its own.
+  gtirb_layout::AddressMap computedAddresses;
+
+private:
+  template <typename NodeT, typename F>
+  static void forEachExtentOn(const std::vector<Extent<NodeT>>& extents,
+                              gtirb::Addr begin, gtirb::Addr end, F&& f) {
+    auto it = std::partition_point(
+        extents.begin(), extents.end(),
+        [begin](const Extent<NodeT>& e) { return e.maxEnd <= begin; });
+    for (; it != extents.end() && it->address < end; ++it) {
+      if (it->address + it->size > begin)
+        f(*it);
+    }
+  }
+};
+
+/// A PrettyPrinter configuration resolved for one target. The factory and
+/// the printing policy are looked up once, when the session is created, and
+/// print can be called from several threads at once on different modules.
+/// The printers reuse the Capstone handles of their thread.
+class PrintSession {
+public:
+  /// \param printer the configuration to print with
+  /// \param target  the format and syntax to print
+  PrintSession(const PrettyPrinter& printer,
+               const std::tuple<std::string, std::string>& target);
+
+  /// Pretty-print the IR module to a stream.
+  ///
+  /// \param stream  the stream to print to
+  /// \param context context to use for allocating AuxData objects if needed
+  /// \param module  the module to pretty-print
+  ///
+  /// \return a condition indicating if there was an error, or condition 0 if
+  /// there were no errors. The condition is std::errc::address_not_available
+  /// if the module has no addresses and none can be computed.
+  std::error_condition print(std::ostream& stream, gtirb::Context& context,
+                             gtirb::Module& module) const;
+
+private:
+  std::shared_ptr<PrettyPrinterFactory> m_factory;
+  PrintingPolicy m_policy;
 };
 
 /// Abstract factory - encloses default printing configuration and a method for
@@ -175,6 +666,42 @@ public:
          const PrintingPolicy& policy) = 0;
 };
 
+/// Storage for the strings a printer keeps until it is destroyed, such as
+/// the text of cached instructions and blocks. Strings are copied into
+/// large chunks, released together with the arena, and equal strings are
+/// stored once, so keeping a string does not allocate on its own.
+class TextArena {
+public:
+  TextArena() = default;
+  TextArena(const TextArena&) = delete;
+  TextArena& operator=(const TextArena&) = delete;
+
+  /// Return the stored copy of \p text, valid as long as the arena.
+  std::string_view intern(std::string_view text);
+
+  /// Return the number of bytes of the chunks.
+  uint64_t size() const { return chunkBytes; }
+
+private:
+  static constexpr size_t ChunkSize = 64 * 1024;
+  std::vector<std::unique_ptr<char[]>> chunks;
+  char* next = nullptr;
+  size_t left = 0;
+  uint64_t chunkBytes = 0;
+  std::unordered_set<std::string_view> strings;
+};
+
+/// A stream buffer appending to a string that keeps its capacity when it is
+/// cleared, so that printing to it again and again does not allocate.
+class ScratchBuf : public std::streambuf {
+public:
+  std::string text;
+
+protected:
+  int_type overflow(int_type c) override;
+  std::streamsize xsputn(const char* s, std::streamsize n) override;
+};
+
 /// The pretty-printer interface. There is only one exposed function, \link
 /// print().
 class PrettyPrinterBase {
@@ -185,6 +712,35 @@ public:
 
   virtual std::ostream& print(std::ostream& out);
 
+  /// Print with several printers of the same module in lockstep: each block
+  /// is printed by all of them before moving on to the next one, and is
+  /// decoded once for all of them. The printers must share their
+  /// ModuleIndex.
+  static void printTogether(
+      const std::vector<std::pair<PrettyPrinterBase*, std::ostream*>>&
+          printers);
+
+  /// A function as it is printed: its name, its address range and a digest
+  /// of its bytes, symbols and symbolic expressions, taken relative to its
+  /// entry so that unchanged functions match after moving.
+  struct FunctionDigest {
+    std::string name;
+    gtirb::Addr begin;
+    gtirb::Addr end;
+    std::pair<uint64_t, uint64_t> digest;
+  };
+
+  /// Return the digests of the printed functions, in address order.
+  std::vector<FunctionDigest> getFunctionDigests();
+
+  /// Print the blocks starting in [begin, end) with the section header and
+  /// footer they need.
+  void printRegion(std::ostream& os, gtirb::Addr begin, gtirb::Addr end);
+
+  /// Return false if the module has no addresses and none can be computed.
+  /// Such a module cannot be printed.
+  bool isLaidOut() const { return index->laidOut; }
+
 protected:
   const Syntax& syntax;
   PrintingPolicy policy;
@@ -197,11 +753,20 @@ protected:
 
   virtual std::string getRegisterName(unsigned int reg) const;
 
+  /// Return getRegisterName(reg), computing it only once per register.
+  const std::string& registerName(unsigned int reg) const;
+
   virtual void printBar(std::ostream& os, bool heavy = true);
   virtual void printHeader(std::ostream& os) = 0;
   virtual void printFooter(std::ostream& os) = 0;
   virtual void printAlignment(std::ostream& os, const gtirb::Addr addr);
+  /// Return the alignment printAlignment enforces for an address.
+  uint64_t getAlignment(const gtirb::Addr addr) const;
   virtual void printSectionHeader(std::ostream& os, const gtirb::Addr addr);
+  /// Print the header of \p section, aligned for the block at \p addr.
+  virtual void printSectionHeaderFor(std::ostream& os,
+                                     const gtirb::Section& section,
+                                     const gtirb::Addr addr);
   virtual void printSectionHeaderDirective(std::ostream& os,
                                            const gtirb::Section& addr) = 0;
   virtual void printSectionProperties(std::ostream& os,
@@ -229,16 +794,196 @@ protected:
                                               const gtirb::DataBlock& x,
                                               gtirb::Addr last);
 
+  /// Print a code or data block with printBlockOrWarning or
+  /// printDataBlockOrWarning. Return the end of the last block printed.
+  gtirb::Addr printNextBlock(std::ostream& os,
+                             const ModuleIndex::Block& block,
+                             gtirb::Addr last);
+  /// Print the blocks in order. Return the end of the last block printed.
+  gtirb::Addr printBlocks(std::ostream& os,
+                          const std::vector<ModuleIndex::Block>& blocks,
+                          gtirb::Addr last);
+  /// Print blocks[begin, end) a chunk at a time, without ending the last
+  /// symbolic data run. Return the end of the last block printed.
+  gtirb::Addr printBlockRange(std::ostream& os,
+                              const std::vector<ModuleIndex::Block>& blocks,
+                              size_t begin, size_t end, gtirb::Addr last);
+  /// Print what comes between the block ending at \p last and the one at
+  /// \p nextAddr, which does not overlap it: the labels at \p last and the
+  /// section footer and header.
+  void printBlockTransition(std::ostream& os, gtirb::Addr nextAddr,
+                            gtirb::Addr last);
+
+  /// Chunks are the units of the output cache: a function, or the part of
+  /// a section up to the next function or data object with a symbol.
+  /// Return whether \p block starts a chunk. Symbolic data runs end there,
+  /// so a chunk prints the same text whatever was printed before it.
+  bool startsChunk(const ModuleIndex::Block& block) const;
+  /// Return the index of the block starting the chunk after blocks[begin],
+  /// or \p end.
+  size_t nextChunk(const std::vector<ModuleIndex::Block>& blocks,
+                   size_t begin, size_t end) const;
+  /// Print the chunk blocks[begin, end), copying its text from the output
+  /// cache if it is there. Return the end of the last block printed.
+  gtirb::Addr printChunk(std::ostream& os,
+                         const std::vector<ModuleIndex::Block>& blocks,
+                         size_t begin, size_t end, gtirb::Addr last);
+  /// Print what follows the last block of the module, ending at \p last.
+  void printModuleEnd(std::ostream& os, gtirb::Addr last);
+  /// Print the footer and save the caches.
+  void finishPrinting(std::ostream& os);
+  /// Save the caches and the source map once printing is done.
+  void saveCaches(std::ostream& os);
+  /// Print the blocks of policy.shard, headed by a line describing it.
+  void printShard(std::ostream& os);
+  /// Return the indexes in index->blocks of the first block of \p shard and
+  /// of the first block after it.
+  std::pair<size_t, size_t> getShardBlocks(size_t shard) const;
+  bool hasSelectedRegions() const;
+  /// Print the selected regions only, seeking to each of them through the
+  /// module's address indexes.
+  void printSelectedRegions(std::ostream& os);
+  /// Set the symbols that the selected \p regions refer to but that are
+  /// defined outside of them to their addresses, so that the output
+  /// assembles on its own.
+  void printOutsideSymbols(
+      std::ostream& os,
+      const std::vector<std::pair<gtirb::Addr, gtirb::Addr>>& regions);
+  /// Return the sorted, disjoint address ranges selected by the policy.
+  std::vector<std::pair<gtirb::Addr, gtirb::Addr>> getSelectedRegions() const;
+  /// Return the end of the function at \p entry: the next function entry or
+  /// the end of its section.
+  gtirb::Addr getFunctionEnd(gtirb::Addr entry) const;
+
   virtual void printBlock(std::ostream& os, const gtirb::CodeBlock& x);
+  /// Print a code block that is not skipped, without the output cache.
+  void printBlockContents(std::ostream& os, const gtirb::CodeBlock& x);
+  /// Print the instructions of a code block, taking the text of the
+  /// non-symbolic ones from the render cache. Return the offset at which
+  /// printing stopped.
+  gtirb::Offset printBlockInstructions(std::ostream& os,
+                                       const gtirb::CodeBlock& x);
+  /// Print the instructions of a code block with the passthrough policy,
+  /// coalescing raw instructions. Return the offset at which printing
+  /// stopped.
+  gtirb::Offset printPassthroughBlockInstructions(std::ostream& os,
+                                                  const gtirb::CodeBlock& x);
+  /// Print \p size bytes of NOPs at \p offset as a single padding directive.
+  void printNops(std::ostream& os, const gtirb::CodeBlock& x,
+                 const gtirb::Offset& offset, uint64_t size);
+  /// Return true if a label or a CFI directive is attached to the given
+  /// displacement in the block.
+  bool isAnnotated(const gtirb::CodeBlock& x, uint64_t displacement) const;
   virtual void printDataBlock(std::ostream& os,
                               const gtirb::DataBlock& dataObject);
   virtual void printNonZeroDataBlock(std::ostream& os,
                                      const gtirb::DataBlock& dataObject);
   virtual void printZeroDataBlock(std::ostream& os,
                                   const gtirb::DataBlock& dataObject);
+  /// Print the bytes of the data object, writing long runs of bytes to the
+  /// file given by the policy's incbinFile and including them with
+  /// `.incbin`. Symbol definitions and symbolic expressions inside the
+  /// object split the runs and are printed normally.
+  virtual void printIncbinData(std::ostream& os,
+                               const gtirb::DataBlock& dataObject);
   virtual void printByte(std::ostream& os, std::byte byte) = 0;
 
   virtual void fixupInstruction(cs_insn& inst);
+  /// Turn \p inst, decoded from \p bytes by printTogether for all of its
+  /// printers with the default syntax of the architecture, into what this
+  /// printer's Capstone handle would have decoded.
+  virtual void adaptSharedInstruction(cs_insn& /*inst*/,
+                                      const uint8_t* /*bytes*/) {}
+
+  /// Return true if the instruction can be printed as raw bytes, i.e. the
+  /// passthrough policy is enabled and the instruction has no label, no
+  /// symbolic operand and no PC-relative encoding.
+  virtual bool isPassthroughInstruction(const cs_insn& inst) const;
+
+  /// Return true if the meaning of the instruction depends on its address,
+  /// e.g. relative branches and RIP-relative memory operands.
+  virtual bool isPCRelative(const cs_insn& inst) const;
+
+  /// Return the address of a block, byte interval, section or symbol; see
+  /// ModuleIndex::addressOf. Addresses are never read from the module
+  /// directly, as it may have none.
+  template <typename NodeT>
+  std::optional<gtirb::Addr> addressOf(const NodeT& x) const {
+    return index->addressOf(x);
+  }
+
+  /// Return whether a symbolic expression starts from \p begin to \p end,
+  /// and the one at \p ea. Within the code block being printed, these are
+  /// looked up in its byte interval, and elsewhere in the intervals found
+  /// through the ModuleIndex.
+  bool hasSymbolicExpressions(gtirb::Addr begin, gtirb::Addr end) const;
+  const gtirb::SymbolicExpression* findSymbolicExpression(gtirb::Addr ea) const;
+
+  /// Call \p f with the address of each symbolic expression from \p begin
+  /// to \p end and the expression, in address order.
+  template <typename F>
+  void forEachSymbolicExpressionIn(gtirb::Addr begin, gtirb::Addr end,
+                                   F&& f) const {
+    if (index->computedAddresses.empty()) {
+      for (const auto& element : module.findSymbolicExpressionsAt(begin, end))
+        f(*element.getByteInterval()->getAddress() + element.getOffset(),
+          element.getSymbolicExpression());
+      return;
+    }
+    index->forEachIntervalOn(
+        begin, end,
+        [&](gtirb::Addr base, const gtirb::ByteInterval& interval) {
+          uint64_t low = begin > base ? static_cast<uint64_t>(begin) -
+                                            static_cast<uint64_t>(base)
+                                      : 0;
+          uint64_t high =
+              static_cast<uint64_t>(end) - static_cast<uint64_t>(base);
+          for (const auto& element :
+               interval.findSymbolicExpressionsAtOffset(low, high))
+            f(base + element.getOffset(), element.getSymbolicExpression());
+        });
+  }
+
+  /// Return whether a symbol is defined at \p ea, and the first one.
+  bool hasSymbolsAt(gtirb::Addr ea) const;
+  const gtirb::Symbol* findFirstSymbolAt(gtirb::Addr ea) const;
+
+  /// Call \p f with each symbol defined from \p begin to \p end, in
+  /// address order.
+  template <typename F>
+  void forEachSymbolIn(gtirb::Addr begin, gtirb::Addr end, F&& f) const {
+    if (index->computedAddresses.empty()) {
+      for (const gtirb::Symbol& symbol : module.findSymbols(begin, end))
+        f(symbol);
+      return;
+    }
+    const auto& symbols = index->symbols;
+    auto it = std::lower_bound(
+        symbols.begin(), symbols.end(), begin,
+        [](const auto& entry, gtirb::Addr a) { return entry.first < a; });
+    for (; it != symbols.end() && it->first < end; ++it)
+      f(*it->second);
+  }
+
+  /// Return true if the instruction is a NOP that can be merged with the
+  /// adjacent ones into a single padding directive.
+  virtual bool isNop(const cs_insn& inst) const;
+
+  /// Return true if runs of NOPs are printed as a single `.nops` directive.
+  bool useNopsDirective() const {
+    return policy.nopsDirective && syntax.hasNopsDirective();
+  }
+
+  /// Print a run of instructions as raw bytes. The run is printed as a
+  /// single directive, or as one directive per instruction followed by its
+  /// disassembly if passthrough comments are enabled.
+  ///
+  /// \param os    the output stream to print to
+  /// \param first the first instruction of the run
+  /// \param last  one past the last instruction of the run
+  virtual void printPassthroughInstructions(std::ostream& os,
+                                            const cs_insn* first,
+                                            const cs_insn* last);
 
   /// Print a single instruction to the stream. This implementation prints the
   /// mnemonic provided by Capstone, then calls printOperandList(). Thus, it is
@@ -251,15 +996,23 @@ protected:
   /// \param insnOffset   the offset of the instruction
   virtual void printInstruction(std::ostream& os, const cs_insn& inst,
                                 const gtirb::Offset& offset);
+  /// Print the lower-case mnemonic and the operands of an instruction.
+  void printOpcodeAndOperands(std::ostream& os, const cs_insn& inst);
 
+  /// Print the indentation of an instruction, and its address in debug
+  /// mode.
   virtual void printEA(std::ostream& os, gtirb::Addr ea);
   virtual void printOperandList(std::ostream& os, const cs_insn& inst);
   virtual void printComments(std::ostream& os, const gtirb::Offset& offset,
                              uint64_t range);
   virtual void printCFIDirectives(std::ostream& os, const gtirb::Offset& ea);
+  bool hasCFIDirectives(const gtirb::Offset& offset) const;
   virtual void printSymbolicData(std::ostream& os,
                                  const gtirb::SymbolicExpression* symbolic,
                                  const gtirb::DataBlock& dataObject);
+  virtual void
+  printSymbolicDataValue(std::ostream& os,
+                         const gtirb::SymbolicExpression* symbolic);
   virtual void printSymbolicExpression(std::ostream& os,
                                        const gtirb::SymAddrConst* sexpr,
                                        bool inData = false);
@@ -294,6 +1047,19 @@ protected:
   virtual void printDataBlockType(std::ostream& os,
                                   const gtirb::DataBlock& dataObject);
 
+  /// Return true if the data object has an entry in the "encodings" AuxData
+  /// table.
+  bool hasDataEncoding(const gtirb::DataBlock& dataObject) const;
+
+  /// Return true if the symbolic data object can be appended to the
+  /// multi-value directive printed for the preceding data objects.
+  ///
+  /// \param dataObject the data object to check
+  bool continuesSymbolicDataRun(const gtirb::DataBlock& dataObject) const;
+
+  /// Terminate the pending multi-value data directive, if there is one.
+  void endSymbolicDataRun(std::ostream& os);
+
   virtual bool
   shouldExcludeDataElement(const gtirb::Section& section,
                            const gtirb::DataBlock& dataObject) const;
@@ -327,6 +1093,9 @@ protected:
 
   bool isSectionSkipped(const std::string& name);
 
+  /// Indentation printed in front of instructions and data directives.
+  const std::string& indent() const;
+
   csh csHandle;
 
   bool debug;
@@ -335,17 +1104,191 @@ protected:
   gtirb::Module& module;
 
   virtual std::string getFunctionName(gtirb::Addr x) const;
-  virtual std::string getSymbolName(gtirb::Addr x) const;
-  virtual std::optional<std::string>
-  getForwardedSymbolName(const gtirb::Symbol* symbol, bool inData) const;
-  std::string getForwardedSymbolEnding(const gtirb::Symbol* symbol,
+  /// Print the local label of an address.
+  virtual void printSymbolName(std::ostream& os, gtirb::Addr x) const;
+  /// Print the name a symbol is forwarded to, if any.
+  ///
+  /// \return true if the symbol is forwarded and its name was printed
+  virtual bool printForwardedSymbolName(std::ostream& os,
+                                        const gtirb::Symbol* symbol,
+                                        bool inData) const;
+  const char* getForwardedSymbolEnding(const gtirb::Symbol* symbol,
                                        bool inData) const;
 
   bool isAmbiguousSymbol(const std::string& ea) const;
 
 private:
-  std::set<gtirb::Addr> functionEntry;
-  std::set<gtirb::Addr> functionLastBlock;
+  /// The sidecar file of the module, if the policy names one and it is
+  /// valid, mapped into memory.
+  struct Sidecar;
+  std::unique_ptr<const Sidecar> sidecar;
+  /// Raw Capstone records of the instructions decoded in this run that are
+  /// not in the sidecar, to be merged into it.
+  std::vector<char> sidecarAdded;
+
+  /// Map the sidecar file named by the policy, and resolve its index if
+  /// \p resolveIndex is set. Return nothing if there is no such file, or
+  /// if it does not match the module.
+  std::unique_ptr<const Sidecar> mapSidecar(cs_arch arch,
+                                            bool resolveIndex) const;
+  std::string sidecarPath() const;
+
+  /// Copy the decoded instruction at \p bytes of \p size bytes from the
+  /// sidecar into \p inst. Return false if it is not there.
+  bool findSidecarInstruction(const uint8_t* bytes, uint64_t size,
+                              uint64_t address, cs_insn& inst) const;
+  void addSidecarInstruction(const cs_insn& inst);
+  void saveSidecar() const;
+
+  /// The instructions of the blocks of the chunk being printed by
+  /// printTogether, decoded once for all of its printers. Null when
+  /// printing alone.
+  struct SharedDecode;
+  SharedDecode* sharedDecode = nullptr;
+  /// Copies of the shared instructions of a block printed with the
+  /// passthrough policy, adapted to this printer.
+  std::vector<cs_insn> sharedCopies;
+  std::vector<cs_detail> sharedCopyDetails;
+
+  /// Copy the shared instruction \p from into \p to, keeping the detail
+  /// buffer of \p to, and adapt it to this printer.
+  void copySharedInstruction(const cs_insn& from, cs_insn& to,
+                             const uint8_t* bytes);
+
+  std::shared_ptr<const ModuleIndex> index;
+  const std::vector<gtirb::Addr>& functionEntry;
+  const std::vector<gtirb::Addr>& functionLastBlock;
+
+  /// The architecture and mode csHandle was opened with, to return it to the
+  /// thread's pool of Capstone handles.
+  cs_arch csArch;
+  cs_mode csMode;
+
+  /// Whether the function starting at the same index of functionEntry is
+  /// skipped. Filled in on first use, so that each function name is only
+  /// built once.
+  mutable std::vector<std::optional<bool>> functionSkipped;
+
+  /// Register names indexed by Capstone register id, filled in on first use.
+  mutable std::vector<std::optional<std::string>> registerNames;
+
+  /// Consecutive symbolic data objects of the same width are printed as a
+  /// single directive (e.g. `.quad a, b, c`). This records the end address
+  /// and the width of the values in the directive being printed.
+  struct SymbolicDataRun {
+    gtirb::Addr end;
+    uint64_t size;
+  };
+  std::optional<SymbolicDataRun> symbolicDataRun;
+
+  /// The byte interval of the code block being printed, if any.
+  const gtirb::ByteInterval* blockInterval = nullptr;
+  const gtirb::ByteInterval* findBlockInterval(gtirb::Addr begin,
+                                               gtirb::Addr end) const;
+
+  /// The module's "encodings" AuxData table, looked up once instead of for
+  /// every data object, or null if it has none.
+  const std::map<gtirb::UUID, std::string>* dataEncodings = nullptr;
+
+  /// The binary file receiving the data included with `.incbin`, and the
+  /// number of bytes written to it so far.
+  std::ofstream incbinStream;
+  uint64_t incbinOffset = 0;
+  /// The absolute path of the file, quoted for the assembler.
+  std::string incbinQuotedPath;
+
+  /// The text kept by the caches below, and the buffers text is printed
+  /// to before it is kept. Printing an instruction or a block to them does
+  /// not allocate once they have grown to size.
+  TextArena textArena;
+  ScratchBuf renderText;
+  std::ostream renderStream{&renderText};
+  ScratchBuf chunkText;
+  std::ostream chunkStream{&chunkText};
+
+  /// Text printed by printOpcodeAndOperands for instructions without
+  /// symbolic operands and PC-relative encodings, keyed by their bytes.
+  /// Such text does not depend on where the instruction is, so equal bytes
+  /// are formatted, and decoded, only once. Keys and texts are in
+  /// textArena.
+  using RenderCache = std::unordered_map<std::string_view, std::string_view>;
+  static constexpr uint64_t MaxInstructionSize = 15;
+  RenderCache renderCache;
+  /// Bit n is set if renderCache has a key of n bytes.
+  uint32_t renderCacheKeySizes = 0;
+  uint64_t renderCacheHits = 0;
+  uint64_t renderCacheMisses = 0;
+  /// Whether entries were added since the cache was loaded from the file.
+  bool renderCacheChanged = false;
+
+  void loadRenderCache();
+  void saveRenderCache() const;
+
+  /// Position of the output and source map being built, if the policy asks
+  /// for a source map. sourcePosition points to the stream being printed
+  /// to, which is a temporary one while a block is printed for the output
+  /// cache.
+  std::unique_ptr<OutputPosition> outputPosition;
+  std::unique_ptr<std::ostream> positionStream;
+  OutputPosition* sourcePosition = nullptr;
+  SourceMap sourceMap;
+  std::unordered_map<std::string, uint32_t> sourceMapFunctions;
+  const gtirb::UUID* sourceBlock = nullptr;
+  uint32_t sourceFunction = SourceMap::NoFunction;
+
+  /// Return the stream to print \p os through, counting the output if a
+  /// source map is requested.
+  std::ostream& startSourceMap(std::ostream& os);
+  /// Attribute the following source map entries to the block at \p addr.
+  void beginSourceBlock(const gtirb::UUID& block, gtirb::Addr addr);
+  void addSourceMapEntry(gtirb::Addr ea);
+
+  /// Text printed for chunks, keyed by the hash of their inputs, which do
+  /// not include the address of the chunk. The text of a chunk that
+  /// depends on its address only matches at that address. The text points
+  /// into the mapped cache file or into textArena.
+  using ChunkHash = std::pair<uint64_t, uint64_t>;
+  struct ChunkHashHasher {
+    size_t operator()(const ChunkHash& h) const { return h.first; }
+  };
+  struct OutputCacheEntry {
+    std::string_view text;
+    std::optional<gtirb::Addr> address;
+    bool used;
+  };
+  struct OutputCacheChunk {
+    ChunkHash key;
+    std::optional<gtirb::Addr> address;
+    std::string_view text;
+  };
+  struct MappedCacheFile;
+  std::unique_ptr<const MappedCacheFile> outputCacheData;
+  std::vector<OutputCacheChunk> outputCacheAdded;
+  std::unordered_multimap<ChunkHash, OutputCacheEntry, ChunkHashHasher>
+      outputCache;
+  /// Set while printing a chunk if its text depends on its address.
+  bool outputCacheAddressDependent = false;
+
+  /// Hash the chunk blocks[begin, end), printed after a block ending at
+  /// \p last. The blocks are hashed by hashBlock and hashDataBlock.
+  ChunkHash hashChunk(const std::vector<ModuleIndex::Block>& blocks,
+                      size_t begin, size_t end, gtirb::Addr last);
+  ChunkHash hashBlock(const gtirb::CodeBlock& x);
+  void hashDataBlock(std::ostream& hs, const gtirb::DataBlock& x);
+  /// Hash the symbolic expressions from \p begin to \p end as printed.
+  void hashSymbolicExpressions(std::ostream& hs, gtirb::Addr begin,
+                               gtirb::Addr end);
+  void noteAddressDependence(const cs_insn& inst);
+  void loadOutputCache();
+  void saveOutputCache() const;
+
+  bool isRenderCacheable(const cs_insn& inst) const;
+  const RenderCache::value_type*
+  findRenderedInstruction(const uint8_t* bytes, uint64_t size, gtirb::Addr ea);
+  /// Return the text of \p inst, kept in the render cache if there is room
+  /// and otherwise valid until the next call.
+  std::string_view renderInstruction(const cs_insn& inst,
+                                     const uint8_t* bytes);
 };
 
 /// !brief Register AuxData types used by the pretty printer.
@@ -0,0 +1,105 @@
+//===- SourceMap.hpp --------------------------------------------*- C++ -*-===//
+//
+//  Copyright (C) 2020 GrammaTech, Inc.
+//
+//  This code is licensed under the MIT license. See the LICENSE file in the
+//  project root for license terms.
+//
+//  This project is sponsored by the Office of Naval Research, One Liberty
+//  Center, 875 N. Randolph Street, Arlington, VA 22203 under contract #
+//  N68335-17-C-0700.  The content of the information does not necessarily
+//  reflect the position or policy of the Government and no official
+//  endorsement should be inferred.
+//
+//===----------------------------------------------------------------------===//
+#ifndef GTIRB_PP_SOURCE_MAP_H
+#define GTIRB_PP_SOURCE_MAP_H
+
+#include <gtirb/gtirb.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace gtirb_pprint {
+
+/// Maps positions in printed assembly to the addresses they were printed
+/// from. There is an entry for every printed instruction and data object,
+/// in output order. Blocks copied from the output cache have a single entry
+/// at their first line.
+///
+/// The file starts with the 8 bytes "GTSMAP01", followed by little-endian
+/// integers: the number of function names and the names (each a uint32
+/// length and the bytes), the number of entries (uint64) and the entries,
+/// and finally the entry indexes sorted by address (uint32 each). An entry
+/// is the output offset, the output line (uint64 each), the address
+/// (uint64), the block UUID (16 bytes) and the function index (uint32,
+/// NoFunction if the address is outside all functions).
+class SourceMap {
+public:
+  static constexpr uint32_t NoFunction = UINT32_MAX;
+
+  struct Entry {
+    uint64_t offset;
+    uint64_t line;
+    uint64_t address;
+    gtirb::UUID block;
+    uint32_t function;
+  };
+
+  std::vector<std::string> functions;
+  std::vector<Entry> entries;
+
+  /// Write the map to \p path, sorting the address index. Return false if
+  /// the file could not be written.
+  bool save(const std::string& path) const;
+
+  /// Read a map written by save. The lookups below only work on maps read
+  /// this way.
+  static std::optional<SourceMap> load(const std::string& path);
+
+  /// Return the last entry at or before the output offset.
+  const Entry* findByOffset(uint64_t offset) const;
+  /// Return the first entry on the output line, or the last one before it.
+  const Entry* findByLine(uint64_t line) const;
+  /// Return the first printed entry of the last address at or below
+  /// \p address.
+  const Entry* findByAddress(uint64_t address) const;
+
+private:
+  /// Entry indexes sorted by address, then by output offset.
+  std::vector<uint32_t> byAddress;
+};
+
+/// A stream buffer forwarding the output to another one while keeping track
+/// of the byte offset and the line of the next character written.
+class OutputPosition : public std::streambuf {
+public:
+  explicit OutputPosition(std::streambuf* target);
+  ~OutputPosition() override;
+
+  /// Return the byte offset of the next character.
+  uint64_t offset() const { return flushed + (pptr() - pbase()); }
+  /// Return the line, counting from 1, of the next character.
+  uint64_t line();
+
+protected:
+  int_type overflow(int_type c) override;
+  int sync() override;
+
+private:
+  bool flush();
+
+  std::streambuf* target;
+  char buffer[1 << 14];
+  /// The part of the buffer before this has been counted in lines.
+  const char* scanned;
+  uint64_t flushed = 0;
+  uint64_t lines = 1;
+};
+
+} // namespace gtirb_pprint
+
+#endif /* GTIRB_PP_SOURCE_MAP_H */
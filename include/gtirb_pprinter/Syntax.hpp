@@ -15,6 +15,7 @@
 #ifndef GTIRB_PP_SYNTAX_H
 #define GTIRB_PP_SYNTAX_H
 
+#include <iosfwd>
 #include <optional>
 #include <string>
 
@@ -36,6 +37,9 @@ public:
   // Directives
   virtual const std::string& nop() const { return NopDirective; }
   virtual const std::string& zeroByte() const { return ZeroByteDirective; }
+  virtual const std::string& incbin() const { return IncbinDirective; }
+  virtual const std::string& nops() const { return NopsDirective; }
+  virtual const std::string& set() const { return SetDirective; }
   virtual const std::string& string() const = 0;
 
   virtual const std::string& byteData() const = 0;
@@ -51,10 +55,19 @@ public:
   virtual const std::string& global() const = 0;
   virtual const std::string& align() const = 0;
 
+  // Assembler capabilities, used only if enabled in the printing policy
+  /// Whether the assembler can accept `.nops N` to emit N bytes of padding.
+  virtual bool hasNopsDirective() const { return false; }
+  /// Whether the assembler can accept the endbr64 instruction.
+  virtual bool hasEndbr64() const { return false; }
+
   // Formatting helpers
   virtual std::string formatSectionName(const std::string& x) const;
   virtual std::string formatFunctionName(const std::string& x) const;
   virtual std::string formatSymbolName(const std::string& x) const;
+  /// Print formatSymbolName(x) without building a new string. Syntaxes that
+  /// override one of the two have to override both.
+  virtual void printSymbolName(std::ostream& os, const std::string& x) const;
   virtual std::string avoidRegNameConflicts(const std::string& x) const;
 
   virtual std::optional<std::string> getSizeName(uint64_t bits) const;
@@ -64,6 +77,9 @@ protected:
 
   std::string NopDirective{"nop"};
   std::string ZeroByteDirective{".byte 0x00"};
+  std::string IncbinDirective{".incbin"};
+  std::string NopsDirective{".nops"};
+  std::string SetDirective{".set"};
 
   std::string TextSection{".text"};
   std::string DataSection{".data"};
@@ -0,0 +1,35 @@
+//===- diff_utils.hpp -------------------------------------------*- C++ -*-===//
+//
+//  Copyright (C) 2020 GrammaTech, Inc.
+//
+//  This code is licensed under the MIT license. See the LICENSE file in the
+//  project root for license terms.
+//
+//  This project is sponsored by the Office of Naval Research, One Liberty
+//  Center, 875 N. Randolph Street, Arlington, VA 22203 under contract #
+//  N68335-17-C-0700.  The content of the information does not necessarily
+//  reflect the position or policy of the Government and no official
+//  endorsement should be inferred.
+//
+//===----------------------------------------------------------------------===//
+#ifndef GTIRB_PP_DIFF_UTILS_H
+#define GTIRB_PP_DIFF_UTILS_H
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Split \p text into lines, without the line terminators.
+std::vector<std::string_view> split_lines(std::string_view text);
+
+/// Write the differences between the lines \p a and \p b to \p os as a
+/// unified diff with \p context lines of context, headed by the names of
+/// the two sides. Nothing is written if the lines are equal.
+void write_unified_diff(std::ostream& os,
+                        const std::vector<std::string_view>& a,
+                        const std::vector<std::string_view>& b,
+                        const std::string& aName, const std::string& bName,
+                        size_t context = 3);
+
+#endif /* GTIRB_PP_DIFF_UTILS_H */
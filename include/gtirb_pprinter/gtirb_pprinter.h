@@ -0,0 +1,145 @@
+//===- gtirb_pprinter.h -----------------------------------------*- C -*-===//
+//
+//  Copyright (C) 2020 GrammaTech, Inc.
+//
+//  This code is licensed under the MIT license. See the LICENSE file in the
+//  project root for license terms.
+//
+//  This project is sponsored by the Office of Naval Research, One Liberty
+//  Center, 875 N. Randolph Street, Arlington, VA 22203 under contract #
+//  N68335-17-C-0700.  The content of the information does not necessarily
+//  reflect the position or policy of the Government and no official
+//  endorsement should be inferred.
+//
+//===----------------------------------------------------------------------===//
+#ifndef GTIRB_PP_C_API_H
+#define GTIRB_PP_C_API_H
+
+/// \file gtirb_pprinter.h
+/// \brief C interface to the pretty printer and the binary printer, for
+/// embedding them in other programs and languages.
+///
+/// An IR is loaded once, or borrowed from a C++ caller, and printed any
+/// number of times with sessions holding the printing options. The indexes
+/// of a module are built on its first print and kept with the IR. Modules
+/// without addresses are printed with computed ones, kept in the indexes;
+/// the IR itself is not modified.
+///
+/// Functions returning an int return 0 on success and -1 on failure, and
+/// functions returning a pointer return NULL on failure; the reason is
+/// then given by gtirb_pprint_last_error. Passing NULL where an argument is
+/// not optional also fails. An IR must not be used by two threads at once;
+/// different IRs can be printed concurrently.
+
+#include <stddef.h>
+
+#if defined(_MSC_VER)
+#if defined(gtirb_pprinter_c_EXPORTS)
+#define GTIRB_PPRINT_C_API __declspec(dllexport)
+#else
+#define GTIRB_PPRINT_C_API __declspec(dllimport)
+#endif
+#else
+#define GTIRB_PPRINT_C_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// A loaded or borrowed IR, with the indexes of its printed modules.
+typedef struct gtirb_pprint_ir gtirb_pprint_ir;
+
+/// Printing options: the target, the selected and skipped functions, and
+/// the output style.
+typedef struct gtirb_pprint_session gtirb_pprint_session;
+
+/// Return the reason the last failing call of this thread failed.
+GTIRB_PPRINT_C_API const char* gtirb_pprint_last_error(void);
+
+/// Load the IR in the file at \p path.
+GTIRB_PPRINT_C_API gtirb_pprint_ir* gtirb_pprint_ir_load(const char* path);
+
+/// Load the IR serialized in the \p size bytes at \p data.
+GTIRB_PPRINT_C_API gtirb_pprint_ir*
+gtirb_pprint_ir_load_buffer(const void* data, size_t size);
+
+/// Wrap an IR owned by a C++ caller, given as a gtirb::Context* and a
+/// gtirb::IR*, without copying it. Both must outlive the returned handle.
+GTIRB_PPRINT_C_API gtirb_pprint_ir* gtirb_pprint_ir_borrow(void* context,
+                                                           void* ir);
+
+/// Free the handle, and the IR if it was loaded by this interface.
+GTIRB_PPRINT_C_API void gtirb_pprint_ir_free(gtirb_pprint_ir* ir);
+
+/// Return the number of modules of the IR.
+GTIRB_PPRINT_C_API int gtirb_pprint_ir_module_count(const gtirb_pprint_ir* ir);
+
+/// Return the name of module \p module, valid as long as the IR is.
+GTIRB_PPRINT_C_API const char*
+gtirb_pprint_ir_module_name(const gtirb_pprint_ir* ir, int module);
+
+/// Create a session with the default options.
+GTIRB_PPRINT_C_API gtirb_pprint_session* gtirb_pprint_session_create(void);
+
+GTIRB_PPRINT_C_API void
+gtirb_pprint_session_free(gtirb_pprint_session* session);
+
+/// Print with \p format and \p syntax. A NULL or empty format uses the
+/// format of each module, and a NULL or empty syntax the default syntax
+/// of the format. Fails if the combination is not registered.
+GTIRB_PPRINT_C_API int
+gtirb_pprint_session_set_target(gtirb_pprint_session* session,
+                                const char* format, const char* syntax);
+
+/// Equivalents of the gtirb-pprinter options of the same names.
+GTIRB_PPRINT_C_API int
+gtirb_pprint_session_select_function(gtirb_pprint_session* session,
+                                     const char* name);
+GTIRB_PPRINT_C_API int
+gtirb_pprint_session_select_section(gtirb_pprint_session* session,
+                                    const char* name);
+GTIRB_PPRINT_C_API int
+gtirb_pprint_session_skip_function(gtirb_pprint_session* session,
+                                   const char* name);
+GTIRB_PPRINT_C_API int
+gtirb_pprint_session_keep_function(gtirb_pprint_session* session,
+                                   const char* name);
+GTIRB_PPRINT_C_API int
+gtirb_pprint_session_set_minimal(gtirb_pprint_session* session, int minimal);
+GTIRB_PPRINT_C_API int
+gtirb_pprint_session_set_debug(gtirb_pprint_session* session, int debug);
+GTIRB_PPRINT_C_API int
+gtirb_pprint_session_set_passthrough(gtirb_pprint_session* session,
+                                     int passthrough, int comments);
+
+/// Print module \p module of \p ir into a buffer allocated with malloc,
+/// which the caller frees with gtirb_pprint_free. The text is followed by
+/// a NUL byte that \p size does not count.
+GTIRB_PPRINT_C_API int gtirb_pprint_print(gtirb_pprint_session* session,
+                                          gtirb_pprint_ir* ir, int module,
+                                          char** text, size_t* size);
+
+/// Print module \p module of \p ir to the file descriptor \p fd, as it is
+/// printed.
+GTIRB_PPRINT_C_API int gtirb_pprint_print_fd(gtirb_pprint_session* session,
+                                             gtirb_pprint_ir* ir, int module,
+                                             int fd);
+
+/// Build the binary \p output from all the modules of \p ir, as
+/// gtirb-binary-printer does, passing the \p argCount \p compilerArgs to
+/// the compiler.
+GTIRB_PPRINT_C_API int gtirb_pprint_link(gtirb_pprint_session* session,
+                                         gtirb_pprint_ir* ir,
+                                         const char* output,
+                                         const char* const* compilerArgs,
+                                         size_t argCount);
+
+/// Free a buffer returned by gtirb_pprint_print.
+GTIRB_PPRINT_C_API void gtirb_pprint_free(void* buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GTIRB_PP_C_API_H */
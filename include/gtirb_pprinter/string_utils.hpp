@@ -15,9 +15,13 @@
 #ifndef GTIRB_PP_STRING_UTILS_H
 #define GTIRB_PP_STRING_UTILS_H
 
+#include <ostream>
 #include <string>
 
 std::string ascii_str_tolower(std::string s);
 std::string ascii_str_toupper(std::string s);
 
+/// Write \p s to \p os in lower case without building a temporary string.
+std::ostream& ascii_write_lower(std::ostream& os, const char* s);
+
 #endif /* GTIRB_PP_STRING_UTILS_H */
@@ -0,0 +1,259 @@
+"""In-process printing of GTIRB files, over the gtirb_pprinter_c library.
+
+    ir = gtirb_pprint.IR.load("hello.gtirb")
+    session = gtirb_pprint.Session(format="elf", syntax="intel")
+    session.select_function("main")
+    text = session.print(ir, module=0)
+
+The library is found through the GTIRB_PPRINTER_C_LIBRARY environment
+variable, or else on the library search path.
+"""
+import ctypes
+import ctypes.util
+import os
+
+
+class PrinterError(Exception):
+    pass
+
+
+def _find_library():
+    path = os.environ.get("GTIRB_PPRINTER_C_LIBRARY")
+    if path:
+        return path
+    return ctypes.util.find_library("gtirb_pprinter_c")
+
+
+def _load_library():
+    path = _find_library()
+    if not path:
+        raise ImportError("the gtirb_pprinter_c library was not found")
+    lib = ctypes.CDLL(path)
+    c_char_pp = ctypes.POINTER(ctypes.c_char_p)
+    signatures = {
+        "last_error": (ctypes.c_char_p, []),
+        "ir_load": (ctypes.c_void_p, [ctypes.c_char_p]),
+        "ir_load_buffer": (
+            ctypes.c_void_p,
+            [ctypes.c_char_p, ctypes.c_size_t],
+        ),
+        "ir_free": (None, [ctypes.c_void_p]),
+        "ir_module_count": (ctypes.c_int, [ctypes.c_void_p]),
+        "ir_module_name": (ctypes.c_char_p, [ctypes.c_void_p, ctypes.c_int]),
+        "session_create": (ctypes.c_void_p, []),
+        "session_free": (None, [ctypes.c_void_p]),
+        "session_set_target": (
+            ctypes.c_int,
+            [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p],
+        ),
+        "session_select_function": (
+            ctypes.c_int,
+            [ctypes.c_void_p, ctypes.c_char_p],
+        ),
+        "session_select_section": (
+            ctypes.c_int,
+            [ctypes.c_void_p, ctypes.c_char_p],
+        ),
+        "session_skip_function": (
+            ctypes.c_int,
+            [ctypes.c_void_p, ctypes.c_char_p],
+        ),
+        "session_keep_function": (
+            ctypes.c_int,
+            [ctypes.c_void_p, ctypes.c_char_p],
+        ),
+        "session_set_minimal": (ctypes.c_int, [ctypes.c_void_p, ctypes.c_int]),
+        "session_set_debug": (ctypes.c_int, [ctypes.c_void_p, ctypes.c_int]),
+        "session_set_passthrough": (
+            ctypes.c_int,
+            [ctypes.c_void_p, ctypes.c_int, ctypes.c_int],
+        ),
+        "print": (
+            ctypes.c_int,
+            [
+                ctypes.c_void_p,
+                ctypes.c_void_p,
+                ctypes.c_int,
+                ctypes.POINTER(ctypes.c_void_p),
+                ctypes.POINTER(ctypes.c_size_t),
+            ],
+        ),
+        "print_fd": (
+            ctypes.c_int,
+            [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_int],
+        ),
+        "link": (
+            ctypes.c_int,
+            [
+                ctypes.c_void_p,
+                ctypes.c_void_p,
+                ctypes.c_char_p,
+                c_char_pp,
+                ctypes.c_size_t,
+            ],
+        ),
+        "free": (None, [ctypes.c_void_p]),
+    }
+    for name, (restype, argtypes) in signatures.items():
+        function = getattr(lib, "gtirb_pprint_" + name)
+        function.restype = restype
+        function.argtypes = argtypes
+    return lib
+
+
+_lib = _load_library()
+
+
+def _check(result):
+    if result is None or result == -1:
+        raise PrinterError(_lib.gtirb_pprint_last_error().decode())
+    return result
+
+
+def _encode(s):
+    return s.encode() if s is not None else None
+
+
+class IR:
+    """A GTIRB IR loaded by the library, with the indexes of its printed
+    modules. An IR must not be printed from two threads at once."""
+
+    def __init__(self, handle):
+        self._handle = handle
+
+    @classmethod
+    def load(cls, path):
+        return cls(_check(_lib.gtirb_pprint_ir_load(os.fsencode(path))))
+
+    @classmethod
+    def from_bytes(cls, data):
+        return cls(_check(_lib.gtirb_pprint_ir_load_buffer(data, len(data))))
+
+    def close(self):
+        if self._handle:
+            _lib.gtirb_pprint_ir_free(self._handle)
+            self._handle = None
+
+    def __del__(self):
+        self.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    @property
+    def module_names(self):
+        count = _lib.gtirb_pprint_ir_module_count(self._handle)
+        return [
+            _lib.gtirb_pprint_ir_module_name(self._handle, i).decode()
+            for i in range(count)
+        ]
+
+
+class Session:
+    """Printing options, equivalent to those of gtirb-pprinter."""
+
+    def __init__(self, format=None, syntax=None):
+        self._handle = _check(_lib.gtirb_pprint_session_create())
+        if format or syntax:
+            self.set_target(format, syntax)
+
+    def __del__(self):
+        if self._handle:
+            _lib.gtirb_pprint_session_free(self._handle)
+            self._handle = None
+
+    def set_target(self, format, syntax=None):
+        _check(
+            _lib.gtirb_pprint_session_set_target(
+                self._handle, _encode(format), _encode(syntax)
+            )
+        )
+
+    def select_function(self, name):
+        _check(
+            _lib.gtirb_pprint_session_select_function(
+                self._handle, name.encode()
+            )
+        )
+
+    def select_section(self, name):
+        _check(
+            _lib.gtirb_pprint_session_select_section(
+                self._handle, name.encode()
+            )
+        )
+
+    def skip_function(self, name):
+        _check(
+            _lib.gtirb_pprint_session_skip_function(
+                self._handle, name.encode()
+            )
+        )
+
+    def keep_function(self, name):
+        _check(
+            _lib.gtirb_pprint_session_keep_function(
+                self._handle, name.encode()
+            )
+        )
+
+    def set_minimal(self, minimal=True):
+        _check(
+            _lib.gtirb_pprint_session_set_minimal(self._handle, int(minimal))
+        )
+
+    def set_debug(self, debug=True):
+        _check(
+            _lib.gtirb_pprint_session_set_debug(self._handle, int(debug))
+        )
+
+    def set_passthrough(self, passthrough=True, comments=False):
+        _check(
+            _lib.gtirb_pprint_session_set_passthrough(
+                self._handle, int(passthrough), int(comments)
+            )
+        )
+
+    def print(self, ir, module=0):
+        """Return the assembly of a module of the IR as a string."""
+        text = ctypes.c_void_p()
+        size = ctypes.c_size_t()
+        _check(
+            _lib.gtirb_pprint_print(
+                self._handle,
+                ir._handle,
+                module,
+                ctypes.byref(text),
+                ctypes.byref(size),
+            )
+        )
+        try:
+            return ctypes.string_at(text, size.value).decode(
+                errors="surrogateescape"
+            )
+        finally:
+            _lib.gtirb_pprint_free(text)
+
+    def print_to_fd(self, ir, fd, module=0):
+        """Write the assembly of a module of the IR to a file descriptor."""
+        _check(
+            _lib.gtirb_pprint_print_fd(self._handle, ir._handle, module, fd)
+        )
+
+    def link(self, ir, output, compiler_args=()):
+        """Build a binary from all the modules of the IR."""
+        args = (ctypes.c_char_p * len(compiler_args))(
+            *[a.encode() for a in compiler_args]
+        )
+        _check(
+            _lib.gtirb_pprint_link(
+                self._handle,
+                ir._handle,
+                os.fsencode(output),
+                args,
+                len(compiler_args),
+            )
+        )
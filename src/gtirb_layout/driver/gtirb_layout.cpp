@@ -4,6 +4,7 @@
 #include <fstream>
 #include <gtirb/gtirb.hpp>
 #include <gtirb_layout/gtirb_layout.hpp>
+#include <gtirb_pprinter/PrettyPrinter.hpp>
 #include <iomanip>
 #include <iostream>
 
@@ -58,13 +59,16 @@ int main(int argc, char** argv) {
     fs::path irPath = irString;
     if (fs::exists(irPath)) {
       LOG_INFO << "Reading GTIRB file: " << irPath << std::endl;
-      std::ifstream in(irPath.string(), std::ios::in | std::ios::binary);
-      ir = gtirb::IR::load(ctx, in);
+      ir = gtirb_pprint::loadIR(ctx, irPath.string());
     } else {
       LOG_ERROR << "GTIRB file not found: " << irPath << std::endl;
       return EXIT_FAILURE;
     }
   }
+  if (!ir) {
+    LOG_ERROR << "Could not read GTIRB file: " << irString << std::endl;
+    return EXIT_FAILURE;
+  }
 
   if (vm.count("remove") == 0) {
     for (auto& M : ir->modules()) {
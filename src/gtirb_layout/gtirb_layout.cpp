@@ -15,6 +15,9 @@
 
 #include "gtirb_layout.hpp"
 #include <gtirb/gtirb.hpp>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 using namespace gtirb;
 using namespace gtirb_layout;
@@ -180,6 +183,94 @@ bool ::gtirb_layout::layoutModule(Module& M) {
   return true;
 }
 
+// Find the interval that must directly follow each interval, because the
+// last code block of the former falls through to the first of the latter.
+// Return false if a fallthrough edge cannot be kept by placing intervals
+// back to back.
+static bool
+findFallthroughIntervals(const Module& M,
+                         std::unordered_map<const ByteInterval*,
+                                            const ByteInterval*>& Next) {
+  const CFG& Cfg = M.getIR()->getCFG();
+  for (auto E : boost::make_iterator_range(boost::edges(Cfg))) {
+    if (!Cfg[E] || std::get<EdgeType>(*Cfg[E]) != EdgeType::Fallthrough) {
+      continue;
+    }
+    const auto* Source = dyn_cast<CodeBlock>(Cfg[boost::source(E, Cfg)]);
+    if (!Source || !Source->getByteInterval() ||
+        Source->getByteInterval()->getSection()->getModule() != &M) {
+      continue;
+    }
+    const auto* Target = dyn_cast<CodeBlock>(Cfg[boost::target(E, Cfg)]);
+    if (!Target) {
+      assert(!"Code block has fallthrough edge into proxy block!");
+      return false;
+    }
+    const ByteInterval* SourceBI = Source->getByteInterval();
+    const ByteInterval* TargetBI = Target->getByteInterval();
+    if (SourceBI == TargetBI) {
+      continue;
+    }
+
+    // Check that they're both from the same section.
+    if (!TargetBI || SourceBI->getSection() != TargetBI->getSection()) {
+      assert(!"Block has fallthrough edge into a block in another "
+              "section!");
+      return false;
+    }
+
+    // Check that, when placed back to back, the two code blocks will be
+    // adjacent.
+    if (Source->getOffset() + Source->getSize() != SourceBI->getSize()) {
+      assert(!"fallthrough edge exists, but source is not at end of "
+              "interval!");
+      return false;
+    }
+    if (Target->getOffset() != 0) {
+      assert(!"fallthrough edge exists, but target is not at start of "
+              "interval!");
+      return false;
+    }
+    Next[SourceBI] = TargetBI;
+  }
+  return true;
+}
+
+bool ::gtirb_layout::computeModuleAddresses(const Module& M,
+                                            AddressMap& Addresses) {
+  std::unordered_map<const ByteInterval*, const ByteInterval*> Next;
+  if (!findFallthroughIntervals(M, Next)) {
+    return false;
+  }
+  std::unordered_set<const ByteInterval*> HasPrevious;
+  for (const auto& [Source, Target] : Next) {
+    HasPrevious.insert(Target);
+  }
+
+  Addresses.clear();
+  Addr A = Addr{0};
+  auto PlaceChain = [&](const ByteInterval* BI) {
+    while (BI && Addresses.emplace(BI, A).second) {
+      A += BI->getSize();
+      auto It = Next.find(BI);
+      BI = It != Next.end() ? It->second : nullptr;
+    }
+  };
+  for (const auto& S : M.sections()) {
+    // Start the chains at the intervals nothing falls through to, then
+    // place whatever is left (e.g. fallthrough cycles) in the original order.
+    for (const auto& BI : S.byte_intervals()) {
+      if (!HasPrevious.count(&BI)) {
+        PlaceChain(&BI);
+      }
+    }
+    for (const auto& BI : S.byte_intervals()) {
+      PlaceChain(&BI);
+    }
+  }
+  return true;
+}
+
 bool ::gtirb_layout::removeModuleLayout(Module& M) {
   std::vector<std::reference_wrapper<Section>> Sections(M.sections_begin(),
                                                         M.sections_end());
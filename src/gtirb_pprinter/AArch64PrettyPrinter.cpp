@@ -19,6 +19,7 @@
 #include "AuxDataSchema.hpp"
 
 #include <capstone/capstone.h>
+#include <iomanip>
 
 namespace gtirb_pprint {
 
@@ -33,6 +34,8 @@ void AArch64PrettyPrinter::printHeader(std::ostream& os) {
     this->printBar(os);
     os << '\n';
 
+    if (policy.minimal)
+        return;
     for (int i = 0; i < 8; i++) {
         os << syntax.nop() << '\n';
     }
@@ -74,19 +77,13 @@ void AArch64PrettyPrinter::printOperand(std::ostream& os,
             return;
         case ARM64_OP_IMM:
             if (finalOp) {
-                auto pos = module.findSymbolicExpressionsAt(ea);
-                if (!pos.empty()) {
-                    symbolic = &pos.begin()->getSymbolicExpression();
-                }
+                symbolic = findSymbolicExpression(ea);
             }
             printOpImmediate(os, symbolic, inst, index);
             return;
         case ARM64_OP_MEM:
             if (finalOp) {
-                auto pos = module.findSymbolicExpressionsAt(ea);
-                if (!pos.empty()) {
-                    symbolic = &pos.begin()->getSymbolicExpression();
-                }
+                symbolic = findSymbolicExpression(ea);
             }
             printOpIndirect(os, symbolic, inst, index);
             return;
@@ -127,7 +124,7 @@ void AArch64PrettyPrinter::printPrefix(std::ostream& os,
 
 void AArch64PrettyPrinter::printOpRegdirect(std::ostream& os,
         const cs_insn& /* inst */, unsigned int reg) {
-    os << getRegisterName(reg);
+    os << registerName(reg);
 }
 
 void AArch64PrettyPrinter::printOpImmediate(std::ostream& os,
@@ -169,7 +166,7 @@ void AArch64PrettyPrinter::printOpIndirect(std::ostream& os,
     // base register
     if (op.mem.base != ARM64_REG_INVALID) {
         first = false;
-        os << getRegisterName(op.mem.base);
+        os << registerName(op.mem.base);
     }
 
     // displacement (constant)
@@ -192,7 +189,7 @@ void AArch64PrettyPrinter::printOpIndirect(std::ostream& os,
             os << ",";
         }
         first = false;
-        os << getRegisterName(op.mem.index);
+        os << registerName(op.mem.index);
     }
 
     // add shift
@@ -426,7 +423,7 @@ void AArch64PrettyPrinter::printExtender(std::ostream& os, const arm64_extender&
 
 }
 
-std::optional<std::string> AArch64PrettyPrinter::getForwardedSymbolName(const gtirb::Symbol* symbol, bool /* inData */) const {
+bool AArch64PrettyPrinter::printForwardedSymbolName(std::ostream& os, const gtirb::Symbol* symbol, bool /* inData */) const {
     const auto* symbolForwarding =
         module.getAuxData<gtirb::schema::SymbolForwarding>();
 
@@ -434,12 +431,79 @@ std::optional<std::string> AArch64PrettyPrinter::getForwardedSymbolName(const gt
         auto found = symbolForwarding->find(symbol->getUUID());
         if (found != symbolForwarding->end()) {
             gtirb::Node* destSymbol = gtirb::Node::getByUUID(context, found->second);
-            return cast<gtirb::Symbol>(destSymbol)->getName();
+            os << cast<gtirb::Symbol>(destSymbol)->getName();
+            return true;
         }
     }
     return {};
 }
 
+bool AArch64PrettyPrinter::isNop(const cs_insn&) const {
+    // NOPs are single fixed-size instructions here, nothing to merge.
+    return false;
+}
+
+bool AArch64PrettyPrinter::isPCRelative(const cs_insn& inst) const {
+    if (cs_insn_group(this->csHandle, &inst, ARM64_GRP_JUMP) ||
+            cs_insn_group(this->csHandle, &inst, CS_GRP_CALL) ||
+            cs_insn_group(this->csHandle, &inst, CS_GRP_BRANCH_RELATIVE)) {
+        return true;
+    }
+    switch (inst.id) {
+        case ARM64_INS_ADR:
+        case ARM64_INS_ADRP:
+        case ARM64_INS_B:
+        case ARM64_INS_BL:
+        case ARM64_INS_CBZ:
+        case ARM64_INS_CBNZ:
+        case ARM64_INS_TBZ:
+        case ARM64_INS_TBNZ:
+            return true;
+        case ARM64_INS_LDR:
+        case ARM64_INS_LDRSW:
+        case ARM64_INS_PRFM: {
+            // literal loads take the address as an immediate operand
+            const cs_arm64& detail = inst.detail->arm64;
+            for (uint8_t i = 0; i < detail.op_count; i++) {
+                if (detail.operands[i].type == ARM64_OP_IMM) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        default:
+            return false;
+    }
+}
+
+void AArch64PrettyPrinter::printPassthroughInstructions(std::ostream& os,
+        const cs_insn* first, const cs_insn* last) {
+    std::ios_base::fmtflags flags = os.flags();
+    char fill = os.fill();
+    os << indent() << elfSyntax.inst() << ' ' << std::hex
+       << std::setfill('0');
+    for (const cs_insn* inst = first; inst != last; ++inst) {
+        if (inst != first) {
+            if (policy.passthroughComments) {
+                os << '\n' << indent() << elfSyntax.inst() << ' ';
+            } else {
+                os << ',';
+            }
+        }
+        // instructions are always encoded as little-endian words
+        uint32_t word = inst->bytes[0] | inst->bytes[1] << 8 |
+                        inst->bytes[2] << 16 |
+                        static_cast<uint32_t>(inst->bytes[3]) << 24;
+        os << "0x" << std::setw(8) << word;
+        if (policy.passthroughComments) {
+            os << ' ' << syntax.comment() << ' ' << inst->mnemonic << ' '
+               << inst->op_str;
+        }
+    }
+    os.flags(flags);
+    os.fill(fill);
+}
+
 const PrintingPolicy& AArch64PrettyPrinterFactory::defaultPrintingPolicy() const {
   static PrintingPolicy DefaultPolicy{
       /// Sections to avoid printing.
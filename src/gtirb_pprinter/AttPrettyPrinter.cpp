@@ -16,6 +16,8 @@
 #include "AttPrettyPrinter.hpp"
 #include "string_utils.hpp"
 #include "version.h"
+#include <algorithm>
+#include <cstring>
 #include <iomanip>
 
 namespace gtirb_pprint {
@@ -40,7 +42,7 @@ void AttPrettyPrinter::printOpRegdirect(std::ostream& os, const cs_insn& inst,
   if (cs_insn_group(this->csHandle, &inst, CS_GRP_CALL) ||
       cs_insn_group(this->csHandle, &inst, CS_GRP_JUMP))
     os << '*';
-  os << getRegisterName(reg);
+  os << registerName(reg);
 }
 
 void AttPrettyPrinter::printOpImmediate(
@@ -83,7 +85,7 @@ void AttPrettyPrinter::printOpIndirect(
       cs_insn_group(this->csHandle, &inst, CS_GRP_JUMP))
     os << '*';
   if (has_segment)
-    os << getRegisterName(op.mem.segment) << ':';
+    os << registerName(op.mem.segment) << ':';
 
   if (const auto* s = std::get_if<gtirb::SymAddrConst>(symbolic)) {
     // Displacement is symbolic.
@@ -106,9 +108,9 @@ void AttPrettyPrinter::printOpIndirect(
   if (has_base || has_index) {
     os << '(';
     if (has_base)
-      os << getRegisterName(op.mem.base);
+      os << registerName(op.mem.base);
     if (has_index) {
-      os << ',' << getRegisterName(op.mem.index);
+      os << ',' << registerName(op.mem.index);
       if (op.mem.scale != 1)
         os << ',' << op.mem.scale;
     }
@@ -116,6 +118,84 @@ void AttPrettyPrinter::printOpIndirect(
   }
 }
 
+// Whether two operands are the same, as decoded in either syntax.
+static bool sameOperand(const cs_x86_op& a, const cs_x86_op& b) {
+  if (a.type != b.type || a.size != b.size || a.access != b.access ||
+      a.avx_bcast != b.avx_bcast || a.avx_zero_opmask != b.avx_zero_opmask)
+    return false;
+  switch (a.type) {
+  case X86_OP_REG:
+    return a.reg == b.reg;
+  case X86_OP_IMM:
+    return a.imm == b.imm;
+  case X86_OP_MEM:
+    return a.mem.segment == b.mem.segment && a.mem.base == b.mem.base &&
+           a.mem.index == b.mem.index && a.mem.scale == b.mem.scale &&
+           a.mem.disp == b.mem.disp;
+  default:
+    return true;
+  }
+}
+
+void AttPrettyPrinter::adaptSharedInstruction(cs_insn& inst,
+                                              const uint8_t* bytes) {
+  // The mnemonic and the operand order only depend on the encoding, so
+  // they are taken from an AT&T decode of the first instruction of each
+  // form. The Capstone text is only printed in debug mode, which decodes
+  // every instruction again.
+  cs_x86& x86 = inst.detail->x86;
+  attFormKey.clear();
+  auto appendKey = [this](const auto& value) {
+    attFormKey.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  };
+  appendKey(inst.id);
+  appendKey(x86.prefix);
+  appendKey(x86.opcode);
+  appendKey(x86.rex);
+  appendKey(x86.addr_size);
+  appendKey(x86.modrm);
+  appendKey(x86.op_count);
+  for (uint8_t i = 0; i < x86.op_count; ++i) {
+    appendKey(x86.operands[i].type);
+    appendKey(x86.operands[i].size);
+  }
+
+  cs_x86_op intel[sizeof(cs_x86::operands) / sizeof(cs_x86_op)];
+  std::copy(x86.operands, x86.operands + x86.op_count, intel);
+  if (!this->debug) {
+    auto found = attForms.find(attFormKey);
+    if (found != attForms.end()) {
+      const AttForm& form = found->second;
+      std::strcpy(inst.mnemonic, form.mnemonic);
+      for (uint8_t i = 0; i < x86.op_count; ++i)
+        x86.operands[i] = intel[form.order[i]];
+      return;
+    }
+  }
+
+  const uint8_t intelCount = x86.op_count;
+  const uint8_t* code = bytes;
+  size_t size = inst.size;
+  uint64_t address = inst.address;
+  if (!cs_disasm_iter(this->csHandle, &code, &size, &address, &inst) ||
+      this->debug || x86.op_count != intelCount)
+    return;
+  AttForm form;
+  std::strcpy(form.mnemonic, inst.mnemonic);
+  bool matched[sizeof(intel) / sizeof(cs_x86_op)] = {};
+  for (uint8_t i = 0; i < x86.op_count; ++i) {
+    uint8_t j = 0;
+    while (j < intelCount &&
+           (matched[j] || !sameOperand(x86.operands[i], intel[j])))
+      ++j;
+    if (j == intelCount)
+      return;
+    matched[j] = true;
+    form.order[i] = j;
+  }
+  attForms.emplace(attFormKey, form);
+}
+
 const PrintingPolicy& AttPrettyPrinterFactory::defaultPrintingPolicy() const {
   return ElfPrettyPrinter::defaultPrintingPolicy();
 }
@@ -35,8 +35,10 @@
 #pragma warning(pop)
 #endif // __GNUC__
 #include <iostream>
+#include <memory>
 #include <regex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #ifdef USE_STD_FILESYSTEM_LIB
 #include <filesystem>
@@ -173,9 +175,52 @@ public:
   ~TempFile() {
     if (fs::exists(name))
       fs::remove(name);
+    if (fs::exists(incbinName()))
+      fs::remove(incbinName());
   };
+  /// Name of the binary file holding the data included with `.incbin`.
+  std::string incbinName() const { return name + ".bin"; }
 };
 
+/// Remove the AuxData read by the pretty printer and the binary printer,
+/// and the blocks and symbolic expressions of the byte intervals, from a
+/// module whose assembly has been written. Removing the code blocks also
+/// removes their nodes and edges from the IR's CFG.
+///
+/// The block objects belong to the context, and the bytes to the
+/// intervals, which gtirb cannot shrink; they stay until the IR is freed.
+static void releaseModule(gtirb::Module& module) {
+  using namespace gtirb::schema;
+  module.removeAuxData<Comments>();
+  module.removeAuxData<FunctionEntries>();
+  module.removeAuxData<FunctionBlocks>();
+  module.removeAuxData<SymbolForwarding>();
+  module.removeAuxData<SymbolicOperandInfoAD>();
+  module.removeAuxData<Encodings>();
+  module.removeAuxData<ElfSectionProperties>();
+  module.removeAuxData<CfiDirectives>();
+  module.removeAuxData<Libraries>();
+  module.removeAuxData<LibraryPaths>();
+  for (gtirb::ByteInterval& bi : module.byte_intervals()) {
+    std::vector<uint64_t> offsets;
+    for (const gtirb::SymbolicExpressionElement& se :
+         bi.symbolic_expressions())
+      offsets.push_back(se.getOffset());
+    for (uint64_t offset : offsets)
+      bi.removeSymbolicExpression(offset);
+    std::vector<gtirb::CodeBlock*> codeBlocks;
+    for (gtirb::CodeBlock& block : bi.code_blocks())
+      codeBlocks.push_back(&block);
+    for (gtirb::CodeBlock* block : codeBlocks)
+      bi.removeBlock(block);
+    std::vector<gtirb::DataBlock*> dataBlocks;
+    for (gtirb::DataBlock& block : bi.data_blocks())
+      dataBlocks.push_back(&block);
+    for (gtirb::DataBlock* block : dataBlocks)
+      bi.removeBlock(block);
+  }
+}
+
 int ElfBinaryPrinter::link(std::string outputFilename,
                            const std::vector<std::string>& extraCompilerArgs,
                            const std::vector<std::string>& userLibraryPaths,
@@ -186,21 +231,62 @@ int ElfBinaryPrinter::link(std::string outputFilename,
   std::vector<TempFile> tempFiles(
       std::distance(ir.modules().begin(), ir.modules().end()));
   std::vector<std::string> tempFileNames;
+  for (const TempFile& tempFile : tempFiles)
+    tempFileNames.push_back(tempFile.name);
+  // Read the libraries before printing, as the modules may be released.
+  const std::vector<std::string> compilerArgs =
+      buildCompilerArgs(outputFilename, tempFileNames, extraCompilerArgs,
+                        userLibraryPaths, ir);
+  // Each module is indexed, with computed addresses if it has none, while
+  // the previous one is printed. The slots are created up front, so that
+  // filling one while another is printed does not change the map.
+  std::unordered_map<const gtirb::Module*,
+                     std::shared_ptr<const gtirb_pprint::ModuleIndex>>
+      indexes;
+  for (const gtirb::Module& module : ir.modules())
+    indexes[&module];
   int i = 0;
-  for (gtirb::Module& module : ir.modules()) {
-    if (tempFiles[i].fileStream) {
-      if (debug)
-        std::cout << "Printing module" << module.getName()
-                  << " to temporary file " << tempFiles[i].name << std::endl;
-      pp.print(tempFiles[i].fileStream, ctx, module);
-      tempFiles[i].fileStream.close();
-      tempFileNames.push_back(tempFiles[i].name);
-    } else {
+  auto prepare = [&](gtirb::Module& module) {
+    if (prepareModule)
+      prepareModule(module);
+    indexes.at(&module) =
+        std::make_shared<const gtirb_pprint::ModuleIndex>(ctx, module);
+  };
+  auto print = [&](gtirb::Module& module) {
+    if (!tempFiles[i].fileStream) {
       std::cerr << "ERROR: Could not write assembly into a temporary file.\n";
-      return -1;
+      return false;
     }
+    std::shared_ptr<const gtirb_pprint::ModuleIndex> index =
+        std::move(indexes.at(&module));
+    if (!index->laidOut) {
+      std::cerr << "ERROR: Module " << module.getName()
+                << " cannot be laid out: a code block falls through into "
+                   "another section or into a block that cannot follow "
+                   "it.\n";
+      return false;
+    }
+    if (debug)
+      std::cout << "Printing module" << module.getName()
+                << " to temporary file " << tempFiles[i].name << std::endl;
+    // Nobody reads the temporary assembly, so skip the decorations.
+    gtirb_pprint::PrettyPrinter modulePP(pp);
+    modulePP.setMinimal(true);
+    modulePP.setModuleIndex(std::move(index));
+    if (incbinThreshold)
+      modulePP.setIncbinFile(tempFiles[i].incbinName(), *incbinThreshold);
+    modulePP.print(tempFiles[i].fileStream, ctx, module);
+    tempFiles[i].fileStream.close();
     ++i;
-  }
+    return true;
+  };
+  // Releasing changes the CFG, which is shared with the module being
+  // prepared, so it waits for the preparation.
+  std::function<void(gtirb::Module&)> release;
+  if (releaseModules)
+    release = releaseModule;
+  if (!gtirb_pprint::pipelineModules(ir, prepare, print, release))
+    return -1;
 
   boost::filesystem::path compilerPath = bp::search_path(this->compiler);
   if (compilerPath.empty()) {
@@ -209,9 +295,7 @@ int ElfBinaryPrinter::link(std::string outputFilename,
   }
   if (debug)
     std::cout << "Calling compiler" << std::endl;
-  return bp::system(compilerPath,
-                    buildCompilerArgs(outputFilename, tempFileNames,
-                                      extraCompilerArgs, userLibraryPaths, ir));
+  return bp::system(compilerPath, compilerArgs);
 }
 
 } // namespace gtirb_bprint
@@ -88,16 +88,20 @@ void ElfPrettyPrinter::printFunctionHeader(std::ostream& os, gtirb::Addr addr) {
       syntax.formatFunctionName(this->getFunctionName(addr));
 
   if (!name.empty()) {
-    os << syntax.comment() << " BEGIN - Function Header\n";
-    printBar(os, false);
+    if (!policy.minimal) {
+      os << syntax.comment() << " BEGIN - Function Header\n";
+      printBar(os, false);
+    }
 
     printAlignment(os, addr);
     os << syntax.global() << ' ' << name << '\n';
     os << elfSyntax.type() << ' ' << name << ", @function\n";
     os << name << ":\n";
 
-    printBar(os, false);
-    os << syntax.comment() << " END   - Function Header\n";
+    if (!policy.minimal) {
+      printBar(os, false);
+      os << syntax.comment() << " END   - Function Header\n";
+    }
   }
 }
 
@@ -117,12 +121,9 @@ bool ElfPrettyPrinter::shouldExcludeDataElement(
     const gtirb::Section& section, const gtirb::DataBlock& dataObject) const {
   if (!policy.arraySections.count(section.getName()))
     return false;
-  auto foundSymbolic =
-      module.findSymbolicExpressionsAt(*dataObject.getAddress());
-  if (!foundSymbolic.empty()) {
-    if (const auto* s = std::get_if<gtirb::SymAddrConst>(
-            &foundSymbolic.begin()->getSymbolicExpression())) {
-      return skipEA(*s->Sym->getAddress());
+  if (const auto* expr = findSymbolicExpression(*addressOf(dataObject))) {
+    if (const auto* s = std::get_if<gtirb::SymAddrConst>(expr)) {
+      return skipEA(*addressOf(*s->Sym));
     }
   }
   return false;
@@ -30,6 +30,8 @@ void IntelPrettyPrinter::printHeader(std::ostream& os) {
   this->printBar(os);
   os << '\n';
 
+  if (policy.minimal)
+    return;
   for (int i = 0; i < 8; i++) {
     os << syntax.nop() << '\n';
   }
@@ -38,7 +40,7 @@ void IntelPrettyPrinter::printHeader(std::ostream& os) {
 void IntelPrettyPrinter::printOpRegdirect(std::ostream& os,
                                           const cs_insn& /*inst*/,
                                           unsigned int reg) {
-  os << getRegisterName(reg);
+  os << registerName(reg);
 }
 
 void IntelPrettyPrinter::printOpImmediate(
@@ -75,20 +77,20 @@ void IntelPrettyPrinter::printOpIndirect(
     os << *size << " PTR ";
 
   if (op.mem.segment != X86_REG_INVALID)
-    os << getRegisterName(op.mem.segment) << ':';
+    os << registerName(op.mem.segment) << ':';
 
   os << '[';
 
   if (op.mem.base != X86_REG_INVALID) {
     first = false;
-    os << getRegisterName(op.mem.base);
+    os << registerName(op.mem.base);
   }
 
   if (op.mem.index != X86_REG_INVALID) {
     if (!first)
       os << '+';
     first = false;
-    os << getRegisterName(op.mem.index) << '*' << std::to_string(op.mem.scale);
+    os << registerName(op.mem.index) << '*' << op.mem.scale;
   }
 
   if (const auto* s = std::get_if<gtirb::SymAddrConst>(symbolic)) {
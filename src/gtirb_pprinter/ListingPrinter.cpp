@@ -0,0 +1,250 @@
+//===- ListingPrinter.cpp ---------------------------------------*- C++ -*-===//
+//
+//  Copyright (C) 2020 GrammaTech, Inc.
+//
+//  This code is licensed under the MIT license. See the LICENSE file in the
+//  project root for license terms.
+//
+//  This project is sponsored by the Office of Naval Research, One Liberty
+//  Center, 875 N. Randolph Street, Arlington, VA 22203 under contract #
+//  N68335-17-C-0700.  The content of the information does not necessarily
+//  reflect the position or policy of the Government and no official
+//  endorsement should be inferred.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ListingPrinter.hpp"
+#include <boost/uuid/uuid_io.hpp>
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+
+namespace gtirb_pprint {
+
+template <typename T> static void appendInt(std::string& buffer, T value) {
+  for (size_t i = 0; i < sizeof(T); ++i)
+    buffer.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+}
+
+static void appendString(std::string& buffer, std::string_view s) {
+  appendInt(buffer, static_cast<uint32_t>(s.size()));
+  buffer.append(s);
+}
+
+static void printJsonString(std::ostream& os, std::string_view s) {
+  os << '"';
+  for (char c : s) {
+    switch (c) {
+    case '"':
+      os << "\\\"";
+      break;
+    case '\\':
+      os << "\\\\";
+      break;
+    case '\n':
+      os << "\\n";
+      break;
+    case '\t':
+      os << "\\t";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        std::ios_base::fmtflags flags = os.flags();
+        os << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+           << static_cast<int>(c) << std::setfill(' ');
+        os.flags(flags);
+      } else {
+        os << c;
+      }
+    }
+  }
+  os << '"';
+}
+
+ListingPrinter::ListingPrinter(gtirb::Context& context_,
+                               gtirb::Module& module_,
+                               const ElfSyntax& syntax_,
+                               const PrintingPolicy& policy_, bool json_,
+                               cs_arch arch, cs_mode mode)
+    : ElfPrettyPrinter(context_, module_, syntax_, policy_, arch, mode),
+      json(json_) {
+  // Debugging comments would break the records.
+  this->debug = false;
+  // The records hold the address of each line, which the output cache
+  // does not key its chunks by.
+  this->policy.outputCacheFile.clear();
+}
+
+void ListingPrinter::printHeader(std::ostream& os) {
+  if (!json)
+    os << "GTLIST01";
+}
+
+void ListingPrinter::printFooter(std::ostream& /*os*/) {}
+
+void ListingPrinter::printSectionHeader(std::ostream& /*os*/,
+                                        const gtirb::Addr /*addr*/) {}
+
+void ListingPrinter::printSectionHeaderFor(std::ostream& /*os*/,
+                                           const gtirb::Section& /*section*/,
+                                           const gtirb::Addr /*addr*/) {}
+
+void ListingPrinter::printSectionFooter(
+    std::ostream& /*os*/, const std::optional<const gtirb::Addr> /*addr*/,
+    const gtirb::Addr /*last*/) {}
+
+gtirb::Addr ListingPrinter::printBlockOrWarning(std::ostream& os,
+                                                const gtirb::CodeBlock& x,
+                                                gtirb::Addr last) {
+  // Overlapping blocks are listed too, so that every address is found.
+  printBlock(os, x);
+  return std::max(last, *addressOf(x) + x.getSize());
+}
+
+gtirb::Addr ListingPrinter::printDataBlockOrWarning(std::ostream& os,
+                                                    const gtirb::DataBlock& x,
+                                                    gtirb::Addr last) {
+  printDataBlock(os, x);
+  return std::max(last, *addressOf(x) + x.getSize());
+}
+
+void ListingPrinter::printBlock(std::ostream& os, const gtirb::CodeBlock& x) {
+  const gtirb::Addr addr = *addressOf(x);
+  if (skipEA(addr))
+    return;
+  const std::string function = getContainerFunctionName(addr).value_or("");
+  const auto section = getContainerSection(addr);
+  const std::string& sectionName =
+      section ? (*section)->getName() : std::string();
+
+  const uint8_t* bytes = x.rawBytes<uint8_t>();
+  const uint64_t size = x.getSize();
+  cs_option(this->csHandle, CS_OPT_DETAIL, CS_OPT_OFF);
+  cs_insn* inst = cs_malloc(this->csHandle);
+  std::unique_ptr<cs_insn, std::function<void(cs_insn*)>> freeInst(
+      inst, [](cs_insn* i) { cs_free(i, 1); });
+  const uint8_t* code = bytes;
+  size_t codeSize = size;
+  uint64_t address = static_cast<uint64_t>(addr);
+  while (cs_disasm_iter(this->csHandle, &code, &codeSize, &address, inst)) {
+    printRecord(os, {true, gtirb::Addr(inst->address), inst->size,
+                     x.getUUID(), inst->mnemonic, inst->op_str, function,
+                     sectionName});
+  }
+  // List the bytes Capstone could not decode as a single record.
+  if (codeSize > 0)
+    printRecord(os, {true, gtirb::Addr(address), codeSize, x.getUUID(), "",
+                     "", function, sectionName});
+}
+
+void ListingPrinter::printDataBlock(std::ostream& os,
+                                    const gtirb::DataBlock& dataObject) {
+  const gtirb::Addr addr = *addressOf(dataObject);
+  if (skipEA(addr))
+    return;
+  const auto section = getContainerSection(addr);
+  assert(section && "Found a data object outside all sections");
+  if (shouldExcludeDataElement(**section, dataObject))
+    return;
+  const std::string function = getContainerFunctionName(addr).value_or("");
+  printRecord(os, {false, addr, dataObject.getSize(), dataObject.getUUID(),
+                   "", "", function, (*section)->getName()});
+}
+
+void ListingPrinter::printSymbolDefinitionsAtAddress(std::ostream& /*os*/,
+                                                     gtirb::Addr /*ea*/,
+                                                     bool /*inData*/) {}
+
+void ListingPrinter::printRecord(std::ostream& os, const Record& record) {
+  symbols.clear();
+  forEachSymbolicExpressionIn(
+      record.addr, record.addr + record.size,
+      [this](gtirb::Addr, const gtirb::SymbolicExpression& expr) {
+        if (const auto* s = std::get_if<gtirb::SymAddrConst>(&expr)) {
+          symbols.push_back(s->Sym);
+        } else if (const auto* sa = std::get_if<gtirb::SymAddrAddr>(&expr)) {
+          symbols.push_back(sa->Sym1);
+          symbols.push_back(sa->Sym2);
+        }
+      });
+
+  if (json) {
+    os << "{\"kind\":" << (record.isCode ? "\"instruction\"" : "\"data\"")
+       << ",\"address\":" << static_cast<uint64_t>(record.addr)
+       << ",\"size\":" << record.size << ",\"block\":\""
+       << boost::uuids::to_string(record.block) << "\",\"mnemonic\":";
+    printJsonString(os, record.mnemonic);
+    os << ",\"operands\":";
+    printJsonString(os, record.operands);
+    os << ",\"symbols\":[";
+    for (size_t i = 0; i < symbols.size(); ++i) {
+      if (i > 0)
+        os << ',';
+      printJsonString(os, symbols[i]->getName());
+    }
+    os << "],\"function\":";
+    printJsonString(os, record.function);
+    os << ",\"section\":";
+    printJsonString(os, record.section);
+    os << "}\n";
+    return;
+  }
+
+  buffer.clear();
+  appendInt(buffer, static_cast<uint8_t>(record.isCode ? 0 : 1));
+  appendInt(buffer, static_cast<uint64_t>(record.addr));
+  appendInt(buffer, record.size);
+  buffer.append(record.block.begin(), record.block.end());
+  appendString(buffer, record.mnemonic);
+  appendString(buffer, record.operands);
+  appendString(buffer, record.function);
+  appendString(buffer, record.section);
+  appendInt(buffer, static_cast<uint32_t>(symbols.size()));
+  for (const gtirb::Symbol* symbol : symbols)
+    appendString(buffer, symbol->getName());
+
+  std::string length;
+  appendInt(length, static_cast<uint32_t>(buffer.size()));
+  os << length << buffer;
+}
+
+void ListingPrinter::printOpRegdirect(std::ostream& /*os*/,
+                                      const cs_insn& /*inst*/,
+                                      unsigned int /*reg*/) {}
+
+void ListingPrinter::printOpImmediate(
+    std::ostream& /*os*/, const gtirb::SymbolicExpression* /*symbolic*/,
+    const cs_insn& /*inst*/, uint64_t /*index*/) {}
+
+void ListingPrinter::printOpIndirect(
+    std::ostream& /*os*/, const gtirb::SymbolicExpression* /*symbolic*/,
+    const cs_insn& /*inst*/, uint64_t /*index*/) {}
+
+const PrintingPolicy& ListingPrinterFactory::defaultPrintingPolicy() const {
+  return ElfPrettyPrinter::defaultPrintingPolicy();
+}
+
+std::unique_ptr<PrettyPrinterBase>
+ListingPrinterFactory::create(gtirb::Context& gtirb_context,
+                              gtirb::Module& module,
+                              const PrintingPolicy& policy) {
+  static const ElfSyntax syntax{};
+  cs_arch arch = CS_ARCH_X86;
+  cs_mode mode = CS_MODE_64;
+  if (module.getISA() == gtirb::ISA::IA32) {
+    mode = CS_MODE_32;
+  } else if (module.getISA() == gtirb::ISA::ARM64) {
+    arch = CS_ARCH_ARM64;
+    mode = CS_MODE_ARM;
+  }
+  return std::make_unique<ListingPrinter>(gtirb_context, module, syntax,
+                                          policy, json, arch, mode);
+}
+
+volatile bool ListingPrinter::registered =
+    registerPrinter({"elf"}, {"listing"},
+                    std::make_shared<ListingPrinterFactory>(false)) &&
+    registerPrinter({"elf"}, {"listing-json"},
+                    std::make_shared<ListingPrinterFactory>(true));
+
+} // namespace gtirb_pprint
@@ -15,15 +15,33 @@
 #include "PrettyPrinter.hpp"
 
 #include "AuxDataSchema.hpp"
+#include "diff_utils.hpp"
 #include "string_utils.hpp"
+#include "version.h"
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/iterator/indirect_iterator.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/sync/file_lock.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/range/algorithm/find_if.hpp>
+#include <boost/uuid/uuid_io.hpp>
+#include <algorithm>
 #include <capstone/capstone.h>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <functional>
+#include <future>
 #include <gtirb/gtirb.hpp>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
 #include <utility>
 #include <variant>
 
@@ -45,6 +63,59 @@ static std::map<std::string, std::string>& getSyntaxes() {
   return defaults;
 }
 
+// Guards the factories and the default syntaxes, which are looked up by
+// printers running concurrently.
+static std::shared_mutex& getRegistryMutex() {
+  static std::shared_mutex registryMutex;
+  return registryMutex;
+}
+
+// Return the factory registered for the target, or null.
+static std::shared_ptr<::gtirb_pprint::PrettyPrinterFactory>
+findFactory(const std::tuple<std::string, std::string>& target) {
+  std::shared_lock lock(getRegistryMutex());
+  auto found = getFactories().find(target);
+  return found != getFactories().end() ? found->second : nullptr;
+}
+
+namespace {
+// Capstone handles released by the printers of this thread. The next
+// printers for the same architecture and mode reuse them instead of opening
+// new ones.
+struct CapstonePool {
+  std::vector<std::tuple<cs_arch, cs_mode, csh>> handles;
+  ~CapstonePool() {
+    for (auto& [arch, mode, handle] : handles)
+      cs_close(&handle);
+  }
+};
+thread_local CapstonePool capstonePool;
+} // namespace
+
+static csh openCapstone(cs_arch arch, cs_mode mode) {
+  auto& handles = capstonePool.handles;
+  auto found = std::find_if(handles.begin(), handles.end(), [&](auto& h) {
+    return std::get<0>(h) == arch && std::get<1>(h) == mode;
+  });
+  if (found != handles.end()) {
+    csh handle = std::get<2>(*found);
+    handles.erase(found);
+    // Undo the options set by the previous printer.
+    cs_option(handle, CS_OPT_DETAIL, CS_OPT_OFF);
+    if (arch == CS_ARCH_X86)
+      cs_option(handle, CS_OPT_SYNTAX, CS_OPT_SYNTAX_INTEL);
+    return handle;
+  }
+  csh handle;
+  [[maybe_unused]] cs_err err = cs_open(arch, mode, &handle);
+  assert(err == CS_ERR_OK && "Capstone failure");
+  return handle;
+}
+
+static void releaseCapstone(cs_arch arch, cs_mode mode, csh handle) {
+  capstonePool.handles.emplace_back(arch, mode, handle);
+}
+
 namespace gtirb_pprint {
 
 bool registerPrinter(std::initializer_list<std::string> formats,
@@ -52,17 +123,19 @@ bool registerPrinter(std::initializer_list<std::string> formats,
                      std::shared_ptr<PrettyPrinterFactory> f, bool isDefault) {
   assert(formats.size() > 0 && "No formats to register!");
   assert(syntaxes.size() > 0 && "No syntaxes to register!");
+  std::unique_lock lock(getRegistryMutex());
   for (const std::string& format : formats) {
     for (const std::string& syntax : syntaxes) {
-      getFactories()[std::make_tuple(format, syntax)] = std::move(f);
+      getFactories()[std::make_tuple(format, syntax)] = f;
       if (isDefault)
-        setDefaultSyntax(format, syntax);
+        getSyntaxes()[format] = syntax;
     }
   }
   return true;
 }
 
 std::set<std::tuple<std::string, std::string>> getRegisteredTargets() {
+  std::shared_lock lock(getRegistryMutex());
   std::set<std::tuple<std::string, std::string>> targets;
   for (const auto& entry : getFactories())
     targets.insert(entry.first);
@@ -93,18 +166,225 @@ std::string getModuleFileFormat(const gtirb::Module& module) {
 }
 
 void setDefaultSyntax(const std::string& format, const std::string& syntax) {
+  std::unique_lock lock(getRegistryMutex());
   getSyntaxes()[format] = syntax;
 }
 
 std::optional<std::string> getDefaultSyntax(const std::string& format) {
-  std::map<std::string, std::string> defaults = getSyntaxes();
+  std::shared_lock lock(getRegistryMutex());
+  const std::map<std::string, std::string>& defaults = getSyntaxes();
   auto it = defaults.find(format);
   return it != defaults.end() ? std::make_optional(it->second) : std::nullopt;
 }
 
+// Shard files start with a comment line holding this, followed by
+// "I/N module UUID blocks BEGIN-END/TOTAL".
+static const char ShardMarker[] = "gtirb-pprinter shard ";
+
+namespace {
+struct ShardFile {
+  std::string path;
+  size_t index, count;
+  std::string module;
+  size_t begin, end, total;
+};
+} // namespace
+
+static std::optional<ShardFile> readShardLine(const std::string& path) {
+  std::ifstream in(path);
+  std::string line;
+  if (!std::getline(in, line))
+    return std::nullopt;
+  size_t marker = line.find(ShardMarker);
+  if (marker == std::string::npos)
+    return std::nullopt;
+  ShardFile shard{path};
+  std::istringstream fields(line.substr(marker + sizeof(ShardMarker) - 1));
+  char slash, dash, slash2;
+  std::string moduleWord, blocksWord;
+  if (!(fields >> shard.index >> slash >> shard.count >> moduleWord >>
+        shard.module >> blocksWord >> shard.begin >> dash >> shard.end >>
+        slash2 >> shard.total) ||
+      slash != '/' || dash != '-' || slash2 != '/' || moduleWord != "module" ||
+      blocksWord != "blocks")
+    return std::nullopt;
+  return shard;
+}
+
+std::error_condition mergeShards(const std::vector<std::string>& paths,
+                                 std::ostream& os) {
+  std::vector<ShardFile> shards;
+  for (const std::string& path : paths) {
+    if (!std::ifstream(path))
+      return std::make_error_condition(std::errc::no_such_file_or_directory);
+    std::optional<ShardFile> shard = readShardLine(path);
+    if (!shard)
+      return std::make_error_condition(std::errc::invalid_argument);
+    shards.push_back(std::move(*shard));
+  }
+  std::sort(shards.begin(), shards.end(),
+            [](const ShardFile& a, const ShardFile& b) {
+              return a.index < b.index;
+            });
+
+  // Every shard must be there once, and together they must cover all the
+  // blocks of the same module.
+  if (shards.empty() || shards.size() != shards.front().count)
+    return std::make_error_condition(std::errc::invalid_argument);
+  size_t next = 0;
+  for (size_t i = 0; i < shards.size(); ++i) {
+    const ShardFile& shard = shards[i];
+    if (shard.index != i || shard.count != shards.front().count ||
+        shard.module != shards.front().module ||
+        shard.total != shards.front().total || shard.begin != next)
+      return std::make_error_condition(std::errc::invalid_argument);
+    next = shard.end;
+  }
+  if (next != shards.front().total)
+    return std::make_error_condition(std::errc::invalid_argument);
+
+  for (const ShardFile& shard : shards) {
+    std::ifstream in(shard.path, std::ios::in | std::ios::binary);
+    in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    if (in.peek() != std::ifstream::traits_type::eof())
+      os << in.rdbuf();
+  }
+  return os ? std::error_condition{}
+            : std::make_error_condition(std::errc::io_error);
+}
+
+bool pipelineModules(gtirb::IR& ir,
+                     const std::function<void(gtirb::Module&)>& prepare,
+                     const std::function<bool(gtirb::Module&)>& consume,
+                     const std::function<void(gtirb::Module&)>& finish) {
+  auto it = ir.modules_begin();
+  if (it == ir.modules_end())
+    return true;
+  prepare(*it);
+  while (it != ir.modules_end()) {
+    gtirb::Module& module = *it;
+    std::future<void> next;
+    if (++it != ir.modules_end())
+      next = std::async(std::launch::async, prepare, std::ref(*it));
+    // The future waits for the next module to be prepared when it goes out
+    // of scope, also if consume throws.
+    if (!consume(module))
+      return false;
+    if (next.valid())
+      next.get();
+    if (finish)
+      finish(module);
+  }
+  return true;
+}
+
+PrintEstimate estimatePrint(const gtirb::Module& module,
+                            const PrintCostModel& model) {
+  PrintEstimate e;
+  for (const gtirb::ByteInterval& bi : module.byte_intervals()) {
+    for (const gtirb::CodeBlock& block : bi.code_blocks()) {
+      e.codeBytes += block.getSize();
+      ++e.codeBlocks;
+    }
+    for (const gtirb::DataBlock& block : bi.data_blocks()) {
+      e.dataBytes += block.getSize();
+      ++e.dataBlocks;
+    }
+    e.symbolicExpressions += std::distance(bi.symbolic_expressions_begin(),
+                                           bi.symbolic_expressions_end());
+  }
+  e.symbols = std::distance(module.symbols_begin(), module.symbols_end());
+
+  // AArch64 instructions are all 4 bytes long.
+  const double bytesPerInstruction =
+      module.getISA() == gtirb::ISA::ARM64 ? 4 : model.bytesPerInstruction;
+  e.instructions = static_cast<uint64_t>(e.codeBytes / bytesPerInstruction);
+  const uint64_t blocks = e.codeBlocks + e.dataBlocks;
+  e.outputBytes = static_cast<uint64_t>(
+      e.instructions * model.outputBytesPerInstruction +
+      e.dataBytes * model.outputBytesPerDataByte +
+      e.symbolicExpressions * model.outputBytesPerSymbolicExpression +
+      e.symbols * model.outputBytesPerSymbol +
+      blocks * model.outputBytesPerBlock);
+  e.memoryBytes = static_cast<uint64_t>(
+      blocks * model.memoryBytesPerBlock +
+      e.symbols * model.memoryBytesPerSymbol +
+      e.symbolicExpressions * model.memoryBytesPerSymbolicExpression);
+  e.seconds = e.instructions * model.secondsPerInstruction +
+              e.dataBytes * model.secondsPerDataByte +
+              e.symbolicExpressions * model.secondsPerSymbolicExpression;
+  e.assembleMemoryBytes = static_cast<uint64_t>(
+      e.outputBytes * model.assembleMemoryPerOutputByte);
+  e.assembleSeconds = e.outputBytes * model.assembleSecondsPerOutputByte;
+  return e;
+}
+
+static void writeEstimateFields(std::ostream& os, const PrintEstimate& e) {
+  os << "\"code_bytes\":" << e.codeBytes << ",\"data_bytes\":" << e.dataBytes
+     << ",\"code_blocks\":" << e.codeBlocks
+     << ",\"data_blocks\":" << e.dataBlocks << ",\"symbols\":" << e.symbols
+     << ",\"symbolic_expressions\":" << e.symbolicExpressions
+     << ",\"instructions\":" << e.instructions
+     << ",\"output_bytes\":" << e.outputBytes;
+}
+
+void writePrintEstimates(std::ostream& os, const gtirb::IR& ir,
+                         uint64_t irFileBytes, bool compile,
+                         const PrintCostModel& model) {
+  PrintEstimate total;
+  int i = 0;
+  for (const gtirb::Module& module : ir.modules()) {
+    PrintEstimate e = estimatePrint(module, model);
+    os << "{\"module\":" << i++ << ',';
+    writeEstimateFields(os, e);
+    os << ",\"memory_bytes\":" << e.memoryBytes
+       << ",\"seconds\":" << e.seconds;
+    if (compile)
+      os << ",\"assemble_memory_bytes\":" << e.assembleMemoryBytes
+         << ",\"assemble_seconds\":" << e.assembleSeconds;
+    os << "}\n";
+
+    total.codeBytes += e.codeBytes;
+    total.dataBytes += e.dataBytes;
+    total.codeBlocks += e.codeBlocks;
+    total.dataBlocks += e.dataBlocks;
+    total.symbols += e.symbols;
+    total.symbolicExpressions += e.symbolicExpressions;
+    total.instructions += e.instructions;
+    total.outputBytes += e.outputBytes;
+    total.memoryBytes = std::max(total.memoryBytes, e.memoryBytes);
+    total.seconds += e.seconds;
+    total.assembleMemoryBytes =
+        std::max(total.assembleMemoryBytes, e.assembleMemoryBytes);
+    total.assembleSeconds += e.assembleSeconds;
+  }
+  // The assembler and the linker run in other processes once printing is
+  // done, while the IR is still loaded.
+  const uint64_t binaryBytes = total.codeBytes + total.dataBytes;
+  const uint64_t linkMemoryBytes =
+      static_cast<uint64_t>(binaryBytes * model.linkMemoryPerBinaryByte);
+  const double linkSeconds = binaryBytes * model.linkSecondsPerBinaryByte;
+  if (compile) {
+    total.memoryBytes = std::max(
+        {total.memoryBytes, total.assembleMemoryBytes, linkMemoryBytes});
+    total.seconds += total.assembleSeconds + linkSeconds;
+  }
+  total.memoryBytes +=
+      static_cast<uint64_t>(irFileBytes * model.irMemoryPerFileByte);
+  total.seconds += irFileBytes * model.loadSecondsPerFileByte;
+  os << "{\"modules\":" << i << ',';
+  writeEstimateFields(os, total);
+  if (compile)
+    os << ",\"assemble_seconds\":" << total.assembleSeconds
+       << ",\"link_memory_bytes\":" << linkMemoryBytes
+       << ",\"link_seconds\":" << linkSeconds;
+  os << ",\"peak_memory_bytes\":" << total.memoryBytes
+     << ",\"seconds\":" << total.seconds << "}\n";
+}
+
 void PrettyPrinter::setTarget(
     const std::tuple<std::string, std::string>& target) {
-  assert(getFactories().find(target) != getFactories().end());
+  assert(findFactory(target) && "target is not registered");
   const auto& [format, syntax] = target;
   m_format = format;
   m_syntax = syntax;
@@ -129,45 +409,439 @@ void PrettyPrinter::keepFunction(const std::string& functionName) {
   m_keep_funcs.insert(functionName);
 }
 
-std::error_condition PrettyPrinter::print(std::ostream& stream,
-                                          gtirb::Context& context,
-                                          gtirb::Module& module) const {
-  // Find pretty printer factory.
-  auto target = std::make_tuple(m_format, m_syntax);
-  if (m_format.empty()) {
-    const std::string& format = gtirb_pprint::getModuleFileFormat(module);
-    const std::string& syntax = getDefaultSyntax(format).value_or("");
-    target = std::make_tuple(format, syntax);
-  }
-  const std::shared_ptr<PrettyPrinterFactory> factory =
-      getFactories().at(target);
+void PrettyPrinter::selectFunction(const std::string& functionName) {
+  m_select_functions.insert(functionName);
+}
+
+void PrettyPrinter::selectSection(const std::string& sectionName) {
+  m_select_sections.insert(sectionName);
+}
+
+void PrettyPrinter::selectAddressRange(uint64_t begin, uint64_t end) {
+  m_select_ranges.emplace_back(begin, end);
+}
+
+void PrettyPrinter::setPassthrough(bool passthrough, bool comments) {
+  m_passthrough = passthrough;
+  m_passthrough_comments = comments;
+}
+
+void PrettyPrinter::setMinimal(bool minimal) { m_minimal = minimal; }
+
+void PrettyPrinter::setAssemblerFeatures(bool nopsDirective, bool endbr64) {
+  m_nops_directive = nopsDirective;
+  m_endbr64 = endbr64;
+}
+
+void PrettyPrinter::setRenderCacheDir(const std::string& dir) {
+  m_render_cache_dir = dir;
+}
+
+void PrettyPrinter::setRenderCacheSize(uint64_t size) {
+  m_render_cache_size = size;
+}
+
+void PrettyPrinter::setOutputCacheDir(const std::string& dir) {
+  m_output_cache_dir = dir;
+}
 
-  // Configure printing policy.
-  PrintingPolicy policy(factory->defaultPrintingPolicy());
+void PrettyPrinter::setSidecar(const std::string& dir,
+                               const std::string& irHash) {
+  m_sidecar_dir = dir;
+  m_ir_hash = irHash;
+}
+
+void PrettyPrinter::setSourceMapFile(const std::string& path) {
+  m_source_map_file = path;
+}
+
+void PrettyPrinter::setShard(size_t index, size_t count) {
+  assert(index < count && "shard index out of range");
+  m_shard = index;
+  m_shard_count = count;
+}
+
+void PrettyPrinter::setModuleIndex(std::shared_ptr<const ModuleIndex> index) {
+  m_module_index = std::move(index);
+}
+
+void PrettyPrinter::setIncbinFile(const std::string& path,
+                                  uint64_t threshold) {
+  m_incbin_file = path;
+  m_incbin_threshold = threshold;
+}
+
+PrintingPolicy PrettyPrinter::getPolicy(
+    const PrettyPrinterFactory& factory,
+    const std::tuple<std::string, std::string>& target) const {
+  PrintingPolicy policy(factory.defaultPrintingPolicy());
   policy.debug = m_debug;
   for (auto& name : m_skip_funcs)
     policy.skipFunctions.insert(name);
   for (auto& name : m_keep_funcs)
     policy.skipFunctions.erase(name);
+  for (auto& name : m_select_functions) {
+    policy.selectFunctions.insert(name);
+    policy.skipFunctions.erase(name);
+  }
+  for (auto& name : m_select_sections)
+    policy.selectSections.insert(name);
+  policy.selectRanges = m_select_ranges;
+  policy.incbinFile = m_incbin_file;
+  policy.incbinThreshold = m_incbin_threshold;
+  policy.passthrough = m_passthrough;
+  policy.passthroughComments = m_passthrough_comments;
+  policy.minimal = m_minimal;
+  policy.nopsDirective = m_nops_directive;
+  policy.endbr64 = m_endbr64;
+  policy.renderCacheSize = m_render_cache_size;
+  if (!m_render_cache_dir.empty())
+    policy.renderCacheFile = m_render_cache_dir + "/" + std::get<0>(target) +
+                             "-" + std::get<1>(target) + ".cache";
+  if (!m_output_cache_dir.empty())
+    policy.outputCacheFile = m_output_cache_dir + "/" + std::get<0>(target) +
+                             "-" + std::get<1>(target) + ".blocks";
+  policy.sourceMapFile = m_source_map_file;
+  if (!m_sidecar_dir.empty()) {
+    policy.sidecarDir = m_sidecar_dir;
+    policy.sidecarKey = m_ir_hash + "-" + std::get<0>(target) + "-" +
+                        std::get<1>(target);
+  }
+  policy.shard = m_shard;
+  policy.shardCount = m_shard_count;
+  policy.index = m_module_index;
+  return policy;
+}
+
+std::tuple<std::string, std::string>
+PrettyPrinter::getTarget(const gtirb::Module& module) const {
+  if (m_format.empty()) {
+    const std::string& format = gtirb_pprint::getModuleFileFormat(module);
+    const std::string& syntax = getDefaultSyntax(format).value_or("");
+    return std::make_tuple(format, syntax);
+  }
+  return std::make_tuple(m_format, m_syntax);
+}
 
-  // Create the pretty printer and print the IR.
-  factory->create(context, module, policy)->print(stream);
+std::error_condition PrettyPrinter::print(std::ostream& stream,
+                                          gtirb::Context& context,
+                                          gtirb::Module& module) const {
+  return PrintSession(*this, getTarget(module)).print(stream, context, module);
+}
 
+std::error_condition PrettyPrinter::print(
+    const std::vector<std::pair<std::tuple<std::string, std::string>,
+                                std::ostream*>>& outputs,
+    gtirb::Context& context, gtirb::Module& module) const {
+  std::shared_ptr<const ModuleIndex> index =
+      m_module_index ? m_module_index
+                     : std::make_shared<const ModuleIndex>(context, module);
+  if (!index->laidOut)
+    return std::make_error_condition(std::errc::address_not_available);
+  std::vector<std::unique_ptr<PrettyPrinterBase>> printers;
+  std::vector<std::pair<PrettyPrinterBase*, std::ostream*>> streams;
+  for (const auto& [target, stream] : outputs) {
+    const std::shared_ptr<PrettyPrinterFactory> factory = findFactory(target);
+    if (!factory)
+      return std::make_error_condition(std::errc::invalid_argument);
+    PrintingPolicy policy = getPolicy(*factory, target);
+    policy.index = index;
+    // The targets would overwrite each other's incbin file and source map.
+    policy.incbinFile.clear();
+    policy.sourceMapFile.clear();
+    printers.push_back(factory->create(context, module, policy));
+    streams.emplace_back(printers.back().get(), stream);
+  }
+  PrettyPrinterBase::printTogether(streams);
   return std::error_condition{};
 }
 
-PrettyPrinterBase::PrettyPrinterBase(gtirb::Context& context_,
-                                     gtirb::Module& module_,
-                                     const Syntax& syntax_,
-                                     const PrintingPolicy& policy_,
-                                     cs_arch arch,
-                                     cs_mode mode)
-    : syntax(syntax_), policy(policy_),
-      debug(policy.debug == DebugMessages ? true : false), context(context_),
-      module(module_), functionEntry(), functionLastBlock() {
-  [[maybe_unused]] cs_err err =
-      cs_open(arch, mode, &this->csHandle);
-  assert(err == CS_ERR_OK && "Capstone failure");
+std::error_condition PrettyPrinter::printDiff(std::ostream& stream,
+                                              gtirb::Context& oldContext,
+                                              gtirb::Module& oldModule,
+                                              gtirb::Context& context,
+                                              gtirb::Module& module) const {
+  auto target = getTarget(module);
+  const std::shared_ptr<PrettyPrinterFactory> factory = findFactory(target);
+  if (!factory)
+    return std::make_error_condition(std::errc::invalid_argument);
+  PrintingPolicy policy = getPolicy(*factory, target);
+  policy.incbinFile.clear();
+  policy.sourceMapFile.clear();
+  // Each side builds the indexes of its own module.
+  policy.index.reset();
+  std::unique_ptr<PrettyPrinterBase> oldPrinter =
+      factory->create(oldContext, oldModule, policy);
+  std::unique_ptr<PrettyPrinterBase> newPrinter =
+      factory->create(context, module, policy);
+  if (!oldPrinter->isLaidOut() || !newPrinter->isLaidOut())
+    return std::make_error_condition(std::errc::address_not_available);
+  using FunctionDigest = PrettyPrinterBase::FunctionDigest;
+  const std::vector<FunctionDigest> oldFunctions =
+      oldPrinter->getFunctionDigests();
+  const std::vector<FunctionDigest> newFunctions =
+      newPrinter->getFunctionDigests();
+
+  // Match the functions by name if it is unique on both sides, otherwise by
+  // entry address.
+  std::unordered_map<std::string, int> oldNames, newNames;
+  for (const FunctionDigest& f : oldFunctions)
+    ++oldNames[f.name];
+  for (const FunctionDigest& f : newFunctions)
+    ++newNames[f.name];
+  std::unordered_map<std::string, size_t> oldByName;
+  std::map<gtirb::Addr, size_t> oldByAddress;
+  for (size_t i = 0; i < oldFunctions.size(); ++i) {
+    if (oldNames[oldFunctions[i].name] == 1)
+      oldByName.emplace(oldFunctions[i].name, i);
+    oldByAddress.emplace(oldFunctions[i].begin, i);
+  }
+  std::vector<bool> oldMatched(oldFunctions.size(), false);
+
+  auto printFunction = [](PrettyPrinterBase& printer,
+                          const FunctionDigest* f) {
+    std::ostringstream text;
+    if (f)
+      printer.printRegion(text, f->begin, f->end);
+    return text.str();
+  };
+  auto printChange = [&](const FunctionDigest* oldF,
+                         const FunctionDigest* newF) {
+    const std::string oldText = printFunction(*oldPrinter, oldF);
+    const std::string newText = printFunction(*newPrinter, newF);
+    write_unified_diff(stream, split_lines(oldText), split_lines(newText),
+                       oldF ? "a/" + oldF->name : "/dev/null",
+                       newF ? "b/" + newF->name : "/dev/null");
+  };
+
+  for (const FunctionDigest& newF : newFunctions) {
+    std::optional<size_t> match;
+    if (newNames[newF.name] == 1) {
+      if (auto found = oldByName.find(newF.name); found != oldByName.end())
+        match = found->second;
+    }
+    if (!match) {
+      auto found = oldByAddress.find(newF.begin);
+      if (found != oldByAddress.end() && !oldMatched[found->second])
+        match = found->second;
+    }
+    if (match && oldMatched[*match])
+      match.reset();
+    if (match)
+      oldMatched[*match] = true;
+    if (match && oldFunctions[*match].digest == newF.digest)
+      continue;
+    printChange(match ? &oldFunctions[*match] : nullptr, &newF);
+  }
+  for (size_t i = 0; i < oldFunctions.size(); ++i) {
+    if (!oldMatched[i])
+      printChange(&oldFunctions[i], nullptr);
+  }
+  return std::error_condition{};
+}
+
+PrintSession::PrintSession(const PrettyPrinter& printer,
+                           const std::tuple<std::string, std::string>& target)
+    : m_factory(findFactory(target)) {
+  if (m_factory)
+    m_policy = printer.getPolicy(*m_factory, target);
+}
+
+std::error_condition PrintSession::print(std::ostream& stream,
+                                         gtirb::Context& context,
+                                         gtirb::Module& module) const {
+  if (!m_factory)
+    return std::make_error_condition(std::errc::invalid_argument);
+  std::unique_ptr<PrettyPrinterBase> printer =
+      m_factory->create(context, module, m_policy);
+  if (!printer->isLaidOut())
+    return std::make_error_condition(std::errc::address_not_available);
+  printer->print(stream);
+  return std::error_condition{};
+}
+
+// Sort the extents by address and fill in their largest end addresses.
+template <typename NodeT>
+static void sortExtents(std::vector<ModuleIndex::Extent<NodeT>>& extents) {
+  std::stable_sort(extents.begin(), extents.end(),
+                   [](const auto& a, const auto& b) {
+                     return a.address < b.address;
+                   });
+  gtirb::Addr maxEnd{0};
+  for (auto& extent : extents) {
+    maxEnd = std::max(maxEnd, extent.address + extent.size);
+    extent.maxEnd = maxEnd;
+  }
+}
+
+bool ModuleIndex::indexAddresses(const gtirb::Module& module) {
+  computedAddresses.clear();
+  intervals.clear();
+  sections.clear();
+  symbols.clear();
+  if (!module.getAddress() &&
+      !gtirb_layout::computeModuleAddresses(module, computedAddresses))
+    return false;
+
+  for (const gtirb::ByteInterval& interval : module.byte_intervals()) {
+    if (std::optional<gtirb::Addr> addr = addressOf(interval))
+      intervals.push_back({*addr, interval.getSize(), *addr, &interval});
+  }
+  sortExtents(intervals);
+  for (const gtirb::Section& section : module.sections()) {
+    if (std::optional<gtirb::Addr> addr = addressOf(section))
+      sections.push_back({*addr, *sizeOf(section), *addr, &section});
+  }
+  sortExtents(sections);
+  if (!computedAddresses.empty()) {
+    for (const gtirb::Symbol& symbol : module.symbols()) {
+      if (std::optional<gtirb::Addr> addr = addressOf(symbol))
+        symbols.emplace_back(*addr, &symbol);
+    }
+    std::stable_sort(
+        symbols.begin(), symbols.end(),
+        [](const auto& a, const auto& b) { return a.first < b.first; });
+  }
+  return true;
+}
+
+std::optional<gtirb::Addr>
+ModuleIndex::addressOf(const gtirb::ByteInterval& x) const {
+  if (computedAddresses.empty())
+    return x.getAddress();
+  auto found = computedAddresses.find(&x);
+  if (found == computedAddresses.end())
+    return std::nullopt;
+  return found->second;
+}
+
+// The address of a block at \p offset in \p interval.
+static std::optional<gtirb::Addr>
+blockAddress(const ModuleIndex& index, const gtirb::ByteInterval* interval,
+             uint64_t offset) {
+  if (!interval)
+    return std::nullopt;
+  std::optional<gtirb::Addr> addr = index.addressOf(*interval);
+  if (!addr)
+    return std::nullopt;
+  return *addr + offset;
+}
+
+std::optional<gtirb::Addr>
+ModuleIndex::addressOf(const gtirb::CodeBlock& x) const {
+  if (computedAddresses.empty())
+    return x.getAddress();
+  return blockAddress(*this, x.getByteInterval(), x.getOffset());
+}
+
+std::optional<gtirb::Addr>
+ModuleIndex::addressOf(const gtirb::DataBlock& x) const {
+  if (computedAddresses.empty())
+    return x.getAddress();
+  return blockAddress(*this, x.getByteInterval(), x.getOffset());
+}
+
+std::optional<gtirb::Addr>
+ModuleIndex::addressOf(const gtirb::Section& x) const {
+  if (computedAddresses.empty())
+    return x.getAddress();
+  std::optional<gtirb::Addr> low;
+  for (const gtirb::ByteInterval& interval : x.byte_intervals()) {
+    std::optional<gtirb::Addr> addr = addressOf(interval);
+    if (!addr)
+      return std::nullopt;
+    low = low ? std::min(*low, *addr) : *addr;
+  }
+  return low;
+}
+
+std::optional<uint64_t> ModuleIndex::sizeOf(const gtirb::Section& x) const {
+  if (computedAddresses.empty())
+    return x.getSize();
+  std::optional<gtirb::Addr> low = addressOf(x);
+  if (!low)
+    return std::nullopt;
+  gtirb::Addr high = *low;
+  for (const gtirb::ByteInterval& interval : x.byte_intervals())
+    high = std::max(high, *addressOf(interval) + interval.getSize());
+  return static_cast<uint64_t>(high) - static_cast<uint64_t>(*low);
+}
+
+std::optional<gtirb::Addr>
+ModuleIndex::addressOf(const gtirb::Symbol& x) const {
+  if (computedAddresses.empty())
+    return x.getAddress();
+  // As Symbol::getAddress, with the addresses of the blocks computed.
+  auto atBlock = [&](const auto* block) -> std::optional<gtirb::Addr> {
+    std::optional<gtirb::Addr> addr = addressOf(*block);
+    if (addr && x.getAtEnd())
+      return *addr + block->getSize();
+    return addr;
+  };
+  if (const auto* block = x.getReferent<gtirb::CodeBlock>())
+    return atBlock(block);
+  if (const auto* block = x.getReferent<gtirb::DataBlock>())
+    return atBlock(block);
+  if (x.hasReferent())
+    return std::nullopt;
+  return x.getAddress();
+}
+
+std::pair<gtirb::Addr, uint64_t>
+ModuleIndex::extentOf(const Block& block) const {
+  return std::visit(
+      [this](const auto* b) {
+        return std::make_pair(*addressOf(*b), b->getSize());
+      },
+      block);
+}
+
+const gtirb::Section* ModuleIndex::findSectionAt(gtirb::Addr addr) const {
+  auto it = std::lower_bound(
+      sections.begin(), sections.end(), addr,
+      [](const auto& extent, gtirb::Addr a) { return extent.address < a; });
+  return it != sections.end() && it->address == addr ? it->node : nullptr;
+}
+
+const gtirb::Section* ModuleIndex::findSectionOn(gtirb::Addr addr) const {
+  const gtirb::Section* found = nullptr;
+  forEachExtentOn(sections, addr, addr + 1,
+                  [&found](const Extent<gtirb::Section>& extent) {
+                    if (!found)
+                      found = extent.node;
+                  });
+  return found;
+}
+
+std::pair<size_t, size_t> ModuleIndex::findBlocksAt(gtirb::Addr begin,
+                                                    gtirb::Addr end) const {
+  auto startsBefore = [this](const Block& block, gtirb::Addr addr) {
+    return extentOf(block).first < addr;
+  };
+  auto first = std::lower_bound(blocks.begin(), blocks.end(), begin,
+                                startsBefore);
+  auto last = std::lower_bound(first, blocks.end(), end, startsBefore);
+  return {first - blocks.begin(), last - blocks.begin()};
+}
+
+bool ModuleIndex::hasDataBlocksOn(gtirb::Addr addr) const {
+  bool found = false;
+  forEachIntervalOn(
+      addr, addr + 1,
+      [&](gtirb::Addr base, const gtirb::ByteInterval& interval) {
+        found = found ||
+                !interval
+                     .findDataBlocksOnOffset(static_cast<uint64_t>(addr) -
+                                             static_cast<uint64_t>(base))
+                     .empty();
+      });
+  return found;
+}
+
+ModuleIndex::ModuleIndex(gtirb::Context& context, gtirb::Module& module) {
+  laidOut = indexAddresses(module);
+  if (!laidOut)
+    return;
 
   if (const auto* functionEntries =
           module.getAuxData<gtirb::schema::FunctionEntries>()) {
@@ -177,7 +851,7 @@ PrettyPrinterBase::PrettyPrinterBase(gtirb::Context& context_,
             nodeFromUUID<gtirb::CodeBlock>(context, entryBlockUUID);
         assert(block && "UUID references non-existent block.");
         if (block)
-          functionEntry.insert(*block->getAddress());
+          functionEntry.push_back(*addressOf(*block));
       }
     }
   }
@@ -190,15 +864,135 @@ PrettyPrinterBase::PrettyPrinterBase(gtirb::Context& context_,
       for (auto& blockUUID : function.second) {
         const auto* block = nodeFromUUID<gtirb::CodeBlock>(context, blockUUID);
         assert(block && "UUID references non-existent block.");
-        if (block && block->getAddress() > lastAddr)
-          lastAddr = *block->getAddress();
+        if (block && addressOf(*block) > lastAddr)
+          lastAddr = *addressOf(*block);
       }
-      functionLastBlock.insert(lastAddr);
+      functionLastBlock.push_back(lastAddr);
     }
   }
+  for (auto* addrs : {&functionEntry, &functionLastBlock}) {
+    std::sort(addrs->begin(), addrs->end());
+    addrs->erase(std::unique(addrs->begin(), addrs->end()), addrs->end());
+  }
+
+  // FIXME: simplify once block interation order is guaranteed by gtirb
+  auto addressOrder = [this](const auto* a, const auto* b) {
+    return addressOf(*a) < addressOf(*b);
+  };
+  std::vector<const gtirb::CodeBlock*> codeBlocks;
+  for (const gtirb::CodeBlock& block :
+       gtirb::blocks(module.getIR()->getCFG())) {
+    if (block.getByteInterval()->getSection()->getModule() == &module) {
+      codeBlocks.push_back(&block);
+    }
+  }
+  std::sort(codeBlocks.begin(), codeBlocks.end(), addressOrder);
+  // The module gives its data blocks in address order if it has addresses.
+  std::vector<const gtirb::DataBlock*> dataBlocks;
+  for (const gtirb::DataBlock& block : module.data_blocks())
+    dataBlocks.push_back(&block);
+  std::stable_sort(dataBlocks.begin(), dataBlocks.end(), addressOrder);
+
+  // Merge them, putting code blocks first at the same address.
+  blocks.reserve(codeBlocks.size() + dataBlocks.size());
+  auto codeIt = codeBlocks.begin();
+  auto dataIt = dataBlocks.begin();
+  while (codeIt != codeBlocks.end() && dataIt != dataBlocks.end()) {
+    if (addressOf(**codeIt) <= addressOf(**dataIt))
+      blocks.emplace_back(*codeIt++);
+    else
+      blocks.emplace_back(*dataIt++);
+  }
+  blocks.insert(blocks.end(), codeIt, codeBlocks.end());
+  blocks.insert(blocks.end(), dataIt, dataBlocks.end());
 }
 
-PrettyPrinterBase::~PrettyPrinterBase() { cs_close(&this->csHandle); }
+// A sidecar file mapped into memory. It holds:
+// - the header line, and a line with the key and the layout of the module,
+// - the function entries and the function last blocks, each as a 64-bit
+//   count followed by the addresses,
+// - the blocks in printing order, as a 64-bit count followed by the UUID
+//   and a kind byte, 'c' or 'd', of each block,
+// - the decoded instructions, as a 64-bit record size and count followed
+//   by the records sorted by address. A record is the cs_insn, with a null
+//   detail pointer, followed by the part of cs_detail of the architecture.
+struct PrettyPrinterBase::Sidecar {
+  boost::interprocess::mapped_region region;
+  const char* functionEntry = nullptr;
+  uint64_t functionEntryCount = 0;
+  const char* functionLastBlock = nullptr;
+  uint64_t functionLastBlockCount = 0;
+  const char* blocks = nullptr;
+  uint64_t blockCount = 0;
+  const char* records = nullptr;
+  uint64_t recordSize = 0;
+  uint64_t recordCount = 0;
+  /// The index read from the file, if it was resolved.
+  std::shared_ptr<const ModuleIndex> index;
+};
+
+// A cache file mapped into memory.
+struct PrettyPrinterBase::MappedCacheFile {
+  boost::interprocess::mapped_region region;
+};
+
+/// Return \p s as an assembler string literal.
+static std::string quoteAssemblerString(const std::string& s) {
+  std::ostringstream quoted;
+  quoted << '"';
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      quoted << '\\' << c;
+    else if (static_cast<unsigned char>(c) < 0x20)
+      quoted << '\\' << std::oct << std::setw(3) << std::setfill('0')
+             << static_cast<int>(c) << std::dec;
+    else
+      quoted << c;
+  }
+  quoted << '"';
+  return quoted.str();
+}
+
+PrettyPrinterBase::PrettyPrinterBase(gtirb::Context& context_,
+                                     gtirb::Module& module_,
+                                     const Syntax& syntax_,
+                                     const PrintingPolicy& policy_,
+                                     cs_arch arch,
+                                     cs_mode mode)
+    : syntax(syntax_), policy(policy_),
+      debug(policy.debug == DebugMessages ? true : false), context(context_),
+      module(module_),
+      sidecar(policy.sidecarDir.empty() ? nullptr : mapSidecar(arch, true)),
+      index(policy.index ? policy.index
+                         : sidecar ? sidecar->index
+                                   : std::make_shared<const ModuleIndex>(
+                                         context, module)),
+      functionEntry(index->functionEntry),
+      functionLastBlock(index->functionLastBlock), csArch(arch),
+      csMode(mode) {
+  csHandle = openCapstone(arch, mode);
+
+  functionSkipped.resize(functionEntry.size());
+  dataEncodings = module.getAuxData<gtirb::schema::Encodings>();
+
+  if (!policy.renderCacheFile.empty())
+    loadRenderCache();
+  if (!policy.outputCacheFile.empty())
+    loadOutputCache();
+
+  if (!policy.incbinFile.empty()) {
+    incbinStream.open(policy.incbinFile, std::ios::out | std::ios::binary);
+    if (!incbinStream)
+      std::cerr << "WARNING: could not open " << policy.incbinFile
+                << "; printing data as bytes\n";
+    incbinQuotedPath = quoteAssemblerString(
+        boost::filesystem::absolute(policy.incbinFile).string());
+  }
+}
+
+PrettyPrinterBase::~PrettyPrinterBase() {
+  releaseCapstone(csArch, csMode, csHandle);
+}
 
 const gtirb::SymAddrConst* PrettyPrinterBase::getSymbolicImmediate(
     const gtirb::SymbolicExpression* symex) {
@@ -210,125 +1004,909 @@ const gtirb::SymAddrConst* PrettyPrinterBase::getSymbolicImmediate(
   return nullptr;
 }
 
+gtirb::Addr PrettyPrinterBase::printNextBlock(std::ostream& os,
+                                              const ModuleIndex::Block& block,
+                                              gtirb::Addr last) {
+  if (const auto* code = std::get_if<const gtirb::CodeBlock*>(&block))
+    return printBlockOrWarning(os, **code, last);
+  return printDataBlockOrWarning(
+      os, *std::get<const gtirb::DataBlock*>(block), last);
+}
+
+gtirb::Addr
+PrettyPrinterBase::printBlocks(std::ostream& os,
+                               const std::vector<ModuleIndex::Block>& blocks,
+                               gtirb::Addr last) {
+  last = printBlockRange(os, blocks, 0, blocks.size(), last);
+  endSymbolicDataRun(os);
+  return last;
+}
+
+gtirb::Addr PrettyPrinterBase::printBlockRange(
+    std::ostream& os, const std::vector<ModuleIndex::Block>& blocks,
+    size_t begin, size_t end, gtirb::Addr last) {
+  while (begin < end) {
+    size_t next = nextChunk(blocks, begin, end);
+    last = printChunk(os, blocks, begin, next, last);
+    begin = next;
+  }
+  return last;
+}
+
+bool PrettyPrinterBase::startsChunk(const ModuleIndex::Block& block) const {
+  gtirb::Addr addr = index->extentOf(block).first;
+  if (index->findSectionAt(addr))
+    return true;
+  if (std::holds_alternative<const gtirb::CodeBlock*>(block))
+    return isFunctionEntry(addr);
+  return hasSymbolsAt(addr);
+}
+
+size_t
+PrettyPrinterBase::nextChunk(const std::vector<ModuleIndex::Block>& blocks,
+                             size_t begin, size_t end) const {
+  size_t next = begin + 1;
+  while (next < end && !startsChunk(blocks[next]))
+    ++next;
+  return next;
+}
+
+void PrettyPrinterBase::printModuleEnd(std::ostream& os, gtirb::Addr last) {
+  bool inData = index->hasDataBlocksOn(last);
+  printSymbolDefinitionsAtAddress(os, last, inData);
+  printSectionFooter(os, std::nullopt, last);
+}
+
+bool PrettyPrinterBase::hasSelectedRegions() const {
+  return !policy.selectFunctions.empty() || !policy.selectSections.empty() ||
+         !policy.selectRanges.empty();
+}
+
 std::ostream& PrettyPrinterBase::print(std::ostream& os) {
-  printHeader(os);
-  // FIXME: simplify once block interation order is guaranteed by gtirb
-  auto address_order_block = [](const gtirb::CodeBlock* a,
-                                const gtirb::CodeBlock* b) {
-    return a->getAddress() < b->getAddress();
+  std::ostream& out = startSourceMap(os);
+  if (policy.shardCount > 1 && !hasSelectedRegions()) {
+    printShard(out);
+    return os;
+  }
+  printHeader(out);
+  if (hasSelectedRegions())
+    printSelectedRegions(out);
+  else
+    printModuleEnd(out, printBlocks(out, index->blocks, gtirb::Addr{0}));
+  finishPrinting(out);
+  return os;
+}
+
+// The size of the part of cs_detail that holds the details of \p arch,
+// which is all that is copied of the detail of an instruction.
+static size_t instructionDetailSize(cs_arch arch) {
+  switch (arch) {
+  case CS_ARCH_X86:
+    return offsetof(cs_detail, x86) + sizeof(cs_x86);
+  case CS_ARCH_ARM64:
+    return offsetof(cs_detail, arm64) + sizeof(cs_arm64);
+  default:
+    return sizeof(cs_detail);
+  }
+}
+
+struct PrettyPrinterBase::SharedDecode {
+  SharedDecode(cs_arch arch_, cs_mode mode_)
+      : arch(arch_), mode(mode_), handle(openCapstone(arch_, mode_)) {
+    cs_option(handle, CS_OPT_DETAIL, CS_OPT_ON);
+  }
+  ~SharedDecode() {
+    clear();
+    releaseCapstone(arch, mode, handle);
+  }
+  SharedDecode(const SharedDecode&) = delete;
+  SharedDecode& operator=(const SharedDecode&) = delete;
+
+  struct Instructions {
+    cs_insn* insn = nullptr;
+    size_t count = 0;
   };
-  std::vector<const gtirb::CodeBlock*> blocks;
-  for (const gtirb::CodeBlock& block :
-       gtirb::blocks(module.getIR()->getCFG())) {
-    if (block.getByteInterval()->getSection()->getModule() == &module) {
-      blocks.push_back(&block);
+
+  // Return the instructions of \p x, at \p addr, decoding the whole block
+  // on first use.
+  const Instructions& decode(const gtirb::CodeBlock& x, gtirb::Addr addr) {
+    auto [it, added] = blocks.try_emplace(&x);
+    if (added)
+      it->second.count =
+          cs_disasm(handle, x.rawBytes<uint8_t>(), x.getSize(),
+                    static_cast<uint64_t>(addr), 0, &it->second.insn);
+    return it->second;
+  }
+
+  // Return the instruction of \p x at \p address, or null if the block
+  // cannot be decoded up to there.
+  const cs_insn* find(const gtirb::CodeBlock& x, gtirb::Addr addr,
+                      uint64_t address) {
+    const Instructions& decoded = decode(x, addr);
+    const cs_insn* end = decoded.insn + decoded.count;
+    const cs_insn* found = std::lower_bound(
+        decoded.insn, end, address,
+        [](const cs_insn& inst, uint64_t a) { return inst.address < a; });
+    if (found == end || found->address != address)
+      return nullptr;
+    return found;
+  }
+
+  void clear() {
+    for (auto& [block, decoded] : blocks)
+      if (decoded.count)
+        cs_free(decoded.insn, decoded.count);
+    blocks.clear();
+  }
+
+  cs_arch arch;
+  cs_mode mode;
+  csh handle;
+  std::unordered_map<const gtirb::CodeBlock*, Instructions> blocks;
+};
+
+void PrettyPrinterBase::copySharedInstruction(const cs_insn& from,
+                                              cs_insn& to,
+                                              const uint8_t* bytes) {
+  cs_detail* detail = to.detail;
+  to = from;
+  to.detail = detail;
+  std::memcpy(detail, from.detail, instructionDetailSize(csArch));
+  adaptSharedInstruction(to, bytes);
+}
+
+void PrettyPrinterBase::printTogether(
+    const std::vector<std::pair<PrettyPrinterBase*, std::ostream*>>&
+        printers) {
+  if (printers.empty())
+    return;
+  const ModuleIndex& index = *printers.front().first->index;
+  for (const auto& [printer, os] : printers) {
+    assert(printer->index.get() == &index &&
+           "printers must share their module index");
+    // Selections are rare and small enough to be printed one at a time.
+    if (printer->hasSelectedRegions()) {
+      for (const auto& [p, stream] : printers)
+        p->print(*stream);
+      return;
     }
   }
-  std::sort(blocks.begin(), blocks.end(), address_order_block);
-  auto blockIt = blocks.begin();
-  auto dataIt = module.data_blocks_begin();
+
+  std::vector<std::ostream*> out;
+  for (const auto& [printer, os] : printers) {
+    out.push_back(&printer->startSourceMap(*os));
+    printer->printHeader(*out.back());
+  }
+  // The blocks of a chunk are decoded by the first printer that needs
+  // them, and the others copy the instructions.
+  const PrettyPrinterBase& front = *printers.front().first;
+  SharedDecode shared(front.csArch, front.csMode);
+  for (const auto& [printer, os] : printers)
+    if (printer->csArch == front.csArch && printer->csMode == front.csMode)
+      printer->sharedDecode = &shared;
+
+  std::vector<gtirb::Addr> last(printers.size(), gtirb::Addr{0});
+  const std::vector<ModuleIndex::Block>& blocks = index.blocks;
+  for (size_t begin = 0; begin < blocks.size();) {
+    size_t next = printers.front().first->nextChunk(blocks, begin,
+                                                    blocks.size());
+    for (size_t i = 0; i < printers.size(); ++i)
+      last[i] = printers[i].first->printChunk(*out[i], blocks, begin, next,
+                                              last[i]);
+    shared.clear();
+    begin = next;
+  }
+  for (size_t i = 0; i < printers.size(); ++i) {
+    PrettyPrinterBase* printer = printers[i].first;
+    printer->sharedDecode = nullptr;
+    printer->endSymbolicDataRun(*out[i]);
+    printer->printModuleEnd(*out[i], last[i]);
+    printer->finishPrinting(*out[i]);
+  }
+}
+
+std::ostream& PrettyPrinterBase::startSourceMap(std::ostream& os) {
+  if (policy.sourceMapFile.empty())
+    return os;
+  outputPosition = std::make_unique<OutputPosition>(os.rdbuf());
+  positionStream = std::make_unique<std::ostream>(outputPosition.get());
+  sourcePosition = outputPosition.get();
+  return *positionStream;
+}
+
+void PrettyPrinterBase::beginSourceBlock(const gtirb::UUID& block,
+                                         gtirb::Addr addr) {
+  sourceBlock = &block;
+  sourceFunction = SourceMap::NoFunction;
+  if (std::optional<std::string> name = getContainerFunctionName(addr)) {
+    auto [it, added] = sourceMapFunctions.emplace(
+        *name, static_cast<uint32_t>(sourceMap.functions.size()));
+    if (added)
+      sourceMap.functions.push_back(*name);
+    sourceFunction = it->second;
+  }
+}
+
+void PrettyPrinterBase::addSourceMapEntry(gtirb::Addr ea) {
+  sourceMap.entries.push_back({sourcePosition->offset(),
+                               sourcePosition->line(),
+                               static_cast<uint64_t>(ea), *sourceBlock,
+                               sourceFunction});
+}
+
+void PrettyPrinterBase::finishPrinting(std::ostream& os) {
+  printFooter(os);
+  if (this->debug)
+    os << syntax.comment() << " render cache: " << renderCacheHits
+       << " hits, " << renderCacheMisses << " misses\n";
+  saveCaches(os);
+}
+
+void PrettyPrinterBase::saveCaches(std::ostream& os) {
+  if (!policy.renderCacheFile.empty() && renderCacheChanged)
+    saveRenderCache();
+  if (!outputCacheAdded.empty())
+    saveOutputCache();
+  if (!policy.sidecarDir.empty() && (!sidecar || !sidecarAdded.empty()))
+    saveSidecar();
+  if (outputPosition) {
+    os.flush();
+    if (!sourceMap.save(policy.sourceMapFile))
+      std::cerr << "WARNING: could not write the source map "
+                << policy.sourceMapFile << "\n";
+  }
+}
+
+std::pair<size_t, size_t>
+PrettyPrinterBase::getShardBlocks(size_t shard) const {
+  // Shards start at function entries and section starts. Symbolic data
+  // runs end there, so the end of the last block printed is the only state
+  // carried over from the previous shard.
+  const std::vector<ModuleIndex::Block>& blocks = index->blocks;
+  uint64_t total = 0;
+  for (const ModuleIndex::Block& block : blocks)
+    total += index->extentOf(block).second;
+  auto shardStart = [&](size_t s) -> size_t {
+    if (s == 0)
+      return 0;
+    if (s >= policy.shardCount)
+      return blocks.size();
+    const size_t n = policy.shardCount;
+    const uint64_t target = total / n * s + total % n * s / n;
+    uint64_t offset = 0;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+      auto [addr, size] = index->extentOf(blocks[i]);
+      if (offset >= target &&
+          ((std::holds_alternative<const gtirb::CodeBlock*>(blocks[i]) &&
+            isFunctionEntry(addr)) ||
+           index->findSectionAt(addr)))
+        return i;
+      offset += size;
+    }
+    return blocks.size();
+  };
+  return {shardStart(shard), shardStart(shard + 1)};
+}
+
+void PrettyPrinterBase::printShard(std::ostream& os) {
+  const std::vector<ModuleIndex::Block>& blocks = index->blocks;
+  auto [begin, end] = getShardBlocks(policy.shard);
+  os << syntax.comment() << ' ' << ShardMarker << policy.shard << '/'
+     << policy.shardCount << " module " << module.getUUID() << " blocks "
+     << begin << '-' << end << '/' << blocks.size() << '\n';
+
+  // Find the end of the last block the previous shards print, as printing
+  // them would.
   gtirb::Addr last{0};
-  while (blockIt != blocks.end() && dataIt != module.data_blocks_end()) {
-    if ((*blockIt)->getAddress() <= dataIt->getAddress()) {
-      last = printBlockOrWarning(os, **blockIt, last);
-      blockIt++;
-    } else {
-      last = printDataBlockOrWarning(os, *dataIt, last);
-      dataIt++;
+  for (size_t i = 0; i < begin; ++i) {
+    auto [addr, size] = index->extentOf(blocks[i]);
+    if (addr >= last)
+      last = addr + size;
+  }
+
+  if (policy.shard == 0)
+    printHeader(os);
+  last = printBlockRange(os, blocks, begin, end, last);
+  endSymbolicDataRun(os);
+  if (policy.shard + 1 == policy.shardCount) {
+    printModuleEnd(os, last);
+    finishPrinting(os);
+  } else {
+    saveCaches(os);
+  }
+}
+
+std::vector<std::pair<gtirb::Addr, gtirb::Addr>>
+PrettyPrinterBase::getSelectedRegions() const {
+  std::vector<std::pair<gtirb::Addr, gtirb::Addr>> regions;
+  for (const auto& [begin, end] : policy.selectRanges)
+    regions.emplace_back(gtirb::Addr(begin), gtirb::Addr(end));
+  for (const std::string& name : policy.selectSections) {
+    for (const gtirb::Section& section : module.findSections(name)) {
+      if (std::optional<gtirb::Addr> addr = addressOf(section))
+        regions.emplace_back(*addr, *addr + *index->sizeOf(section));
     }
   }
-  for (; blockIt != blocks.end(); blockIt++)
-    last = printBlockOrWarning(os, **blockIt, last);
-  for (; dataIt != module.data_blocks_end(); dataIt++)
-    last = printDataBlockOrWarning(os, *dataIt, last);
-  bool inData = !module.findDataBlocksOn(last).empty();
-  printSymbolDefinitionsAtAddress(os, last, inData);
-  printSectionFooter(os, std::nullopt, last);
-  printFooter(os);
-  return os;
+  for (const std::string& name : policy.selectFunctions) {
+    for (const gtirb::Symbol& symbol : module.findSymbols(name)) {
+      std::optional<gtirb::Addr> addr = addressOf(symbol);
+      if (!addr || !isFunctionEntry(*addr))
+        continue;
+      regions.emplace_back(*addr, getFunctionEnd(*addr));
+    }
+  }
+
+  // Merge the overlapping regions so that no block is printed twice.
+  std::sort(regions.begin(), regions.end());
+  std::vector<std::pair<gtirb::Addr, gtirb::Addr>> merged;
+  for (const auto& region : regions) {
+    if (!merged.empty() && region.first <= merged.back().second)
+      merged.back().second = std::max(merged.back().second, region.second);
+    else
+      merged.push_back(region);
+  }
+  return merged;
+}
+
+gtirb::Addr PrettyPrinterBase::getFunctionEnd(gtirb::Addr entry) const {
+  // The function ends at the next function or at the end of its section.
+  const auto section = getContainerSection(entry);
+  gtirb::Addr end = section ? *addressOf(**section) +
+                                  *index->sizeOf(**section)
+                            : entry;
+  auto next =
+      std::upper_bound(functionEntry.begin(), functionEntry.end(), entry);
+  if (next != functionEntry.end())
+    end = std::min(end, *next);
+  return end;
+}
+
+void PrettyPrinterBase::printSelectedRegions(std::ostream& os) {
+  const auto regions = getSelectedRegions();
+  for (const auto& [begin, end] : regions)
+    printRegion(os, begin, end);
+  printOutsideSymbols(os, regions);
+}
+
+void PrettyPrinterBase::printOutsideSymbols(
+    std::ostream& os,
+    const std::vector<std::pair<gtirb::Addr, gtirb::Addr>>& regions) {
+  auto isOutside = [&regions](gtirb::Addr addr) {
+    auto next = std::upper_bound(
+        regions.begin(), regions.end(), addr,
+        [](gtirb::Addr a, const auto& region) { return a < region.first; });
+    return next == regions.begin() || std::prev(next)->second <= addr;
+  };
+
+  // Symbols without an address are undefined in the full output as well,
+  // and forwarded symbols are printed as the symbols they forward to.
+  std::vector<const gtirb::Symbol*> outside;
+  std::unordered_set<const gtirb::Symbol*> seen;
+  std::ostringstream forwarded;
+  auto visit = [&](const gtirb::Symbol* symbol) {
+    std::optional<gtirb::Addr> addr = addressOf(*symbol);
+    if (addr && isOutside(*addr) && !skipEA(*addr) &&
+        seen.insert(symbol).second &&
+        !printForwardedSymbolName(forwarded, symbol, false))
+      outside.push_back(symbol);
+  };
+  for (const auto& [begin, end] : regions) {
+    forEachSymbolicExpressionIn(
+        begin, end,
+        [&](gtirb::Addr, const gtirb::SymbolicExpression& expr) {
+          if (const auto* s = std::get_if<gtirb::SymAddrConst>(&expr)) {
+            visit(s->Sym);
+          } else if (const auto* sa = std::get_if<gtirb::SymAddrAddr>(&expr)) {
+            visit(sa->Sym1);
+            visit(sa->Sym2);
+          }
+        });
+  }
+  if (outside.empty())
+    return;
+
+  os << '\n';
+  for (const gtirb::Symbol* symbol : outside) {
+    os << syntax.set() << ' ';
+    gtirb::Addr addr = *addressOf(*symbol);
+    if (this->isAmbiguousSymbol(symbol->getName()))
+      printSymbolName(os, addr);
+    else
+      syntax.printSymbolName(os, symbol->getName());
+    os << ", 0x" << std::hex << static_cast<uint64_t>(addr) << std::dec
+       << '\n';
+  }
+}
+
+void PrettyPrinterBase::printRegion(std::ostream& os, gtirb::Addr begin,
+                                    gtirb::Addr end) {
+  const std::vector<ModuleIndex::Block>& blocks = index->blocks;
+  auto [first, last] = index->findBlocksAt(begin, end);
+  if (first == last)
+    return;
+
+  // A region starting inside a section needs the header of that section.
+  gtirb::Addr firstAddr = index->extentOf(blocks[first]).first;
+  const auto section = getContainerSection(firstAddr);
+  if (section && addressOf(**section) != firstAddr)
+    printSectionHeaderFor(os, **section, firstAddr);
+
+  gtirb::Addr lastEnd =
+      printBlockRange(os, blocks, first, last, gtirb::Addr{0});
+  endSymbolicDataRun(os);
+  printSectionFooter(os, std::nullopt, lastEnd);
 }
 
 gtirb::Addr PrettyPrinterBase::printBlockOrWarning(
     std::ostream& os, const gtirb::CodeBlock& block, gtirb::Addr last) {
-  gtirb::Addr nextAddr = *block.getAddress();
+  endSymbolicDataRun(os);
+  gtirb::Addr nextAddr = *addressOf(block);
   if (nextAddr < last) {
     printOverlapWarning(os, nextAddr);
     return last;
   } else {
-    if (nextAddr > last) {
-      bool inData = !module.findDataBlocksOn(last).empty();
-      printSymbolDefinitionsAtAddress(os, last, inData);
-    }
-    printSectionFooter(os, nextAddr, last);
-    printSectionHeader(os, nextAddr);
+    printBlockTransition(os, nextAddr, last);
     printBlock(os, block);
-    return *block.getAddress() + block.getSize();
+    return nextAddr + block.getSize();
+  }
+}
+
+void PrettyPrinterBase::printBlockTransition(std::ostream& os,
+                                             gtirb::Addr nextAddr,
+                                             gtirb::Addr last) {
+  if (nextAddr > last) {
+    bool inData = index->hasDataBlocksOn(last);
+    printSymbolDefinitionsAtAddress(os, last, inData);
   }
+  printSectionFooter(os, nextAddr, last);
+  printSectionHeader(os, nextAddr);
 }
 
 gtirb::Addr PrettyPrinterBase::printDataBlockOrWarning(
     std::ostream& os, const gtirb::DataBlock& dataObject, gtirb::Addr last) {
-  gtirb::Addr nextAddr = *dataObject.getAddress();
+  gtirb::Addr nextAddr = *addressOf(dataObject);
+  if (continuesSymbolicDataRun(dataObject)) {
+    if (sourcePosition) {
+      beginSourceBlock(dataObject.getUUID(), nextAddr);
+      addSourceMapEntry(nextAddr);
+    }
+    os << ", ";
+    printSymbolicDataValue(os, findSymbolicExpression(nextAddr));
+    symbolicDataRun->end = nextAddr + dataObject.getSize();
+    return symbolicDataRun->end;
+  }
+  endSymbolicDataRun(os);
   if (nextAddr < last) {
     printOverlapWarning(os, nextAddr);
     return last;
   } else {
-    if (nextAddr > last) {
-      bool inData = !module.findDataBlocksOn(last).empty();
-      printSymbolDefinitionsAtAddress(os, last, inData);
+    printBlockTransition(os, nextAddr, last);
+    printDataBlock(os, dataObject);
+    return nextAddr + dataObject.getSize();
+  }
+}
+
+void PrettyPrinterBase::printOverlapWarning(std::ostream& os,
+                                            const gtirb::Addr addr) {
+  std::ios_base::fmtflags flags = os.flags();
+  os << syntax.comment() << " WARNING: found overlapping element at address "
+     << std::hex << static_cast<uint64_t>(addr) << ": ";
+  os.flags(flags);
+}
+
+std::string_view TextArena::intern(std::string_view text) {
+  if (text.empty())
+    return {};
+  if (auto found = strings.find(text); found != strings.end())
+    return *found;
+  char* copy;
+  if (text.size() > ChunkSize / 4) {
+    // Large strings get a chunk of their own, so that the rest of the
+    // current chunk is still used.
+    chunks.emplace_back(new char[text.size()]);
+    chunkBytes += text.size();
+    copy = chunks.back().get();
+  } else {
+    if (left < text.size()) {
+      chunks.emplace_back(new char[ChunkSize]);
+      chunkBytes += ChunkSize;
+      next = chunks.back().get();
+      left = ChunkSize;
+    }
+    copy = next;
+    next += text.size();
+    left -= text.size();
+  }
+  std::memcpy(copy, text.data(), text.size());
+  return *strings.insert(std::string_view(copy, text.size())).first;
+}
+
+ScratchBuf::int_type ScratchBuf::overflow(int_type c) {
+  if (!traits_type::eq_int_type(c, traits_type::eof()))
+    text.push_back(traits_type::to_char_type(c));
+  return traits_type::not_eof(c);
+}
+
+std::streamsize ScratchBuf::xsputn(const char* s, std::streamsize n) {
+  text.append(s, n);
+  return n;
+}
+
+// Empty \p buf, keeping its capacity, and return \p os, which prints to it,
+// with the formatting of a new stream.
+static std::ostream& clearScratch(std::ostream& os, ScratchBuf& buf) {
+  buf.text.clear();
+  os.clear();
+  os.flags(std::ios_base::skipws | std::ios_base::dec);
+  os.fill(' ');
+  return os;
+}
+
+void PrettyPrinterBase::printBlock(std::ostream& os,
+                                   const gtirb::CodeBlock& x) {
+  const gtirb::Addr addr = *addressOf(x);
+  if (skipEA(addr)) {
+    return;
+  }
+  if (sourcePosition)
+    beginSourceBlock(x.getUUID(), addr);
+  printBlockContents(os, x);
+}
+
+gtirb::Addr
+PrettyPrinterBase::printChunk(std::ostream& os,
+                              const std::vector<ModuleIndex::Block>& blocks,
+                              size_t begin, size_t end, gtirb::Addr last) {
+  // Symbolic data runs do not continue into a chunk, so this prints what
+  // its first block would.
+  endSymbolicDataRun(os);
+  auto printBlocks = [&](std::ostream& out) {
+    for (size_t i = begin; i < end; ++i)
+      last = printNextBlock(out, blocks[i], last);
+    endSymbolicDataRun(out);
+  };
+  // Data written to the incbin file cannot be copied with the text.
+  bool cacheable = !policy.outputCacheFile.empty();
+  for (size_t i = begin; cacheable && i < end; ++i)
+    cacheable = policy.incbinFile.empty() ||
+                std::holds_alternative<const gtirb::CodeBlock*>(blocks[i]);
+  if (!cacheable) {
+    printBlocks(os);
+    return last;
+  }
+
+  // Splice in the text of an unchanged chunk from the output cache.
+  const gtirb::Addr addr = index->extentOf(blocks[begin]).first;
+  ChunkHash key = hashChunk(blocks, begin, end, last);
+  auto [first, lastFound] = outputCache.equal_range(key);
+  for (auto found = first; found != lastFound; ++found) {
+    OutputCacheEntry& entry = found->second;
+    if (entry.address && *entry.address != addr)
+      continue;
+    entry.used = true;
+    if (sourcePosition) {
+      const gtirb::UUID& id = std::visit(
+          [](const auto* b) -> const gtirb::UUID& { return b->getUUID(); },
+          blocks[begin]);
+      beginSourceBlock(id, addr);
+      addSourceMapEntry(addr);
+    }
+    os << entry.text;
+    for (size_t i = begin; i < end; ++i) {
+      auto [blockAddr, size] = index->extentOf(blocks[i]);
+      if (blockAddr >= last)
+        last = blockAddr + size;
+    }
+    return last;
+  }
+  // Debug output prints the address of every instruction.
+  outputCacheAddressDependent = this->debug;
+  std::ostream& text = clearScratch(chunkStream, chunkText);
+  if (sourcePosition) {
+    // Count the positions in the chunk text, then move them to where the
+    // text is printed.
+    size_t firstEntry = sourceMap.entries.size();
+    uint64_t offset = sourcePosition->offset();
+    uint64_t line = sourcePosition->line();
+    OutputPosition* outer = sourcePosition;
+    {
+      OutputPosition textPosition(&chunkText);
+      std::ostream textStream(&textPosition);
+      sourcePosition = &textPosition;
+      printBlocks(textStream);
+    }
+    sourcePosition = outer;
+    for (size_t i = firstEntry; i < sourceMap.entries.size(); ++i) {
+      sourceMap.entries[i].offset += offset;
+      sourceMap.entries[i].line += line - 1;
+    }
+  } else {
+    printBlocks(text);
+  }
+  std::optional<gtirb::Addr> address;
+  if (outputCacheAddressDependent)
+    address = addr;
+  std::string_view added = textArena.intern(chunkText.text);
+  outputCacheAdded.push_back(OutputCacheChunk{key, address, added});
+  outputCache.emplace(key, OutputCacheEntry{added, address, true});
+  os << added;
+  return last;
+}
+
+void PrettyPrinterBase::printBlockContents(std::ostream& os,
+                                           const gtirb::CodeBlock& x) {
+  blockInterval = x.getByteInterval();
+  const gtirb::Addr addr = *addressOf(x);
+  printFunctionHeader(os, addr);
+  os << '\n';
+
+  cs_option(this->csHandle, CS_OPT_DETAIL, CS_OPT_ON);
+  gtirb::Offset offset = policy.passthrough
+                             ? printPassthroughBlockInstructions(os, x)
+                             : printBlockInstructions(os, x);
+
+  // print any CFI directives located at the end of the block
+  // e.g. '.cfi_endproc' is usually attached to the end of the block
+  printCFIDirectives(os, offset);
+  printFunctionFooter(os, addr);
+  blockInterval = nullptr;
+}
+
+const gtirb::ByteInterval*
+PrettyPrinterBase::findBlockInterval(gtirb::Addr begin, gtirb::Addr end) const {
+  if (!blockInterval)
+    return nullptr;
+  std::optional<gtirb::Addr> base = addressOf(*blockInterval);
+  if (!base)
+    return nullptr;
+  return begin >= *base && end <= *base + blockInterval->getSize()
+             ? blockInterval
+             : nullptr;
+}
+
+bool PrettyPrinterBase::hasSymbolicExpressions(gtirb::Addr begin,
+                                               gtirb::Addr end) const {
+  if (const gtirb::ByteInterval* interval = findBlockInterval(begin, end)) {
+    uint64_t base = static_cast<uint64_t>(*addressOf(*interval));
+    return !interval
+                ->findSymbolicExpressionsAtOffset(
+                    static_cast<uint64_t>(begin) - base,
+                    static_cast<uint64_t>(end) - base)
+                .empty();
+  }
+  bool found = false;
+  forEachSymbolicExpressionIn(
+      begin, end,
+      [&found](gtirb::Addr, const gtirb::SymbolicExpression&) {
+        found = true;
+      });
+  return found;
+}
+
+const gtirb::SymbolicExpression*
+PrettyPrinterBase::findSymbolicExpression(gtirb::Addr ea) const {
+  if (const gtirb::ByteInterval* interval = findBlockInterval(ea, ea + 1))
+    return interval->getSymbolicExpression(
+        static_cast<uint64_t>(ea) -
+        static_cast<uint64_t>(*addressOf(*interval)));
+  const gtirb::SymbolicExpression* found = nullptr;
+  forEachSymbolicExpressionIn(
+      ea, ea + 1,
+      [&found](gtirb::Addr, const gtirb::SymbolicExpression& expr) {
+        if (!found)
+          found = &expr;
+      });
+  return found;
+}
+
+bool PrettyPrinterBase::hasSymbolsAt(gtirb::Addr ea) const {
+  return findFirstSymbolAt(ea) != nullptr;
+}
+
+const gtirb::Symbol*
+PrettyPrinterBase::findFirstSymbolAt(gtirb::Addr ea) const {
+  const gtirb::Symbol* found = nullptr;
+  forEachSymbolIn(ea, ea + 1, [&found](const gtirb::Symbol& symbol) {
+    if (!found)
+      found = &symbol;
+  });
+  return found;
+}
+
+bool PrettyPrinterBase::isAnnotated(const gtirb::CodeBlock& x,
+                                    uint64_t displacement) const {
+  return hasSymbolsAt(*addressOf(x) + displacement) ||
+         hasCFIDirectives(gtirb::Offset(x.getUUID(), displacement));
+}
+
+void PrettyPrinterBase::printNops(std::ostream& os, const gtirb::CodeBlock& x,
+                                  const gtirb::Offset& offset, uint64_t size) {
+  gtirb::Addr ea = *addressOf(x) + offset.Displacement;
+  gtirb::Addr blockEnd = *addressOf(x) + x.getSize();
+  printSymbolDefinitionsAtAddress(os, ea);
+  printComments(os, offset, size);
+  printCFIDirectives(os, offset);
+  // Padding in front of a function entry is replaced by the alignment
+  // directive of the function header.
+  if (ea + size == blockEnd && isFunctionEntry(blockEnd) &&
+      !skipEA(blockEnd) && size < getAlignment(blockEnd))
+    return;
+  printEA(os, ea);
+  os << syntax.nops() << ' ' << size << '\n';
+}
+
+gtirb::Offset
+PrettyPrinterBase::printBlockInstructions(std::ostream& os,
+                                          const gtirb::CodeBlock& x) {
+  const uint8_t* bytes = x.rawBytes<uint8_t>();
+  const uint64_t size = x.getSize();
+  const gtirb::Addr addr = *addressOf(x);
+
+  // Instructions are decoded one at a time, so that the ones found in the
+  // render cache are not decoded at all.
+  cs_insn* inst = cs_malloc(this->csHandle);
+  std::unique_ptr<cs_insn, std::function<void(cs_insn*)>> freeInst(
+      inst, [](cs_insn* i) { cs_free(i, 1); });
+  auto decode = [&](uint64_t displacement) {
+    const uint8_t* code = bytes + displacement;
+    size_t codeSize = size - displacement;
+    uint64_t address = static_cast<uint64_t>(addr) + displacement;
+    if (findSidecarInstruction(code, codeSize, address, *inst))
+      return true;
+    if (sharedDecode) {
+      const cs_insn* found = sharedDecode->find(x, addr, address);
+      if (!found)
+        return false;
+      copySharedInstruction(*found, *inst, code);
+    } else if (!cs_disasm_iter(this->csHandle, &code, &codeSize, &address,
+                               inst)) {
+      return false;
+    }
+    addSidecarInstruction(*inst);
+    return true;
+  };
+
+  gtirb::Offset offset(x.getUUID(), 0);
+  while (offset.Displacement < size) {
+    gtirb::Addr ea = addr + offset.Displacement;
+    std::optional<std::string_view> text;
+    uint64_t instSize = 0;
+    if (const auto* cached = findRenderedInstruction(
+            bytes + offset.Displacement, size - offset.Displacement, ea)) {
+      text = cached->second;
+      instSize = cached->first.size();
+    }
+
+    if (!text) {
+      if (!decode(offset.Displacement))
+        break;
+
+      // Coalesce NOPs into a single padding directive.
+      if (useNopsDirective() && isNop(*inst)) {
+        uint64_t runSize = inst->size;
+        while (offset.Displacement + runSize < size &&
+               !isAnnotated(x, offset.Displacement + runSize) &&
+               decode(offset.Displacement + runSize) && isNop(*inst))
+          runSize += inst->size;
+        if (runSize > 1) {
+          printNops(os, x, offset, runSize);
+          offset.Displacement += runSize;
+          continue;
+        }
+        decode(offset.Displacement);
+      }
+
+      fixupInstruction(*inst);
+      if (!isRenderCacheable(*inst)) {
+        noteAddressDependence(*inst);
+        printInstruction(os, *inst, offset);
+        offset.Displacement += inst->size;
+        os << '\n';
+        continue;
+      }
+      text = renderInstruction(*inst, bytes + offset.Displacement);
+      instSize = inst->size;
     }
-    printSectionFooter(os, nextAddr, last);
-    printSectionHeader(os, nextAddr);
-    printDataBlock(os, dataObject);
-    return *dataObject.getAddress() + dataObject.getSize();
-  }
-}
 
-void PrettyPrinterBase::printOverlapWarning(std::ostream& os,
-                                            const gtirb::Addr addr) {
-  std::ios_base::fmtflags flags = os.flags();
-  os << syntax.comment() << " WARNING: found overlapping element at address "
-     << std::hex << static_cast<uint64_t>(addr) << ": ";
-  os.flags(flags);
+    // Same as printInstruction, with the opcode and operands taken from the
+    // render cache.
+    printSymbolDefinitionsAtAddress(os, ea);
+    printComments(os, offset, instSize);
+    printCFIDirectives(os, offset);
+    printEA(os, ea);
+    os << *text << '\n';
+    offset.Displacement += instSize;
+  }
+  return offset;
 }
 
-void PrettyPrinterBase::printBlock(std::ostream& os,
-                                   const gtirb::CodeBlock& x) {
-  if (skipEA(*x.getAddress())) {
-    return;
+gtirb::Offset PrettyPrinterBase::printPassthroughBlockInstructions(
+    std::ostream& os, const gtirb::CodeBlock& x) {
+  const uint8_t* bytes = x.rawBytes<uint8_t>();
+  const gtirb::Addr addr = *addressOf(x);
+  cs_insn* insn = nullptr;
+  size_t count = 0;
+  if (sharedDecode) {
+    // The instructions are modified while printing, so each printer works
+    // on its own copies.
+    const SharedDecode::Instructions& decoded = sharedDecode->decode(x, addr);
+    count = decoded.count;
+    sharedCopies.resize(count);
+    sharedCopyDetails.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+      const cs_insn& from = decoded.insn[i];
+      uint64_t displacement = from.address - static_cast<uint64_t>(addr);
+      sharedCopies[i].detail = &sharedCopyDetails[i];
+      copySharedInstruction(from, sharedCopies[i], bytes + displacement);
+    }
+    insn = sharedCopies.data();
+  } else {
+    count = cs_disasm(this->csHandle, bytes, x.getSize(),
+                      static_cast<uint64_t>(addr), 0, &insn);
   }
-  printFunctionHeader(os, *x.getAddress());
-  os << '\n';
-
-  cs_insn* insn;
-  cs_option(this->csHandle, CS_OPT_DETAIL, CS_OPT_ON);
-
-  size_t count = cs_disasm(this->csHandle, x.rawBytes<uint8_t>(), x.getSize(),
-                           static_cast<uint64_t>(*x.getAddress()), 0, &insn);
 
   // Exception-safe cleanup of instructions
   std::unique_ptr<cs_insn, std::function<void(cs_insn*)>> freeInsn(
-          insn, [count](cs_insn* i) { cs_free(i, count); });
+      sharedDecode ? nullptr : insn,
+      [count](cs_insn* i) { cs_free(i, count); });
 
   gtirb::Offset offset(x.getUUID(), 0);
-  for (size_t i = 0; i < count; i++) {
-      fixupInstruction(insn[i]);
-      printInstruction(os, insn[i], offset);
-      offset.Displacement += insn[i].size;
+  size_t i = 0;
+  while (i < count) {
+    // Coalesce the instructions that can be printed as raw bytes. Labels and
+    // CFI directives have to be printed between instructions, so they end
+    // the run.
+    size_t runEnd = i;
+    uint64_t runSize = 0;
+    while (runEnd < count && isPassthroughInstruction(insn[runEnd]) &&
+           (runEnd == i || !isAnnotated(x, offset.Displacement + runSize))) {
+      runSize += insn[runEnd].size;
+      ++runEnd;
+    }
+    if (runEnd > i) {
+      printCFIDirectives(os, offset);
+      printPassthroughInstructions(os, insn + i, insn + runEnd);
+      offset.Displacement += runSize;
       os << '\n';
+      i = runEnd;
+      continue;
+    }
+
+    // Coalesce NOPs into a single padding directive.
+    if (useNopsDirective()) {
+      while (runEnd < count && isNop(insn[runEnd]) &&
+             (runEnd == i || !isAnnotated(x, offset.Displacement + runSize))) {
+        runSize += insn[runEnd].size;
+        ++runEnd;
+      }
+    }
+    if (runSize > 1) {
+      printNops(os, x, offset, runSize);
+      offset.Displacement += runSize;
+      i = runEnd;
+      continue;
+    }
+
+    fixupInstruction(insn[i]);
+    noteAddressDependence(insn[i]);
+    printInstruction(os, insn[i], offset);
+    offset.Displacement += insn[i].size;
+    os << '\n';
+    ++i;
   }
-  // print any CFI directives located at the end of the block
-  // e.g. '.cfi_endproc' is usually attached to the end of the block
-  printCFIDirectives(os, offset);
-  printFunctionFooter(os, *x.getAddress());
+  return offset;
 }
 
 void PrettyPrinterBase::printSectionHeader(std::ostream& os,
                                            const gtirb::Addr addr) {
-  const auto found_section = module.findSectionsAt(addr);
-  if (found_section.begin() == found_section.end())
-    return;
-  std::string sectionName = found_section.begin()->getName();
+  if (const gtirb::Section* section = index->findSectionAt(addr))
+    printSectionHeaderFor(os, *section, addr);
+}
+
+void PrettyPrinterBase::printSectionHeaderFor(std::ostream& os,
+                                              const gtirb::Section& section,
+                                              const gtirb::Addr addr) {
+  const std::string& sectionName = section.getName();
   if (policy.skipSections.count(sectionName))
     return;
   os << '\n';
@@ -340,8 +1918,8 @@ void PrettyPrinterBase::printSectionHeader(std::ostream& os,
   } else if (sectionName == syntax.bssSection()) {
     os << syntax.bss() << '\n';
   } else {
-    printSectionHeaderDirective(os, *(found_section.begin()));
-    printSectionProperties(os, *(found_section.begin()));
+    printSectionHeaderDirective(os, section);
+    printSectionProperties(os, section);
     os << std::endl;
   }
   if (policy.arraySections.count(sectionName)) {
@@ -382,6 +1960,8 @@ void PrettyPrinterBase::printSectionFooter(
 }
 
 void PrettyPrinterBase::printBar(std::ostream& os, bool heavy) {
+  if (policy.minimal)
+    return;
   if (heavy) {
     os << syntax.comment() << "===================================\n";
   } else {
@@ -392,31 +1972,29 @@ void PrettyPrinterBase::printBar(std::ostream& os, bool heavy) {
 void PrettyPrinterBase::printSymbolReference(std::ostream& os,
                                              const gtirb::Symbol* symbol,
                                              bool inData) const {
-  std::optional<std::string> forwardedName =
-      getForwardedSymbolName(symbol, inData);
-  if (forwardedName) {
-    os << forwardedName.value();
+  if (printForwardedSymbolName(os, symbol, inData))
     return;
-  }
-  if (symbol->getAddress() && skipEA(*symbol->getAddress())) {
-    os << static_cast<uint64_t>(*symbol->getAddress());
+  std::optional<gtirb::Addr> addr = addressOf(*symbol);
+  if (addr && skipEA(*addr)) {
+    os << static_cast<uint64_t>(*addr);
     return;
   }
   if (this->isAmbiguousSymbol(symbol->getName()))
-    os << getSymbolName(*symbol->getAddress());
+    printSymbolName(os, *addr);
   else
-    os << syntax.formatSymbolName(symbol->getName());
+    syntax.printSymbolName(os, symbol->getName());
 }
 
 void PrettyPrinterBase::printSymbolDefinitionsAtAddress(std::ostream& os,
                                                         gtirb::Addr ea,
                                                         bool /* inData */) {
-  for (const gtirb::Symbol& symbol : module.findSymbols(ea)) {
+  forEachSymbolIn(ea, ea + 1, [&](const gtirb::Symbol& symbol) {
     if (this->isAmbiguousSymbol(symbol.getName()))
-      os << getSymbolName(*symbol.getAddress()) << ":\n";
+      printSymbolName(os, ea);
     else
-      os << syntax.formatSymbolName(symbol.getName()) << ":\n";
-  }
+      syntax.printSymbolName(os, symbol.getName());
+    os << ":\n";
+  });
 }
 
 void PrettyPrinterBase::fixupInstruction(cs_insn& inst) {
@@ -442,8 +2020,9 @@ void PrettyPrinterBase::fixupInstruction(cs_insn& inst) {
     op.imm = static_cast<int32_t>(op.imm);
   }
 
-  // GCC assembler does not like endbr64 instructions
-  if (inst.id == X86_INS_ENDBR64) {
+  // Older GNU assemblers do not accept endbr64 instructions
+  if (inst.id == X86_INS_ENDBR64 &&
+      !(policy.endbr64 && syntax.hasEndbr64())) {
     inst.id = X86_INS_NOP;
   }
 
@@ -460,6 +2039,63 @@ void PrettyPrinterBase::fixupInstruction(cs_insn& inst) {
   }
 }
 
+bool PrettyPrinterBase::isPassthroughInstruction(const cs_insn& inst) const {
+  if (!policy.passthrough || this->debug)
+    return false;
+  gtirb::Addr ea(inst.address);
+  if (hasSymbolsAt(ea) || hasSymbolicExpressions(ea, ea + inst.size))
+    return false;
+  return !isPCRelative(inst);
+}
+
+bool PrettyPrinterBase::isPCRelative(const cs_insn& inst) const {
+  // Indirect jumps and calls do not need to be relocated, but they are rare
+  // enough that it is not worth telling them apart.
+  if (cs_insn_group(this->csHandle, &inst, CS_GRP_JUMP) ||
+      cs_insn_group(this->csHandle, &inst, CS_GRP_CALL) ||
+      cs_insn_group(this->csHandle, &inst, CS_GRP_BRANCH_RELATIVE))
+    return true;
+  const cs_x86& detail = inst.detail->x86;
+  for (uint8_t i = 0; i < detail.op_count; i++) {
+    const cs_x86_op& op = detail.operands[i];
+    if (op.type == X86_OP_MEM &&
+        (op.mem.base == X86_REG_RIP || op.mem.base == X86_REG_EIP))
+      return true;
+  }
+  return false;
+}
+
+bool PrettyPrinterBase::isNop(const cs_insn& inst) const {
+  return inst.id == X86_INS_NOP;
+}
+
+static void printHexByte(std::ostream& os, uint8_t byte) {
+  static const char digits[] = "0123456789abcdef";
+  os << "0x" << digits[byte >> 4] << digits[byte & 0xf];
+}
+
+void PrettyPrinterBase::printPassthroughInstructions(std::ostream& os,
+                                                     const cs_insn* first,
+                                                     const cs_insn* last) {
+  os << indent() << syntax.byteData() << ' ';
+  for (const cs_insn* inst = first; inst != last; ++inst) {
+    if (inst != first) {
+      if (policy.passthroughComments)
+        os << '\n' << indent() << syntax.byteData() << ' ';
+      else
+        os << ',';
+    }
+    for (uint16_t i = 0; i < inst->size; ++i) {
+      if (i != 0)
+        os << ',';
+      printHexByte(os, inst->bytes[i]);
+    }
+    if (policy.passthroughComments)
+      os << ' ' << syntax.comment() << ' ' << inst->mnemonic << ' '
+         << inst->op_str;
+  }
+}
+
 void PrettyPrinterBase::printInstruction(std::ostream& os, const cs_insn& inst,
                                          const gtirb::Offset& offset) {
 
@@ -473,12 +2109,12 @@ void PrettyPrinterBase::printInstruction(std::ostream& os, const cs_insn& inst,
   // special cases
 
   if (inst.id == X86_INS_NOP || inst.id == ARM64_INS_NOP) {
-    os << "  " << syntax.nop();
+    os << syntax.nop();
     for (uint64_t i = 1; i < inst.size; ++i) {
       ea += 1;
       os << '\n';
       printEA(os, ea);
-      os << "  " << syntax.nop();
+      os << syntax.nop();
     }
     return;
   }
@@ -486,16 +2122,881 @@ void PrettyPrinterBase::printInstruction(std::ostream& os, const cs_insn& inst,
   // end special cases
   ////////////////////////////////////////////////////////////////////
 
-  std::string opcode = ascii_str_tolower(inst.mnemonic);
-  os << "  " << opcode << ' ';
+  printOpcodeAndOperands(os, inst);
+}
+
+void PrettyPrinterBase::printOpcodeAndOperands(std::ostream& os,
+                                               const cs_insn& inst) {
+  ascii_write_lower(os, inst.mnemonic) << ' ';
   printOperandList(os, inst);
 }
 
+bool PrettyPrinterBase::isRenderCacheable(const cs_insn& inst) const {
+  if (policy.renderCacheSize == 0 || inst.size > MaxInstructionSize)
+    return false;
+  // NOPs are special-cased by printInstruction, and endbr64 is printed
+  // depending on the policy.
+  if (inst.id == X86_INS_NOP || inst.id == ARM64_INS_NOP ||
+      inst.id == X86_INS_ENDBR64)
+    return false;
+  gtirb::Addr ea(inst.address);
+  return !isPCRelative(inst) && !hasSymbolicExpressions(ea, ea + inst.size);
+}
+
+const PrettyPrinterBase::RenderCache::value_type*
+PrettyPrinterBase::findRenderedInstruction(const uint8_t* bytes, uint64_t size,
+                                           gtirb::Addr ea) {
+  if (renderCache.empty())
+    return nullptr;
+  // Decoding only looks at the bytes of the instruction being decoded, so
+  // at most one prefix of the bytes can be a cached instruction.
+  uint64_t maxSize = std::min<uint64_t>(size, MaxInstructionSize);
+  for (uint64_t keySize = 1; keySize <= maxSize; ++keySize) {
+    if ((renderCacheKeySizes & (1u << keySize)) == 0)
+      continue;
+    auto found = renderCache.find(
+        std::string_view(reinterpret_cast<const char*>(bytes), keySize));
+    if (found == renderCache.end())
+      continue;
+    if (hasSymbolicExpressions(ea, ea + keySize))
+      return nullptr;
+    ++renderCacheHits;
+    return &*found;
+  }
+  return nullptr;
+}
+
+std::string_view
+PrettyPrinterBase::renderInstruction(const cs_insn& inst,
+                                     const uint8_t* bytes) {
+  ++renderCacheMisses;
+  printOpcodeAndOperands(clearScratch(renderStream, renderText), inst);
+  if (renderCache.size() >= policy.renderCacheSize)
+    return renderText.text;
+  std::string_view key = textArena.intern(
+      std::string_view(reinterpret_cast<const char*>(bytes), inst.size));
+  renderCacheKeySizes |= 1u << inst.size;
+  renderCacheChanged = true;
+  return renderCache.emplace(key, textArena.intern(renderText.text))
+      .first->second;
+}
+
+// Cache files start with this line, so that the files written by other
+// versions of the printer or of Capstone are not used.
+static std::string cacheFileHeader(const std::string& kind) {
+  int major, minor;
+  cs_version(&major, &minor);
+  std::ostringstream header;
+  header << "gtirb-pprinter " << kind << ' ' << GTIRB_PPRINTER_VERSION_STRING
+         << " capstone " << major << '.' << minor << '\n';
+  return header.str();
+}
+
+// Write a new file and move it over the old one, so that concurrent runs
+// never read a partial cache file. Return false if it could not be written.
+static bool replaceCacheFile(const std::string& path,
+                             const std::function<void(std::ostream&)>& write) {
+  const std::string tempPath =
+      boost::filesystem::unique_path(path + ".%%%%-%%%%").string();
+  std::ofstream out(tempPath, std::ios::out | std::ios::binary);
+  write(out);
+  out.close();
+  if (!out || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+    std::cerr << "WARNING: could not write the cache file " << path << '\n';
+    std::remove(tempPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+namespace {
+// Serializes the updates of a cache file: between the threads of this
+// process through a mutex, and between processes through a lock file next
+// to it. Updates read the file again under the lock and merge their
+// entries into it, so that concurrent printers do not drop each other's.
+class CacheFileLock {
+public:
+  explicit CacheFileLock(const std::string& path) : threadLock(mutex()) {
+    namespace bip = boost::interprocess;
+    const std::string lockPath = path + ".lock";
+    std::ofstream(lockPath, std::ios::app);
+    try {
+      fileLock = bip::file_lock(lockPath.c_str());
+      fileLock.lock();
+      locked = true;
+    } catch (const bip::interprocess_exception&) {
+      std::cerr << "WARNING: could not lock " << lockPath
+                << "; concurrent updates of " << path << " may be lost\n";
+    }
+  }
+  ~CacheFileLock() {
+    if (locked)
+      fileLock.unlock();
+  }
+
+private:
+  static std::mutex& mutex() {
+    static std::mutex m;
+    return m;
+  }
+
+  std::lock_guard<std::mutex> threadLock;
+  boost::interprocess::file_lock fileLock;
+  bool locked = false;
+};
+} // namespace
+
+// Read at most maxEntries entries of a render cache file. Return nothing if
+// there is no such file, or if it is truncated or from another version.
+static std::optional<std::unordered_map<std::string, std::string>>
+readRenderCacheFile(const std::string& path, uint64_t maxEntries,
+                    uint64_t maxKeySize) {
+  namespace bip = boost::interprocess;
+  const std::string header = cacheFileHeader("render cache");
+  std::unordered_map<std::string, std::string> entries;
+  try {
+    bip::file_mapping file(path.c_str(), bip::read_only);
+    bip::mapped_region region(file, bip::read_only);
+    const char* pos = static_cast<const char*>(region.get_address());
+    const char* end = pos + region.get_size();
+    if (region.get_size() < header.size() ||
+        std::memcmp(pos, header.data(), header.size()) != 0)
+      return std::nullopt;
+    pos += header.size();
+
+    // Each entry is a one-byte key size, the key, a 32-bit text size and
+    // the text. A truncated file is dropped as a whole.
+    while (pos != end && entries.size() < maxEntries) {
+      uint8_t keySize = static_cast<uint8_t>(*pos++);
+      uint32_t textSize;
+      if (keySize == 0 || keySize > maxKeySize ||
+          static_cast<size_t>(end - pos) < keySize + sizeof(textSize))
+        return std::nullopt;
+      std::string key(pos, keySize);
+      pos += keySize;
+      std::memcpy(&textSize, pos, sizeof(textSize));
+      pos += sizeof(textSize);
+      if (static_cast<size_t>(end - pos) < textSize)
+        return std::nullopt;
+      entries.emplace(std::move(key), std::string(pos, textSize));
+      pos += textSize;
+    }
+  } catch (const bip::interprocess_exception&) {
+    // No cache yet; it is written once printing is done.
+    return std::nullopt;
+  }
+  return entries;
+}
+
+void PrettyPrinterBase::loadRenderCache() {
+  auto entries = readRenderCacheFile(
+      policy.renderCacheFile, policy.renderCacheSize, MaxInstructionSize);
+  if (!entries)
+    return;
+  renderCache.clear();
+  renderCache.reserve(entries->size());
+  renderCacheKeySizes = 0;
+  for (const auto& [key, text] : *entries) {
+    renderCache.emplace(textArena.intern(key), textArena.intern(text));
+    renderCacheKeySizes |= 1u << key.size();
+  }
+}
+
+void PrettyPrinterBase::saveRenderCache() const {
+  CacheFileLock lock(policy.renderCacheFile);
+  // Keep the entries of this run, then as many of the entries other
+  // printers saved since this one loaded the file as the size allows.
+  RenderCache merged = renderCache;
+  auto saved = readRenderCacheFile(policy.renderCacheFile,
+                                   policy.renderCacheSize, MaxInstructionSize);
+  if (saved)
+    for (const auto& [key, text] : *saved) {
+      if (merged.size() >= policy.renderCacheSize)
+        break;
+      merged.emplace(key, text);
+    }
+  replaceCacheFile(policy.renderCacheFile, [&merged](std::ostream& out) {
+    out << cacheFileHeader("render cache");
+    for (const auto& [key, text] : merged) {
+      uint32_t textSize = text.size();
+      out.put(static_cast<char>(key.size()));
+      out.write(key.data(), key.size());
+      out.write(reinterpret_cast<const char*>(&textSize), sizeof(textSize));
+      out.write(text.data(), textSize);
+    }
+  });
+}
+
+namespace {
+// Stream buffer that hashes everything written to it, so that the inputs
+// of a code block can be hashed in the form they are printed in.
+class HashingStreamBuf : public std::streambuf {
+public:
+  std::pair<uint64_t, uint64_t> digest() const { return {fnv, mix}; }
+
+protected:
+  int_type overflow(int_type c) override {
+    if (!traits_type::eq_int_type(c, traits_type::eof()))
+      update(static_cast<unsigned char>(c));
+    return traits_type::not_eof(c);
+  }
+
+  std::streamsize xsputn(const char* s, std::streamsize n) override {
+    for (std::streamsize i = 0; i < n; ++i)
+      update(static_cast<unsigned char>(s[i]));
+    return n;
+  }
+
+private:
+  // FNV-1a and a multiply-xorshift hash, for 128 bits in total.
+  void update(unsigned char c) {
+    fnv = (fnv ^ c) * 0x100000001b3ULL;
+    mix = (mix ^ c) * 0x9e3779b97f4a7c15ULL;
+    mix ^= mix >> 29;
+  }
+
+  uint64_t fnv = 0xcbf29ce484222325ULL;
+  uint64_t mix = 0;
+};
+} // namespace
+
+PrettyPrinterBase::ChunkHash
+PrettyPrinterBase::hashBlock(const gtirb::CodeBlock& x) {
+  HashingStreamBuf buf;
+  std::ostream hs(&buf);
+  const gtirb::Addr addr = *addressOf(x);
+  const gtirb::Addr end = addr + x.getSize();
+  auto relative = [addr](gtirb::Addr ea) {
+    return static_cast<uint64_t>(ea) - static_cast<uint64_t>(addr);
+  };
+
+  // The policy and the shape of the block, but not its address, so that
+  // blocks moved by an edit and the same code in other IRs match. Labels
+  // and alignments are hashed as printed below, and the text of blocks
+  // that print other addresses is only reused at the same address.
+  hs << policy.debug << policy.minimal << policy.passthrough
+     << policy.passthroughComments << policy.nopsDirective << policy.endbr64
+     << ' ' << x.getSize() << ' ' << isFunctionEntry(end) << skipEA(end)
+     << ' ' << (isFunctionEntry(end) ? getAlignment(end) : 0) << '\n';
+  hs.write(reinterpret_cast<const char*>(x.rawBytes<uint8_t>()), x.getSize());
+
+  // Everything printed from outside of the bytes, hashed as printed.
+  printFunctionHeader(hs, addr);
+  printFunctionFooter(hs, addr);
+  forEachSymbolIn(addr, end, [&](const gtirb::Symbol& symbol) {
+    gtirb::Addr ea = *addressOf(symbol);
+    hs << relative(ea) << ':';
+    printSymbolDefinitionsAtAddress(hs, ea);
+  });
+  hashSymbolicExpressions(hs, addr, end);
+  if (const auto* cfiDirectives =
+          module.getAuxData<gtirb::schema::CfiDirectives>()) {
+    for (auto it = cfiDirectives->lower_bound(gtirb::Offset(x.getUUID(), 0));
+         it != cfiDirectives->end() && it->first.ElementId == x.getUUID();
+         ++it) {
+      hs << it->first.Displacement << ':';
+      printCFIDirectives(hs, it->first);
+    }
+  }
+  printComments(hs, gtirb::Offset(x.getUUID(), 0), x.getSize() + 1);
+  return buf.digest();
+}
+
+void PrettyPrinterBase::hashSymbolicExpressions(std::ostream& hs,
+                                                gtirb::Addr begin,
+                                                gtirb::Addr end) {
+  forEachSymbolicExpressionIn(
+      begin, end,
+      [&](gtirb::Addr ea, const gtirb::SymbolicExpression& expr) {
+        hs << static_cast<uint64_t>(ea) - static_cast<uint64_t>(begin) << ' '
+           << expr.index() << ' ';
+        for (bool inData : {false, true}) {
+          if (const auto* s = std::get_if<gtirb::SymAddrConst>(&expr)) {
+            printSymbolicExpression(hs, s, inData);
+          } else if (const auto* sa = std::get_if<gtirb::SymAddrAddr>(&expr)) {
+            hs << sa->Scale << ' ' << sa->Offset << ' ';
+            printSymbolicExpression(hs, sa, inData);
+          }
+          hs << '\n';
+        }
+      });
+}
+
+void PrettyPrinterBase::hashDataBlock(std::ostream& hs,
+                                      const gtirb::DataBlock& x) {
+  const gtirb::Addr addr = *addressOf(x);
+  hs << "d " << skipEA(addr) << ' ';
+  if (const auto section = getContainerSection(addr))
+    hs << (*section)->getName() << ' '
+       << shouldExcludeDataElement(**section, x);
+  if (dataEncodings) {
+    auto found = dataEncodings->find(x.getUUID());
+    if (found != dataEncodings->end())
+      hs << ' ' << found->second;
+  }
+  hs << '\n';
+  for (uint8_t byte : x.bytes<uint8_t>())
+    hs.put(static_cast<char>(byte));
+  printSymbolDefinitionsAtAddress(hs, addr, true);
+  hashSymbolicExpressions(hs, addr, addr + x.getSize());
+  printComments(hs, gtirb::Offset(x.getUUID(), 0), x.getSize());
+}
+
+PrettyPrinterBase::ChunkHash
+PrettyPrinterBase::hashChunk(const std::vector<ModuleIndex::Block>& blocks,
+                             size_t begin, size_t end, gtirb::Addr last) {
+  HashingStreamBuf buf;
+  std::ostream hs(&buf);
+  const gtirb::Addr start = index->extentOf(blocks[begin]).first;
+  hs << policy.debug << policy.minimal << policy.passthrough
+     << policy.passthroughComments << policy.nopsDirective << policy.endbr64
+     << '\n';
+  // The shape of the chunk relative to its start, with what is printed
+  // between the blocks hashed as printed. For the first block, that
+  // depends on the end of the previous chunk.
+  for (size_t i = begin; i < end; ++i) {
+    auto [addr, size] = index->extentOf(blocks[i]);
+    hs << static_cast<uint64_t>(addr) - static_cast<uint64_t>(start) << ' '
+       << size << '\n';
+    if (addr < last) {
+      printOverlapWarning(hs, addr);
+    } else {
+      printBlockTransition(hs, addr, last);
+      last = addr + size;
+    }
+    if (const auto* code = std::get_if<const gtirb::CodeBlock*>(&blocks[i])) {
+      auto [fnv, mix] = hashBlock(**code);
+      hs << "c " << fnv << ' ' << mix << '\n';
+    } else {
+      hashDataBlock(hs, *std::get<const gtirb::DataBlock*>(blocks[i]));
+    }
+  }
+  hs.flush();
+  return buf.digest();
+}
+
+std::vector<PrettyPrinterBase::FunctionDigest>
+PrettyPrinterBase::getFunctionDigests() {
+  std::vector<FunctionDigest> functions;
+  for (gtirb::Addr begin : functionEntry) {
+    if (skipEA(begin))
+      continue;
+    gtirb::Addr end = getFunctionEnd(begin);
+    auto relative = [begin](gtirb::Addr addr) {
+      return static_cast<uint64_t>(addr) - static_cast<uint64_t>(begin);
+    };
+    HashingStreamBuf buf;
+    std::ostream hs(&buf);
+    hs << relative(end) << '\n';
+    // The code blocks and then the data blocks starting in the function.
+    auto [first, last] = index->findBlocksAt(begin, end);
+    for (bool code : {true, false}) {
+      for (size_t i = first; i < last; ++i) {
+        const ModuleIndex::Block& block = index->blocks[i];
+        if (std::holds_alternative<const gtirb::CodeBlock*>(block) != code)
+          continue;
+        std::visit(
+            [&](const auto* b) {
+              hs << (code ? "c " : "d ") << relative(*addressOf(*b)) << ' '
+                 << b->getSize() << '\n';
+              hs.write(reinterpret_cast<const char*>(
+                           b->template rawBytes<uint8_t>()),
+                       b->getSize());
+            },
+            block);
+      }
+    }
+    forEachSymbolIn(begin, end, [&](const gtirb::Symbol& symbol) {
+      hs << "s " << relative(*addressOf(symbol)) << ' ' << symbol.getName()
+         << '\n';
+    });
+    forEachSymbolicExpressionIn(
+        begin, end,
+        [&](gtirb::Addr ea, const gtirb::SymbolicExpression& expr) {
+          hs << "e " << relative(ea) << ' ';
+          if (const auto* s = std::get_if<gtirb::SymAddrConst>(&expr)) {
+            printSymbolicExpression(hs, s, false);
+          } else if (const auto* sa = std::get_if<gtirb::SymAddrAddr>(&expr)) {
+            hs << sa->Scale << ' ' << sa->Offset << ' ';
+            printSymbolicExpression(hs, sa, false);
+          }
+          hs << '\n';
+        });
+    hs.flush();
+    functions.push_back({getFunctionName(begin), begin, end, buf.digest()});
+  }
+  return functions;
+}
+
+void PrettyPrinterBase::noteAddressDependence(const cs_insn& inst) {
+  // Non-symbolic PC-relative operands are printed as absolute addresses.
+  gtirb::Addr ea(inst.address);
+  if (!policy.outputCacheFile.empty() && isPCRelative(inst) &&
+      !hasSymbolicExpressions(ea, ea + inst.size))
+    outputCacheAddressDependent = true;
+}
+
+// The output cache is a data file holding the texts of the chunks one after
+// the other, and an index file next to it with a record for each text.
+// Printers only read the index and map the data file; they append the
+// chunks they printed to both files under the lock, and only write new
+// files, without the chunks that were not printed, when the data file
+// would grow over the limit.
+namespace {
+struct OutputCacheRecord {
+  uint64_t key[2];
+  // The address of the chunk, or NoAddress if its text does not depend on
+  // it.
+  uint64_t address;
+  uint64_t offset;
+  uint64_t size;
+};
+constexpr uint64_t NoAddress = ~uint64_t{0};
+} // namespace
+
+static std::string outputCacheIndexPath(const std::string& path) {
+  return path + ".index";
+}
+
+// Return the size of the file at \p path, or nothing if it does not start
+// with \p header.
+static std::optional<uint64_t> cacheFileSize(const std::string& path,
+                                             const std::string& header) {
+  std::ifstream in(path, std::ios::in | std::ios::binary);
+  std::string found(header.size(), '\0');
+  if (!in.read(found.data(), found.size()) || found != header)
+    return std::nullopt;
+  in.seekg(0, std::ios::end);
+  return static_cast<uint64_t>(in.tellg());
+}
+
+void PrettyPrinterBase::loadOutputCache() {
+  namespace bip = boost::interprocess;
+  const std::string header = cacheFileHeader("output cache of chunks");
+  // Printers never rewrite the files in place, so the data file stays
+  // valid while it is mapped. The lock keeps the index consistent with it.
+  CacheFileLock lock(policy.outputCacheFile);
+  auto data = std::make_unique<MappedCacheFile>();
+  try {
+    bip::file_mapping file(policy.outputCacheFile.c_str(), bip::read_only);
+    data->region = bip::mapped_region(file, bip::read_only);
+  } catch (const bip::interprocess_exception&) {
+    // No cache yet; it is written once printing is done.
+    return;
+  }
+  const char* begin = static_cast<const char*>(data->region.get_address());
+  const uint64_t size = data->region.get_size();
+  if (size < header.size() ||
+      std::memcmp(begin, header.data(), header.size()) != 0)
+    return;
+
+  std::ifstream in(outputCacheIndexPath(policy.outputCacheFile),
+                   std::ios::in | std::ios::binary);
+  std::string indexHeader(header.size(), '\0');
+  if (!in.read(indexHeader.data(), indexHeader.size()) ||
+      indexHeader != header)
+    return;
+  OutputCacheRecord record;
+  while (in.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+    // Skip the texts that were not completely written.
+    if (record.offset < header.size() || record.offset > size ||
+        record.size > size - record.offset)
+      continue;
+    std::optional<gtirb::Addr> address;
+    if (record.address != NoAddress)
+      address = gtirb::Addr(record.address);
+    outputCache.emplace(
+        ChunkHash(record.key[0], record.key[1]),
+        OutputCacheEntry{std::string_view(begin + record.offset, record.size),
+                         address, false});
+  }
+  outputCacheData = std::move(data);
+}
+
+void PrettyPrinterBase::saveOutputCache() const {
+  const std::string& path = policy.outputCacheFile;
+  const std::string indexPath = outputCacheIndexPath(path);
+  const std::string header = cacheFileHeader("output cache of chunks");
+  CacheFileLock lock(path);
+
+  auto makeRecord = [](const ChunkHash& key,
+                       const std::optional<gtirb::Addr>& address,
+                       uint64_t offset, uint64_t size) {
+    return OutputCacheRecord{
+        {key.first, key.second},
+        address ? static_cast<uint64_t>(*address) : NoAddress,
+        offset,
+        size};
+  };
+  auto writeIndex = [](std::ostream& out,
+                       const std::vector<OutputCacheRecord>& records) {
+    out.write(reinterpret_cast<const char*>(records.data()),
+              records.size() * sizeof(OutputCacheRecord));
+  };
+
+  // Append the chunks printed in this run, if the files are from this
+  // version, the index is not truncated and the data stays below the limit.
+  uint64_t addedSize = 0;
+  for (const OutputCacheChunk& chunk : outputCacheAdded)
+    addedSize += chunk.text.size();
+  std::optional<uint64_t> dataSize = cacheFileSize(path, header);
+  std::optional<uint64_t> indexSize = cacheFileSize(indexPath, header);
+  if (dataSize && indexSize &&
+      (*indexSize - header.size()) % sizeof(OutputCacheRecord) == 0 &&
+      *dataSize + addedSize <= policy.outputCacheLimit) {
+    std::vector<OutputCacheRecord> records;
+    std::ofstream data(path, std::ios::out | std::ios::binary | std::ios::app);
+    uint64_t offset = *dataSize;
+    for (const OutputCacheChunk& chunk : outputCacheAdded) {
+      data.write(chunk.text.data(), chunk.text.size());
+      records.push_back(
+          makeRecord(chunk.key, chunk.address, offset, chunk.text.size()));
+      offset += chunk.text.size();
+    }
+    // The texts are written before they are indexed.
+    data.close();
+    std::ofstream index(indexPath,
+                        std::ios::out | std::ios::binary | std::ios::app);
+    if (data)
+      writeIndex(index, records);
+    if (!data || !index)
+      std::cerr << "WARNING: could not write the cache file " << path << '\n';
+    return;
+  }
+
+  // Otherwise write new files with the chunks printed in this run, then as
+  // many of the others as half the limit allows, so that the following
+  // runs append for a while. The old index is removed first, so that it is
+  // never used with the new data file.
+  std::remove(indexPath.c_str());
+  std::vector<OutputCacheRecord> records;
+  bool written = replaceCacheFile(path, [&](std::ostream& out) {
+    out << header;
+    uint64_t offset = header.size();
+    for (bool used : {true, false}) {
+      for (const auto& [key, entry] : outputCache) {
+        if (entry.used != used)
+          continue;
+        if (!used && offset + entry.text.size() > policy.outputCacheLimit / 2)
+          return;
+        out.write(entry.text.data(), entry.text.size());
+        records.push_back(
+            makeRecord(key, entry.address, offset, entry.text.size()));
+        offset += entry.text.size();
+      }
+    }
+  });
+  if (written)
+    replaceCacheFile(indexPath, [&](std::ostream& out) {
+      out << header;
+      writeIndex(out, records);
+    });
+}
+
+std::optional<std::string> hashIRFile(const std::string& path) {
+  std::ifstream in(path, std::ios::in | std::ios::binary);
+  if (!in)
+    return std::nullopt;
+  HashingStreamBuf buf;
+  std::vector<char> chunk(1 << 20);
+  while (in) {
+    in.read(chunk.data(), chunk.size());
+    buf.sputn(chunk.data(), in.gcount());
+  }
+  if (in.bad())
+    return std::nullopt;
+  auto [fnv, mix] = buf.digest();
+  std::ostringstream hash;
+  hash << std::hex << std::setfill('0') << std::setw(16) << fnv
+       << std::setw(16) << mix;
+  return hash.str();
+}
+
+namespace {
+// An input stream buffer over bytes in memory, read without copying them.
+class MemoryBuf : public std::streambuf {
+public:
+  MemoryBuf(const char* data, size_t size) {
+    char* p = const_cast<char*>(data);
+    setg(p, p, p + size);
+  }
+
+protected:
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                   std::ios_base::openmode which) override {
+    char* base = dir == std::ios_base::beg   ? eback()
+                 : dir == std::ios_base::cur ? gptr()
+                                             : egptr();
+    if (!(which & std::ios_base::in) || off < eback() - base ||
+        off > egptr() - base)
+      return pos_type(off_type(-1));
+    setg(eback(), base + off, egptr());
+    return pos_type(gptr() - eback());
+  }
+
+  pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+  }
+};
+} // namespace
+
+gtirb::IR* loadIR(gtirb::Context& context, const std::string& path) {
+  namespace bip = boost::interprocess;
+  std::optional<bip::mapped_region> region;
+  try {
+    bip::file_mapping file(path.c_str(), bip::read_only);
+    region.emplace(file, bip::read_only);
+  } catch (const bip::interprocess_exception&) {
+    // Empty files and pipes cannot be mapped.
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    return in ? gtirb::IR::load(context, in) : nullptr;
+  }
+  // The advice is only a hint, so failing to give it is not an error.
+  region->advise(bip::mapped_region::advice_sequential);
+  MemoryBuf buf(static_cast<const char*>(region->get_address()),
+                region->get_size());
+  std::istream in(&buf);
+  return gtirb::IR::load(context, in);
+}
+
+// The second line of a sidecar file: its key, and a hash of the addresses
+// of the byte intervals, since the module may have been laid out after it
+// was loaded.
+static std::string sidecarKeyLine(const PrintingPolicy& policy,
+                                  const gtirb::Module& module) {
+  HashingStreamBuf buf;
+  std::ostream hs(&buf);
+  for (const gtirb::ByteInterval& interval : module.byte_intervals()) {
+    hs << interval.getUUID() << ' ' << interval.getSize() << ' ';
+    if (std::optional<gtirb::Addr> addr = interval.getAddress())
+      hs << static_cast<uint64_t>(*addr);
+    hs << '\n';
+  }
+  hs.flush();
+  auto [fnv, mix] = buf.digest();
+  std::ostringstream line;
+  line << policy.sidecarKey << ' ' << std::hex << fnv << mix << '\n';
+  return line.str();
+}
+
+std::string PrettyPrinterBase::sidecarPath() const {
+  return policy.sidecarDir + "/" + policy.sidecarKey + "-" +
+         boost::uuids::to_string(module.getUUID()) + ".sidecar";
+}
+
+std::unique_ptr<const PrettyPrinterBase::Sidecar>
+PrettyPrinterBase::mapSidecar(cs_arch arch, bool resolveIndex) const {
+  namespace bip = boost::interprocess;
+  const std::string header =
+      cacheFileHeader("sidecar") + sidecarKeyLine(policy, module);
+  auto result = std::make_unique<Sidecar>();
+  try {
+    bip::file_mapping file(sidecarPath().c_str(), bip::read_only);
+    result->region = bip::mapped_region(file, bip::read_only);
+  } catch (const bip::interprocess_exception&) {
+    return nullptr;
+  }
+  const char* pos = static_cast<const char*>(result->region.get_address());
+  const char* end = pos + result->region.get_size();
+  if (result->region.get_size() < header.size() ||
+      std::memcmp(pos, header.data(), header.size()) != 0)
+    return nullptr;
+  pos += header.size();
+
+  // Read a 64-bit count, and then count items of itemSize bytes. Return
+  // false if the file is truncated.
+  auto readCount = [&](uint64_t& count) {
+    if (static_cast<uint64_t>(end - pos) < sizeof(count))
+      return false;
+    std::memcpy(&count, pos, sizeof(count));
+    pos += sizeof(count);
+    return true;
+  };
+  auto readItems = [&](uint64_t itemSize, uint64_t& count,
+                       const char*& items) {
+    if (!readCount(count) ||
+        count > static_cast<uint64_t>(end - pos) / itemSize)
+      return false;
+    items = pos;
+    pos += count * itemSize;
+    return true;
+  };
+  constexpr uint64_t BlockSize = sizeof(gtirb::UUID) + 1;
+  const uint64_t recordSize = sizeof(cs_insn) + instructionDetailSize(arch);
+  Sidecar& s = *result;
+  if (!readItems(sizeof(uint64_t), s.functionEntryCount, s.functionEntry) ||
+      !readItems(sizeof(uint64_t), s.functionLastBlockCount,
+                 s.functionLastBlock) ||
+      !readItems(BlockSize, s.blockCount, s.blocks) ||
+      !readCount(s.recordSize) || s.recordSize != recordSize ||
+      !readItems(recordSize, s.recordCount, s.records) || pos != end)
+    return nullptr;
+  if (!resolveIndex)
+    return result;
+
+  auto index = std::make_shared<ModuleIndex>();
+  if (!index->indexAddresses(module))
+    return nullptr;
+  auto readAddrs = [](const char* items, uint64_t count) {
+    std::vector<gtirb::Addr> addrs(count);
+    for (uint64_t i = 0; i < count; ++i) {
+      uint64_t addr;
+      std::memcpy(&addr, items + i * sizeof(addr), sizeof(addr));
+      addrs[i] = gtirb::Addr(addr);
+    }
+    return addrs;
+  };
+  index->functionEntry = readAddrs(s.functionEntry, s.functionEntryCount);
+  index->functionLastBlock =
+      readAddrs(s.functionLastBlock, s.functionLastBlockCount);
+  index->blocks.reserve(s.blockCount);
+  for (uint64_t i = 0; i < s.blockCount; ++i) {
+    const char* block = s.blocks + i * BlockSize;
+    gtirb::UUID uuid;
+    std::memcpy(uuid.data, block, sizeof(uuid.data));
+    if (block[sizeof(uuid.data)] == 'c') {
+      const auto* code = nodeFromUUID<gtirb::CodeBlock>(context, uuid);
+      if (!code)
+        return nullptr;
+      index->blocks.emplace_back(code);
+    } else {
+      const auto* data = nodeFromUUID<gtirb::DataBlock>(context, uuid);
+      if (!data)
+        return nullptr;
+      index->blocks.emplace_back(data);
+    }
+  }
+  s.index = std::move(index);
+  return result;
+}
+
+// The address of a sidecar record.
+static uint64_t sidecarRecordAddress(const char* record) {
+  uint64_t address;
+  std::memcpy(&address, record + offsetof(cs_insn, address), sizeof(address));
+  return address;
+}
+
+bool PrettyPrinterBase::findSidecarInstruction(const uint8_t* bytes,
+                                               uint64_t size, uint64_t address,
+                                               cs_insn& inst) const {
+  if (!sidecar || sidecar->recordCount == 0 || !inst.detail)
+    return false;
+  const uint64_t recordSize = sidecar->recordSize;
+  uint64_t low = 0;
+  uint64_t high = sidecar->recordCount;
+  while (low < high) {
+    uint64_t mid = low + (high - low) / 2;
+    if (sidecarRecordAddress(sidecar->records + mid * recordSize) < address)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  if (low == sidecar->recordCount)
+    return false;
+  const char* record = sidecar->records + low * recordSize;
+  if (sidecarRecordAddress(record) != address)
+    return false;
+
+  // The bytes are compared as well, so that an instruction is never taken
+  // from a sidecar that does not match the module.
+  cs_insn found;
+  std::memcpy(&found, record, sizeof(found));
+  if (found.size == 0 || found.size > size ||
+      std::memcmp(found.bytes, bytes, found.size) != 0)
+    return false;
+  cs_detail* detail = inst.detail;
+  inst = found;
+  inst.detail = detail;
+  std::memcpy(detail, record + sizeof(cs_insn), recordSize - sizeof(cs_insn));
+  return true;
+}
+
+void PrettyPrinterBase::addSidecarInstruction(const cs_insn& inst) {
+  if (policy.sidecarDir.empty() || !inst.detail)
+    return;
+  const size_t detailSize = instructionDetailSize(csArch);
+  const size_t at = sidecarAdded.size();
+  sidecarAdded.resize(at + sizeof(cs_insn) + detailSize);
+  cs_insn record = inst;
+  record.detail = nullptr;
+  std::memcpy(&sidecarAdded[at], &record, sizeof(record));
+  std::memcpy(&sidecarAdded[at + sizeof(record)], inst.detail, detailSize);
+}
+
+void PrettyPrinterBase::saveSidecar() const {
+  const std::string path = sidecarPath();
+  const uint64_t recordSize = sizeof(cs_insn) + instructionDetailSize(csArch);
+  CacheFileLock lock(path);
+
+  // Merge the instructions decoded here with the ones in the file, which
+  // other printers of the module, e.g. other shards, may have saved since
+  // this one was created.
+  std::unique_ptr<const Sidecar> saved = mapSidecar(csArch, false);
+  std::vector<const char*> records;
+  if (saved)
+    for (uint64_t i = 0; i < saved->recordCount; ++i)
+      records.push_back(saved->records + i * recordSize);
+  for (size_t at = 0; at < sidecarAdded.size(); at += recordSize)
+    records.push_back(&sidecarAdded[at]);
+  auto byAddress = [](const char* a, const char* b) {
+    return sidecarRecordAddress(a) < sidecarRecordAddress(b);
+  };
+  std::stable_sort(records.begin(), records.end(), byAddress);
+  records.erase(std::unique(records.begin(), records.end(),
+                            [](const char* a, const char* b) {
+                              return sidecarRecordAddress(a) ==
+                                     sidecarRecordAddress(b);
+                            }),
+                records.end());
+
+  replaceCacheFile(path, [&](std::ostream& out) {
+    auto writeCount = [&out](uint64_t count) {
+      out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    };
+    out << cacheFileHeader("sidecar") << sidecarKeyLine(policy, module);
+    for (const auto* addrs : {&functionEntry, &functionLastBlock}) {
+      writeCount(addrs->size());
+      for (gtirb::Addr addr : *addrs) {
+        uint64_t value = static_cast<uint64_t>(addr);
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+      }
+    }
+    writeCount(index->blocks.size());
+    for (const ModuleIndex::Block& block : index->blocks) {
+      if (const auto* code = std::get_if<const gtirb::CodeBlock*>(&block)) {
+        out.write(reinterpret_cast<const char*>((*code)->getUUID().data),
+                  sizeof(gtirb::UUID));
+        out.put('c');
+      } else {
+        const gtirb::DataBlock* data = std::get<const gtirb::DataBlock*>(block);
+        out.write(reinterpret_cast<const char*>(data->getUUID().data),
+                  sizeof(gtirb::UUID));
+        out.put('d');
+      }
+    }
+    writeCount(recordSize);
+    writeCount(records.size());
+    for (const char* record : records)
+      out.write(record, recordSize);
+  });
+}
+
+const std::string& PrettyPrinterBase::indent() const {
+  static const std::string none;
+  return policy.minimal ? none : syntax.tab();
+}
+
 void PrettyPrinterBase::printEA(std::ostream& os, gtirb::Addr ea) {
-  os << syntax.tab();
+  if (sourcePosition)
+    addSourceMapEntry(ea);
+  os << indent();
   if (this->debug) {
     os << std::hex << static_cast<uint64_t>(ea) << ": " << std::dec;
   }
+  // Instructions are indented further than data directives.
+  if (!policy.minimal)
+    os << "  ";
 }
 
 void PrettyPrinterBase::printOperandList(std::ostream& os,
@@ -524,19 +3025,13 @@ void PrettyPrinterBase::printOperand(std::ostream& os, const cs_insn& inst,
   case X86_OP_REG:
     printOpRegdirect(os, inst, op.reg);
     return;
-  case X86_OP_IMM: {
-    auto found = module.findSymbolicExpressionsAt(ea + immOffset);
-    if (!found.empty())
-      symbolic = &found.begin()->getSymbolicExpression();
-  }
+  case X86_OP_IMM:
+    symbolic = findSymbolicExpression(ea + immOffset);
     printOpImmediate(os, symbolic, inst, index);
     return;
   case X86_OP_MEM:
-    if (dispOffset > 0) {
-      auto found = module.findSymbolicExpressionsAt(ea + dispOffset);
-      if (!found.empty())
-        symbolic = &found.begin()->getSymbolicExpression();
-    }
+    if (dispOffset > 0)
+      symbolic = findSymbolicExpression(ea + dispOffset);
     printOpIndirect(os, symbolic, inst, index);
     return;
   case X86_OP_INVALID:
@@ -547,10 +3042,14 @@ void PrettyPrinterBase::printOperand(std::ostream& os, const cs_insn& inst,
 
 void PrettyPrinterBase::printDataBlock(std::ostream& os,
                                        const gtirb::DataBlock& dataObject) {
-  gtirb::Addr addr = *dataObject.getAddress();
+  gtirb::Addr addr = *addressOf(dataObject);
   if (skipEA(addr)) {
     return;
   }
+  if (sourcePosition) {
+    beginSourceBlock(dataObject.getUUID(), addr);
+    addSourceMapEntry(addr);
+  }
   printComments(os, gtirb::Offset(dataObject.getUUID(), 0),
                 dataObject.getSize());
   printSymbolDefinitionsAtAddress(os, addr, true);
@@ -561,12 +3060,10 @@ void PrettyPrinterBase::printDataBlock(std::ostream& os,
   if (shouldExcludeDataElement(**section, dataObject))
     return;
 
-  const auto& foundSymbolic =
-      module.findSymbolicExpressionsAt(*dataObject.getAddress());
   auto dataObjectBytes = dataObject.bytes<uint8_t>();
   if (std::all_of(dataObjectBytes.begin(), dataObjectBytes.end(),
                   [](uint8_t x) { return x == 0; }) &&
-      foundSymbolic.empty())
+      !findSymbolicExpression(addr))
     printZeroDataBlock(os, dataObject);
   else
     printNonZeroDataBlock(os, dataObject);
@@ -574,34 +3071,101 @@ void PrettyPrinterBase::printDataBlock(std::ostream& os,
 
 void PrettyPrinterBase::printNonZeroDataBlock(
     std::ostream& os, const gtirb::DataBlock& dataObject) {
-  const auto& foundSymbolic =
-      module.findSymbolicExpressionsAt(*dataObject.getAddress());
-  if (!foundSymbolic.empty()) {
-    os << syntax.tab();
-    printSymbolicData(os, &foundSymbolic.begin()->getSymbolicExpression(),
-                      dataObject);
+  const gtirb::Addr addr = *addressOf(dataObject);
+  if (const gtirb::SymbolicExpression* expr = findSymbolicExpression(addr)) {
+    os << indent();
+    printSymbolicData(os, expr, dataObject);
+    // Leave the directive open so that the following data objects of the
+    // same width can be appended to it.
+    uint64_t size = dataObject.getSize();
+    if (!this->debug && !hasDataEncoding(dataObject) &&
+        (size == 1 || size == 2 || size == 4 || size == 8)) {
+      symbolicDataRun = {addr + size, size};
+      return;
+    }
     os << '\n';
     return;
   }
-  const auto* types = module.getAuxData<gtirb::schema::Encodings>();
-  if (types) {
-    auto foundType = types->find(dataObject.getUUID());
-    if (foundType != types->end() && foundType->second == "string") {
-      os << syntax.tab();
+  if (dataEncodings) {
+    auto foundType = dataEncodings->find(dataObject.getUUID());
+    if (foundType != dataEncodings->end() && foundType->second == "string") {
+      os << indent();
       printString(os, dataObject);
       os << '\n';
       return;
     }
   }
+  if (!policy.incbinFile.empty() &&
+      dataObject.getSize() >= policy.incbinThreshold) {
+    printIncbinData(os, dataObject);
+    return;
+  }
   for (auto byte : dataObject.bytes<uint8_t>()) {
-    os << syntax.tab();
+    os << indent();
     printByte(os, static_cast<std::byte>(static_cast<unsigned char>(byte)));
   }
 }
 
+void PrettyPrinterBase::printIncbinData(std::ostream& os,
+                                        const gtirb::DataBlock& dataObject) {
+  const gtirb::Addr begin = *addressOf(dataObject);
+  const gtirb::Addr end = begin + dataObject.getSize();
+  const uint8_t* bytes = dataObject.rawBytes<uint8_t>();
+
+  // Find the spans inside the object that cannot be included verbatim.
+  // Symbolic expressions have no size, so a full word is kept around them.
+  std::map<gtirb::Addr, gtirb::Addr> cuts;
+  forEachSymbolIn(begin + 1, end, [&](const gtirb::Symbol& symbol) {
+    gtirb::Addr addr = *addressOf(symbol);
+    cuts.emplace(addr, addr);
+  });
+  forEachSymbolicExpressionIn(
+      begin, end, [&](gtirb::Addr addr, const gtirb::SymbolicExpression&) {
+        gtirb::Addr& cutEnd = cuts[addr];
+        cutEnd = std::max(cutEnd, std::min(addr + 8, end));
+      });
+
+  // Keep the spans disjoint so that every label is printed.
+  for (auto it = cuts.begin(); it != cuts.end(); ++it) {
+    auto next = std::next(it);
+    if (next != cuts.end())
+      it->second = std::min(it->second, next->first);
+  }
+
+  auto printBytes = [&](gtirb::Addr from, gtirb::Addr to, bool verbatim) {
+    const uint8_t* first =
+        bytes + (static_cast<uint64_t>(from) - static_cast<uint64_t>(begin));
+    const uint64_t size =
+        static_cast<uint64_t>(to) - static_cast<uint64_t>(from);
+    if (size == 0)
+      return;
+    if (verbatim && size >= policy.incbinThreshold && incbinStream) {
+      incbinStream.write(reinterpret_cast<const char*>(first), size);
+      os << indent() << syntax.incbin() << ' ' << incbinQuotedPath << ", "
+         << incbinOffset << ", " << size << '\n';
+      incbinOffset += size;
+      return;
+    }
+    for (const uint8_t* b = first; b != first + size; ++b) {
+      os << indent();
+      printByte(os, static_cast<std::byte>(*b));
+    }
+  };
+
+  gtirb::Addr pos = begin;
+  for (const auto& [cutBegin, cutEnd] : cuts) {
+    printBytes(pos, cutBegin, true);
+    if (cutBegin != begin)
+      printSymbolDefinitionsAtAddress(os, cutBegin, true);
+    printBytes(cutBegin, cutEnd, false);
+    pos = cutEnd;
+  }
+  printBytes(pos, end, true);
+}
+
 void PrettyPrinterBase::printZeroDataBlock(std::ostream& os,
                                            const gtirb::DataBlock& dataObject) {
-  os << syntax.tab();
+  os << indent();
   os << " .zero " << dataObject.getSize() << '\n';
 }
 
@@ -623,6 +3187,11 @@ void PrettyPrinterBase::printComments(std::ostream& os,
   }
 }
 
+bool PrettyPrinterBase::hasCFIDirectives(const gtirb::Offset& offset) const {
+  const auto* cfiDirectives = module.getAuxData<gtirb::schema::CfiDirectives>();
+  return cfiDirectives && cfiDirectives->count(offset) > 0;
+}
+
 void PrettyPrinterBase::printCFIDirectives(std::ostream& os,
                                            const gtirb::Offset& offset) {
   const auto* cfiDirectives = module.getAuxData<gtirb::schema::CfiDirectives>();
@@ -658,6 +3227,11 @@ void PrettyPrinterBase::printSymbolicData(
     const gtirb::DataBlock& dataObject) {
   printDataBlockType(os, dataObject);
   os << " ";
+  printSymbolicDataValue(os, symbolic);
+}
+
+void PrettyPrinterBase::printSymbolicDataValue(
+    std::ostream& os, const gtirb::SymbolicExpression* symbolic) {
   if (const auto* s = std::get_if<gtirb::SymAddrConst>(symbolic)) {
     printSymbolicExpression(os, s, true);
   } else if (const auto* sa = std::get_if<gtirb::SymAddrAddr>(symbolic)) {
@@ -665,12 +3239,43 @@ void PrettyPrinterBase::printSymbolicData(
   }
 }
 
+bool PrettyPrinterBase::hasDataEncoding(
+    const gtirb::DataBlock& dataObject) const {
+  return dataEncodings && dataEncodings->count(dataObject.getUUID()) > 0;
+}
+
+bool PrettyPrinterBase::continuesSymbolicDataRun(
+    const gtirb::DataBlock& dataObject) const {
+  if (!symbolicDataRun)
+    return false;
+  gtirb::Addr addr = *addressOf(dataObject);
+  if (addr != symbolicDataRun->end ||
+      dataObject.getSize() != symbolicDataRun->size ||
+      hasDataEncoding(dataObject))
+    return false;
+  // Labels and section boundaries have to be printed between directives.
+  if (hasSymbolsAt(addr) || index->findSectionAt(addr))
+    return false;
+  if (skipEA(addr))
+    return false;
+  const auto section = getContainerSection(addr);
+  if (!section || shouldExcludeDataElement(**section, dataObject))
+    return false;
+  return findSymbolicExpression(addr) != nullptr;
+}
+
+void PrettyPrinterBase::endSymbolicDataRun(std::ostream& os) {
+  if (symbolicDataRun) {
+    os << '\n';
+    symbolicDataRun.reset();
+  }
+}
+
 void PrettyPrinterBase::printDataBlockType(std::ostream& os,
                                            const gtirb::DataBlock& dataObject) {
-  const auto* types = module.getAuxData<gtirb::schema::Encodings>();
-  if (types) {
-    auto foundType = types->find(dataObject.getUUID());
-    if (foundType != types->end()) {
+  if (dataEncodings) {
+    auto foundType = dataEncodings->find(dataObject.getUUID());
+    if (foundType != dataEncodings->end()) {
       os << "." << foundType->second;
       return;
     }
@@ -755,23 +3360,29 @@ bool PrettyPrinterBase::isInSkippedSection(const gtirb::Addr addr) const {
 }
 
 bool PrettyPrinterBase::isInSkippedFunction(const gtirb::Addr x) const {
-  std::optional<std::string> xFunctionName = getContainerFunctionName(x);
-  if (!xFunctionName)
+  auto it = std::upper_bound(functionEntry.begin(), functionEntry.end(), x);
+  if (it == functionEntry.begin())
     return false;
-  return policy.skipFunctions.count(*xFunctionName);
+  size_t index = std::distance(functionEntry.begin(), it) - 1;
+  std::optional<bool>& skipped = functionSkipped[index];
+  if (!skipped)
+    skipped = policy.skipFunctions.count(
+                  this->getFunctionName(functionEntry[index])) > 0;
+  return *skipped;
 }
 
 bool PrettyPrinterBase::isFunctionEntry(const gtirb::Addr x) const {
-  return functionEntry.count(x) > 0;
+  return std::binary_search(functionEntry.begin(), functionEntry.end(), x);
 }
 
 bool PrettyPrinterBase::isFunctionLastBlock(const gtirb::Addr x) const {
-  return functionLastBlock.count(x) > 0;
+  return std::binary_search(functionLastBlock.begin(), functionLastBlock.end(),
+                            x);
 }
 
 std::optional<std::string>
 PrettyPrinterBase::getContainerFunctionName(const gtirb::Addr x) const {
-  auto it = functionEntry.upper_bound(x);
+  auto it = std::upper_bound(functionEntry.begin(), functionEntry.end(), x);
   if (it == functionEntry.begin())
     return std::nullopt;
   it--;
@@ -780,11 +3391,9 @@ PrettyPrinterBase::getContainerFunctionName(const gtirb::Addr x) const {
 
 const std::optional<const gtirb::Section*>
 PrettyPrinterBase::getContainerSection(const gtirb::Addr addr) const {
-  auto found_sections = module.findSectionsOn(addr);
-  if (found_sections.begin() == found_sections.end())
-    return std::nullopt;
-  else
-    return &*found_sections.begin();
+  if (const gtirb::Section* section = index->findSectionOn(addr))
+    return section;
+  return std::nullopt;
 }
 
 std::string PrettyPrinterBase::getRegisterName(unsigned int reg) const {
@@ -792,6 +3401,15 @@ std::string PrettyPrinterBase::getRegisterName(unsigned int reg) const {
       reg == X86_REG_INVALID ? "" : cs_reg_name(this->csHandle, reg));
 }
 
+const std::string& PrettyPrinterBase::registerName(unsigned int reg) const {
+  if (reg >= registerNames.size())
+    registerNames.resize(reg + 1);
+  std::optional<std::string>& name = registerNames[reg];
+  if (!name)
+    name = getRegisterName(reg);
+  return *name;
+}
+
 void PrettyPrinterBase::printAddend(std::ostream& os, int64_t number,
                                     bool first) {
   if (number < 0 || first) {
@@ -804,24 +3422,19 @@ void PrettyPrinterBase::printAddend(std::ostream& os, int64_t number,
 }
 
 void PrettyPrinterBase::printAlignment(std::ostream& os, gtirb::Addr addr) {
+  uint64_t alignment = getAlignment(addr);
+  if (alignment > 1)
+    os << syntax.align() << ' ' << alignment << '\n';
+}
+
+uint64_t PrettyPrinterBase::getAlignment(gtirb::Addr addr) const {
   // Enforce maximum alignment
   uint64_t x{addr};
-  if (x % 16 == 0) {
-    os << syntax.align() << " 16\n";
-    return;
-  }
-  if (x % 8 == 0) {
-    os << syntax.align() << " 8\n";
-    return;
-  }
-  if (x % 4 == 0) {
-    os << syntax.align() << " 4\n";
-    return;
-  }
-  if (x % 2 == 0) {
-    os << syntax.align() << " 2\n";
-    return;
+  for (uint64_t alignment : {16, 8, 4, 2}) {
+    if (x % alignment == 0)
+      return alignment;
   }
+  return 1;
 }
 
 std::string PrettyPrinterBase::getFunctionName(gtirb::Addr x) const {
@@ -829,9 +3442,8 @@ std::string PrettyPrinterBase::getFunctionName(gtirb::Addr x) const {
   bool entry_point = isFunctionEntry(x);
 
   if (entry_point) {
-    const auto symbols = module.findSymbols(x);
-    if (!symbols.empty()) {
-      const gtirb::Symbol& s = symbols.front();
+    if (const gtirb::Symbol* symbol = findFirstSymbolAt(x)) {
+      const gtirb::Symbol& s = *symbol;
       std::stringstream name(s.getName());
       if (isAmbiguousSymbol(s.getName())) {
         name.seekp(0, std::ios_base::end);
@@ -852,15 +3464,14 @@ std::string PrettyPrinterBase::getFunctionName(gtirb::Addr x) const {
   return std::string{};
 }
 
-std::string PrettyPrinterBase::getSymbolName(gtirb::Addr x) const {
-  std::stringstream ss;
-  ss << ".L_" << std::hex << uint64_t(x) << std::dec;
-  return ss.str();
+void PrettyPrinterBase::printSymbolName(std::ostream& os,
+                                        gtirb::Addr x) const {
+  os << ".L_" << std::hex << uint64_t(x) << std::dec;
 }
 
-std::optional<std::string>
-PrettyPrinterBase::getForwardedSymbolName(const gtirb::Symbol* symbol,
-                                          bool inData) const {
+bool PrettyPrinterBase::printForwardedSymbolName(std::ostream& os,
+                                                 const gtirb::Symbol* symbol,
+                                                 bool inData) const {
   const auto* symbolForwarding =
       module.getAuxData<gtirb::schema::SymbolForwarding>();
 
@@ -868,28 +3479,28 @@ PrettyPrinterBase::getForwardedSymbolName(const gtirb::Symbol* symbol,
     auto found = symbolForwarding->find(symbol->getUUID());
     if (found != symbolForwarding->end()) {
       gtirb::Node* destSymbol = gtirb::Node::getByUUID(context, found->second);
-      return (cast<gtirb::Symbol>(destSymbol))->getName() +
-             getForwardedSymbolEnding(symbol, inData);
+      os << (cast<gtirb::Symbol>(destSymbol))->getName()
+         << getForwardedSymbolEnding(symbol, inData);
+      return true;
     }
   }
-  return {};
+  return false;
 }
 
-std::string
+const char*
 PrettyPrinterBase::getForwardedSymbolEnding(const gtirb::Symbol* symbol,
                                             bool inData) const {
-  if (symbol->getAddress()) {
-    gtirb::Addr addr = *symbol->getAddress();
-    const auto container_sections = module.findSectionsOn(addr);
-    if (container_sections.begin() == container_sections.end())
-      return std::string{};
-    std::string section_name = container_sections.begin()->getName();
+  if (std::optional<gtirb::Addr> addr = addressOf(*symbol)) {
+    const gtirb::Section* section = index->findSectionOn(*addr);
+    if (!section)
+      return "";
+    const std::string& section_name = section->getName();
     if (!inData && (section_name == ".plt" || section_name == ".plt.got"))
-      return std::string{"@PLT"};
+      return "@PLT";
     if (section_name == ".got" || section_name == ".got.plt")
-      return std::string{"@GOTPCREL"};
+      return "@GOTPCREL";
   }
-  return std::string{};
+  return "";
 }
 
 bool PrettyPrinterBase::isAmbiguousSymbol(const std::string& name) const {
@@ -0,0 +1,178 @@
+//===- SourceMap.cpp --------------------------------------------*- C++ -*-===//
+//
+//  Copyright (C) 2020 GrammaTech, Inc.
+//
+//  This code is licensed under the MIT license. See the LICENSE file in the
+//  project root for license terms.
+//
+//  This project is sponsored by the Office of Naval Research, One Liberty
+//  Center, 875 N. Randolph Street, Arlington, VA 22203 under contract #
+//  N68335-17-C-0700.  The content of the information does not necessarily
+//  reflect the position or policy of the Government and no official
+//  endorsement should be inferred.
+//
+//===----------------------------------------------------------------------===//
+#include "SourceMap.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+
+namespace gtirb_pprint {
+
+static const char SourceMapMagic[] = "GTSMAP01";
+
+template <typename T> static void writeInt(std::ostream& os, T value) {
+  char bytes[sizeof(T)];
+  for (size_t i = 0; i < sizeof(T); ++i)
+    bytes[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+  os.write(bytes, sizeof(T));
+}
+
+template <typename T> static bool readInt(std::istream& is, T& value) {
+  unsigned char bytes[sizeof(T)];
+  if (!is.read(reinterpret_cast<char*>(bytes), sizeof(T)))
+    return false;
+  value = 0;
+  for (size_t i = 0; i < sizeof(T); ++i)
+    value |= static_cast<T>(bytes[i]) << (8 * i);
+  return true;
+}
+
+bool SourceMap::save(const std::string& path) const {
+  std::vector<uint32_t> index(entries.size());
+  std::iota(index.begin(), index.end(), 0);
+  // Entries are in output order, so a stable sort keeps the first printed
+  // entry of each address first.
+  std::stable_sort(index.begin(), index.end(), [this](uint32_t a, uint32_t b) {
+    return entries[a].address < entries[b].address;
+  });
+
+  std::ofstream os(path, std::ios::out | std::ios::binary);
+  os.write(SourceMapMagic, sizeof(SourceMapMagic) - 1);
+  writeInt(os, static_cast<uint32_t>(functions.size()));
+  for (const std::string& name : functions) {
+    writeInt(os, static_cast<uint32_t>(name.size()));
+    os.write(name.data(), name.size());
+  }
+  writeInt(os, static_cast<uint64_t>(entries.size()));
+  for (const Entry& entry : entries) {
+    writeInt(os, entry.offset);
+    writeInt(os, entry.line);
+    writeInt(os, entry.address);
+    os.write(reinterpret_cast<const char*>(entry.block.data), 16);
+    writeInt(os, entry.function);
+  }
+  for (uint32_t i : index)
+    writeInt(os, i);
+  return static_cast<bool>(os);
+}
+
+std::optional<SourceMap> SourceMap::load(const std::string& path) {
+  std::ifstream is(path, std::ios::in | std::ios::binary);
+  char magic[sizeof(SourceMapMagic) - 1];
+  if (!is.read(magic, sizeof(magic)) ||
+      std::memcmp(magic, SourceMapMagic, sizeof(magic)) != 0)
+    return std::nullopt;
+
+  SourceMap map;
+  uint32_t functionCount;
+  if (!readInt(is, functionCount))
+    return std::nullopt;
+  for (uint32_t i = 0; i < functionCount; ++i) {
+    uint32_t size;
+    if (!readInt(is, size))
+      return std::nullopt;
+    std::string& name = map.functions.emplace_back(size, '\0');
+    if (!is.read(name.data(), size))
+      return std::nullopt;
+  }
+  uint64_t entryCount;
+  if (!readInt(is, entryCount))
+    return std::nullopt;
+  map.entries.resize(entryCount);
+  for (Entry& entry : map.entries) {
+    if (!readInt(is, entry.offset) || !readInt(is, entry.line) ||
+        !readInt(is, entry.address) ||
+        !is.read(reinterpret_cast<char*>(entry.block.data), 16) ||
+        !readInt(is, entry.function))
+      return std::nullopt;
+  }
+  map.byAddress.resize(entryCount);
+  for (uint32_t& i : map.byAddress) {
+    if (!readInt(is, i) || i >= entryCount)
+      return std::nullopt;
+  }
+  return map;
+}
+
+const SourceMap::Entry* SourceMap::findByOffset(uint64_t offset) const {
+  auto it = std::upper_bound(
+      entries.begin(), entries.end(), offset,
+      [](uint64_t o, const Entry& entry) { return o < entry.offset; });
+  return it == entries.begin() ? nullptr : &*std::prev(it);
+}
+
+const SourceMap::Entry* SourceMap::findByLine(uint64_t line) const {
+  auto it = std::lower_bound(
+      entries.begin(), entries.end(), line,
+      [](const Entry& entry, uint64_t l) { return entry.line < l; });
+  if (it != entries.end() && it->line == line)
+    return &*it;
+  return it == entries.begin() ? nullptr : &*std::prev(it);
+}
+
+const SourceMap::Entry* SourceMap::findByAddress(uint64_t address) const {
+  auto it = std::upper_bound(byAddress.begin(), byAddress.end(), address,
+                             [this](uint64_t a, uint32_t i) {
+                               return a < entries[i].address;
+                             });
+  if (it == byAddress.begin())
+    return nullptr;
+  uint64_t found = entries[*std::prev(it)].address;
+  it = std::lower_bound(byAddress.begin(), it, found,
+                        [this](uint32_t i, uint64_t a) {
+                          return entries[i].address < a;
+                        });
+  return &entries[*it];
+}
+
+OutputPosition::OutputPosition(std::streambuf* target_)
+    : target(target_), scanned(buffer) {
+  setp(buffer, buffer + sizeof(buffer));
+}
+
+OutputPosition::~OutputPosition() { flush(); }
+
+uint64_t OutputPosition::line() {
+  lines += std::count(scanned, static_cast<const char*>(pptr()), '\n');
+  scanned = pptr();
+  return lines;
+}
+
+OutputPosition::int_type OutputPosition::overflow(int_type c) {
+  if (!flush())
+    return traits_type::eof();
+  if (!traits_type::eq_int_type(c, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+int OutputPosition::sync() { return flush() ? target->pubsync() : -1; }
+
+bool OutputPosition::flush() {
+  line();
+  std::streamsize size = pptr() - pbase();
+  if (target->sputn(pbase(), size) != size)
+    return false;
+  flushed += size;
+  setp(buffer, buffer + sizeof(buffer));
+  scanned = buffer;
+  return true;
+}
+
+} // namespace gtirb_pprint
@@ -48,16 +48,25 @@ std::string Syntax::formatSymbolName(const std::string& x) const {
   return avoidRegNameConflicts(x);
 }
 
-std::string Syntax::avoidRegNameConflicts(const std::string& x) const {
-  const std::vector<std::string> adapt{"FS",  "MOD", "DIV", "NOT", "mod", "div",
-                                       "not", "and", "or",  "shr", "Si"};
+// Whether a symbol name would be read as a register or an operator.
+static bool conflictsWithRegName(const std::string& x) {
+  static const std::vector<std::string> adapt{
+      "FS", "MOD", "DIV", "NOT", "mod", "div", "not", "and", "or", "shr", "Si"};
+
+  return std::find(std::begin(adapt), std::end(adapt), x) != std::end(adapt);
+}
 
-  if (const auto found = std::find(std::begin(adapt), std::end(adapt), x);
-      found != std::end(adapt)) {
+std::string Syntax::avoidRegNameConflicts(const std::string& x) const {
+  if (conflictsWithRegName(x))
     return x + "_renamed";
-  }
 
   return x;
 }
 
+void Syntax::printSymbolName(std::ostream& os, const std::string& x) const {
+  os << x;
+  if (conflictsWithRegName(x))
+    os << "_renamed";
+}
+
 } // namespace gtirb_pprint
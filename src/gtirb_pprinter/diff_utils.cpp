@@ -0,0 +1,144 @@
+//===- diff_utils.cpp -------------------------------------------*- C++ -*-===//
+//
+//  Copyright (C) 2020 GrammaTech, Inc.
+//
+//  This code is licensed under the MIT license. See the LICENSE file in the
+//  project root for license terms.
+//
+//  This project is sponsored by the Office of Naval Research, One Liberty
+//  Center, 875 N. Randolph Street, Arlington, VA 22203 under contract #
+//  N68335-17-C-0700.  The content of the information does not necessarily
+//  reflect the position or policy of the Government and no official
+//  endorsement should be inferred.
+//
+//===----------------------------------------------------------------------===//
+
+#include "diff_utils.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+std::vector<std::string_view> split_lines(std::string_view text) {
+  std::vector<std::string_view> lines;
+  while (!text.empty()) {
+    size_t end = text.find('\n');
+    if (end == std::string_view::npos) {
+      lines.push_back(text);
+      break;
+    }
+    lines.push_back(text.substr(0, end));
+    text.remove_prefix(end + 1);
+  }
+  return lines;
+}
+
+// Return the shortest edit script turning a into b, one of ' ' (keep), '-'
+// (delete) or '+' (insert) per line, with Myers' algorithm. The common
+// prefix and suffix are skipped first, so that the cost and the saved
+// search state depend on the size of the change only.
+static std::vector<char> diff_lines(const std::vector<std::string_view>& a,
+                                    const std::vector<std::string_view>& b) {
+  size_t prefix = 0;
+  while (prefix < a.size() && prefix < b.size() && a[prefix] == b[prefix])
+    ++prefix;
+  size_t suffix = 0;
+  while (suffix < a.size() - prefix && suffix < b.size() - prefix &&
+         a[a.size() - 1 - suffix] == b[b.size() - 1 - suffix])
+    ++suffix;
+  const int64_t n = a.size() - prefix - suffix;
+  const int64_t m = b.size() - prefix - suffix;
+  auto same = [&](int64_t x, int64_t y) {
+    return a[prefix + x] == b[prefix + y];
+  };
+
+  // trace[d][k + d] is the furthest x reached on diagonal k with d edits.
+  const int64_t max = n + m;
+  std::vector<int64_t> v(2 * max + 2, 0);
+  std::vector<std::vector<int64_t>> trace;
+  for (int64_t d = 0; d <= max; ++d) {
+    bool done = false;
+    for (int64_t k = -d; k <= d && !done; k += 2) {
+      int64_t x = (k == -d || (k != d && v[max + k - 1] < v[max + k + 1]))
+                      ? v[max + k + 1]
+                      : v[max + k - 1] + 1;
+      int64_t y = x - k;
+      while (x < n && y < m && same(x, y)) {
+        ++x;
+        ++y;
+      }
+      v[max + k] = x;
+      done = x >= n && y >= m;
+    }
+    trace.emplace_back(v.begin() + max - d, v.begin() + max + d + 1);
+    if (done)
+      break;
+  }
+
+  std::vector<char> ops(suffix, ' ');
+  int64_t x = n, y = m;
+  for (int64_t d = trace.size() - 1; d > 0; --d) {
+    const std::vector<int64_t>& prev = trace[d - 1];
+    auto at = [&](int64_t k) { return prev[k + d - 1]; };
+    int64_t k = x - y;
+    int64_t prevK =
+        (k == -d || (k != d && at(k - 1) < at(k + 1))) ? k + 1 : k - 1;
+    int64_t prevX = at(prevK);
+    int64_t prevY = prevX - prevK;
+    while (x > prevX && y > prevY) {
+      ops.push_back(' ');
+      --x;
+      --y;
+    }
+    ops.push_back(x == prevX ? '+' : '-');
+    x = prevX;
+    y = prevY;
+  }
+  ops.insert(ops.end(), x, ' ');
+  ops.insert(ops.end(), prefix, ' ');
+  std::reverse(ops.begin(), ops.end());
+  return ops;
+}
+
+void write_unified_diff(std::ostream& os,
+                        const std::vector<std::string_view>& a,
+                        const std::vector<std::string_view>& b,
+                        const std::string& aName, const std::string& bName,
+                        size_t context) {
+  std::vector<char> ops = diff_lines(a, b);
+  if (std::all_of(ops.begin(), ops.end(), [](char op) { return op == ' '; }))
+    return;
+  os << "--- " << aName << "\n+++ " << bName << '\n';
+
+  // The lines of a and b before each edit.
+  std::vector<size_t> aPos(ops.size() + 1), bPos(ops.size() + 1);
+  for (size_t i = 0; i < ops.size(); ++i) {
+    aPos[i + 1] = aPos[i] + (ops[i] != '+');
+    bPos[i + 1] = bPos[i] + (ops[i] != '-');
+  }
+
+  // Changes separated by more than twice the context go to separate hunks.
+  size_t i = 0;
+  while (i < ops.size()) {
+    if (ops[i] == ' ') {
+      ++i;
+      continue;
+    }
+    size_t last = i;
+    for (size_t j = i + 1; j < ops.size() && j <= last + 2 * context + 1;
+         ++j) {
+      if (ops[j] != ' ')
+        last = j;
+    }
+    size_t begin = i > context ? i - context : 0;
+    size_t end = std::min(ops.size(), last + 1 + context);
+    size_t aCount = aPos[end] - aPos[begin];
+    size_t bCount = bPos[end] - bPos[begin];
+    os << "@@ -" << aPos[begin] + (aCount > 0) << ',' << aCount << " +"
+       << bPos[begin] + (bCount > 0) << ',' << bCount << " @@\n";
+    for (size_t j = begin; j < end; ++j) {
+      const std::string_view line = ops[j] == '+' ? b[bPos[j]] : a[aPos[j]];
+      os << ops[j] << line << '\n';
+    }
+    i = end;
+  }
+}
@@ -1,11 +1,12 @@
 #include "Logger.h"
 #include <boost/program_options.hpp>
 #include <boost/uuid/uuid_io.hpp>
+#include <chrono>
 #include <fstream>
-#include <gtirb_layout/gtirb_layout.hpp>
 #include <gtirb_pprinter/ElfBinaryPrinter.hpp>
 #include <iomanip>
 #include <iostream>
+#include <optional>
 #ifdef USE_STD_FILESYSTEM_LIB
 #include <filesystem>
 namespace fs = std::filesystem;
@@ -15,6 +16,28 @@ namespace fs = std::experimental::filesystem;
 #endif // USE_STD_FILESYSTEM_LIB
 namespace po = boost::program_options;
 
+// Create a directory for cache files, reporting why it failed if it did.
+static bool createCacheDir(const std::string& dir) {
+  std::error_code ec;
+  fs::create_directories(dir, ec);
+  if (ec)
+    LOG_ERROR << "Could not create the cache directory " << dir << ": "
+              << ec.message() << std::endl;
+  return !ec;
+}
+
+// Return the peak resident set size of the process in kilobytes, where the
+// system reports it.
+static std::optional<uint64_t> peakMemoryKB() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 6, "VmHWM:") == 0)
+      return std::stoull(line.substr(6));
+  }
+  return std::nullopt;
+}
+
 int main(int argc, char** argv) {
   gtirb_pprint::registerAuxDataTypes();
 
@@ -38,6 +61,45 @@ int main(int argc, char** argv) {
                      "Library paths to be passed to the linker");
   desc.add_options()("syntax,s", po::value<std::string>(),
                      "The syntax of the assembly file to pass to the compiler");
+  desc.add_options()(
+      "passthrough",
+      "Print instructions without symbolic operands, labels or PC-relative "
+      "encodings as raw bytes instead of disassembling them.");
+  desc.add_options()("nops-directive",
+                     "Print runs of padding NOPs as a single .nops directive "
+                     "(requires GNU as 2.31 or newer).");
+  desc.add_options()("endbr64",
+                     "Print endbr64 instructions instead of replacing them "
+                     "with nop (requires GNU as 2.29 or newer).");
+  desc.add_options()(
+      "render-cache", po::value<std::string>(),
+      "Keep the decoded and formatted text of non-symbolic instructions in "
+      "this directory and reuse it in later runs.");
+  desc.add_options()(
+      "output-cache", po::value<std::string>(),
+      "Keep the printed text of code blocks in this directory and reuse it "
+      "for unchanged blocks in later runs.");
+  desc.add_options()(
+      "sidecar", po::value<std::string>(),
+      "Keep the decoded instructions and the indexes of each module in "
+      "this directory, keyed by the contents of the IR, and reuse them when "
+      "the same IR is printed again.");
+  desc.add_options()(
+      "incbin-threshold", po::value<uint64_t>(),
+      "Write runs of non-symbolic data of at least this many bytes to a "
+      "temporary binary file and include them with .incbin instead of "
+      "printing them as bytes.");
+  desc.add_options()(
+      "estimate",
+      "Instead of printing, predict from the sizes of each module the output "
+      "size, instruction count, memory and time of printing and assembling "
+      "it, and write them to the standard output as one JSON object per "
+      "module, followed by one for the whole job, including the link.");
+  desc.add_options()(
+      "release-modules",
+      "Free the AuxData, blocks, CFG nodes and symbolic expressions of each "
+      "module once its assembly is written, to lower the peak memory use on "
+      "large IRs.");
 
   po::positional_options_description pd;
   pd.add("ir", -1);
@@ -65,8 +127,13 @@ int main(int argc, char** argv) {
     if (fs::exists(irPath)) {
       LOG_INFO << std::setw(24) << std::left << "Reading IR: " << irPath
                << std::endl;
-      std::ifstream in(irPath.string(), std::ios::in | std::ios::binary);
-      ir = gtirb::IR::load(ctx, in);
+      auto start = std::chrono::steady_clock::now();
+      ir = gtirb_pprint::loadIR(ctx, irPath.string());
+      auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+      LOG_INFO << std::setw(24) << std::left << "IR loaded in: " << ms << " ms"
+               << std::endl;
     } else {
       LOG_ERROR << "IR not found: \"" << irPath << "\".";
       return EXIT_FAILURE;
@@ -74,13 +141,25 @@ int main(int argc, char** argv) {
   } else {
     ir = gtirb::IR::load(ctx, std::cin);
   }
+  if (!ir) {
+    LOG_ERROR << "Could not read the IR" << std::endl;
+    return EXIT_FAILURE;
+  }
   if (ir->modules().empty()) {
     LOG_ERROR << "IR has no modules";
     return EXIT_FAILURE;
   }
 
-  // Layout the modules so that evereything has nonoverlapping addresses if
-  // needed.
+  if (vm.count("estimate") != 0) {
+    const uint64_t irFileBytes =
+        vm.count("ir") != 0 ? fs::file_size(vm["ir"].as<std::string>()) : 0;
+    gtirb_pprint::writePrintEstimates(std::cout, *ir, irFileBytes,
+                                      /*compile=*/true);
+    return EXIT_SUCCESS;
+  }
+
+  // Modules without addresses are printed with computed ones, which the
+  // binary printer keeps in the index of each module.
   for (auto& M : ir->modules()) {
     if (!M.getAddress()) {
       // FIXME: There could be other kinds of invalid layouts than one in which
@@ -88,7 +167,6 @@ int main(int argc, char** argv) {
       LOG_INFO << "Module " << M.getUUID()
                << " has invalid layout; laying out module automatically..."
                << std::endl;
-      gtirb_layout::layoutModule(M);
     }
   }
 
@@ -131,8 +209,31 @@ int main(int argc, char** argv) {
     }
   }
 
+  pp.setPassthrough(vm.count("passthrough") != 0);
+  pp.setAssemblerFeatures(vm.count("nops-directive") != 0,
+                          vm.count("endbr64") != 0);
+
+  if (vm.count("render-cache") != 0 &&
+      createCacheDir(vm["render-cache"].as<std::string>()))
+    pp.setRenderCacheDir(vm["render-cache"].as<std::string>());
+  if (vm.count("output-cache") != 0 &&
+      createCacheDir(vm["output-cache"].as<std::string>()))
+    pp.setOutputCacheDir(vm["output-cache"].as<std::string>());
+  if (vm.count("sidecar") != 0 && vm.count("ir") != 0 &&
+      createCacheDir(vm["sidecar"].as<std::string>())) {
+    const std::string& irPath = vm["ir"].as<std::string>();
+    if (std::optional<std::string> hash = gtirb_pprint::hashIRFile(irPath))
+      pp.setSidecar(vm["sidecar"].as<std::string>(), *hash);
+    else
+      LOG_ERROR << "Could not hash " << irPath << "; no sidecar is used"
+                << std::endl;
+  }
+
   if (vm.count("binary") != 0) {
     gtirb_bprint::ElfBinaryPrinter binaryPrinter(true);
+    if (vm.count("incbin-threshold") != 0)
+      binaryPrinter.setIncbinThreshold(vm["incbin-threshold"].as<uint64_t>());
+    binaryPrinter.setReleaseModules(vm.count("release-modules") != 0);
     const auto binaryPath = fs::path(vm["binary"].as<std::string>());
     std::vector<std::string> extraCompilerArgs;
     if (vm.count("compiler-args") != 0)
@@ -140,8 +241,15 @@ int main(int argc, char** argv) {
     std::vector<std::string> libraryPaths;
     if (vm.count("library-paths") != 0)
       libraryPaths = vm["library-paths"].as<std::vector<std::string>>();
-    binaryPrinter.link(binaryPath.string(), extraCompilerArgs, libraryPaths, pp,
-                       ctx, *ir);
+    int result = binaryPrinter.link(binaryPath.string(), extraCompilerArgs,
+                                    libraryPaths, pp, ctx, *ir);
+    if (std::optional<uint64_t> peak = peakMemoryKB())
+      LOG_INFO << std::setw(24) << std::left << "Peak memory: " << *peak / 1024
+               << " MB" << std::endl;
+    if (result != 0) {
+      LOG_ERROR << "Could not build the binary " << binaryPath << std::endl;
+      return EXIT_FAILURE;
+    }
   } else {
     LOG_INFO << "Please specify a binary name" << std::endl;
   }
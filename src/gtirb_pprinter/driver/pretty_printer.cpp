@@ -1,12 +1,26 @@
 #include "Logger.h"
+#include "print_server.hpp"
+#include <algorithm>
 #include <boost/program_options.hpp>
 #include <boost/uuid/uuid_io.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
-#include <gtirb_layout/gtirb_layout.hpp>
+#include <functional>
+#include <future>
 #include <gtirb_pprinter/ElfBinaryPrinter.hpp>
 #include <gtirb_pprinter/PrettyPrinter.hpp>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
 #ifdef USE_STD_FILESYSTEM_LIB
 #include <filesystem>
 namespace fs = std::filesystem;
@@ -17,6 +31,229 @@ namespace fs = std::experimental::filesystem;
 
 namespace po = boost::program_options;
 
+// Parse an address range written as START-END, in decimal or 0x-prefixed
+// hexadecimal.
+static std::optional<std::pair<uint64_t, uint64_t>>
+parseAddressRange(const std::string& range) {
+  size_t dash = range.find('-');
+  if (dash == std::string::npos)
+    return std::nullopt;
+  try {
+    size_t beginLength, endLength;
+    uint64_t begin = std::stoull(range.substr(0, dash), &beginLength, 0);
+    uint64_t end = std::stoull(range.substr(dash + 1), &endLength, 0);
+    if (beginLength != dash || endLength != range.size() - dash - 1 ||
+        end < begin)
+      return std::nullopt;
+    return std::make_pair(begin, end);
+  } catch (const std::logic_error&) {
+    return std::nullopt;
+  }
+}
+
+// Parse a shard written as I/N, with I < N.
+static std::optional<std::pair<size_t, size_t>>
+parseShard(const std::string& shard) {
+  size_t slash = shard.find('/');
+  if (slash == std::string::npos)
+    return std::nullopt;
+  try {
+    size_t indexLength, countLength;
+    unsigned long index = std::stoul(shard.substr(0, slash), &indexLength);
+    unsigned long count = std::stoul(shard.substr(slash + 1), &countLength);
+    if (indexLength != slash || countLength != shard.size() - slash - 1 ||
+        index >= count)
+      return std::nullopt;
+    return std::make_pair(index, count);
+  } catch (const std::logic_error&) {
+    return std::nullopt;
+  }
+}
+
+// Create a directory for cache files, reporting why it failed if it did.
+static bool createCacheDir(const std::string& dir) {
+  std::error_code ec;
+  fs::create_directories(dir, ec);
+  if (ec)
+    LOG_ERROR << "Could not create the cache directory " << dir << ": "
+              << ec.message() << std::endl;
+  return !ec;
+}
+
+// Keep the sidecar files of the IR loaded from irPath in the directory
+// given with --sidecar, if any.
+static void setSidecar(const po::variables_map& vm,
+                       gtirb_pprint::PrettyPrinter& pp,
+                       const std::string& irPath) {
+  if (vm.count("sidecar") == 0)
+    return;
+  const std::string& dir = vm["sidecar"].as<std::string>();
+  if (!createCacheDir(dir))
+    return;
+  if (std::optional<std::string> hash = gtirb_pprint::hashIRFile(irPath))
+    pp.setSidecar(dir, *hash);
+  else
+    LOG_ERROR << "Could not hash " << irPath << "; no sidecar is used"
+              << std::endl;
+}
+
+// An output stream buffer that hands what is printed into it to another
+// thread in chunks, which writes them to a file while printing goes on.
+// Only a few chunks wait to be written at a time, so the memory used does
+// not grow with the size of the output.
+class BackgroundFileBuf : public std::streambuf {
+public:
+  explicit BackgroundFileBuf(std::ofstream f) : file(std::move(f)) {
+    chunk.resize(ChunkSize);
+    setp(chunk.data(), chunk.data() + chunk.size());
+    writer = std::thread([this]() { writeChunks(); });
+  }
+  ~BackgroundFileBuf() { close(); }
+
+  // Write what is left and close the file. Return false if anything could
+  // not be written.
+  bool close() {
+    if (writer.joinable()) {
+      push();
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+      }
+      ready.notify_one();
+      writer.join();
+      file.close();
+    }
+    return !file.fail();
+  }
+
+protected:
+  int_type overflow(int_type c) override {
+    push();
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+
+private:
+  static constexpr size_t ChunkSize = 1 << 20;
+  static constexpr size_t MaxChunks = 4;
+
+  // Queue the current chunk, waiting while too many are queued.
+  void push() {
+    size_t used = pptr() - pbase();
+    if (used == 0)
+      return;
+    chunk.resize(used);
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      space.wait(lock, [this]() { return chunks.size() < MaxChunks; });
+      chunks.push_back(std::move(chunk));
+    }
+    ready.notify_one();
+    chunk = std::string(ChunkSize, '\0');
+    setp(chunk.data(), chunk.data() + chunk.size());
+  }
+
+  void writeChunks() {
+    for (;;) {
+      std::string next;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [this]() { return done || !chunks.empty(); });
+        if (chunks.empty())
+          return;
+        next = std::move(chunks.front());
+        chunks.pop_front();
+      }
+      space.notify_one();
+      file.write(next.data(), next.size());
+    }
+  }
+
+  std::ofstream file;
+  std::string chunk;
+  std::deque<std::string> chunks;
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::condition_variable space;
+  bool done = false;
+  std::thread writer;
+};
+
+// A stream printing into a file through a BackgroundFileBuf.
+class BackgroundFileStream : public std::ostream {
+public:
+  explicit BackgroundFileStream(std::ofstream file)
+      : std::ostream(nullptr), buf(std::move(file)) {
+    rdbuf(&buf);
+  }
+
+  // Write what is left and close the file. Return false if anything could
+  // not be written.
+  bool close() { return buf.close(); }
+
+private:
+  BackgroundFileBuf buf;
+};
+
+// Call print on every module of ir with its index, on up to jobs threads,
+// largest module first so that a big module does not start last. Return
+// what print returned for each module, in IR order.
+static std::vector<std::vector<std::pair<fs::path, bool>>>
+printModulesInParallel(
+    gtirb::IR& ir, unsigned jobs,
+    const std::function<std::vector<std::pair<fs::path, bool>>(
+        gtirb::Module&, int)>& print) {
+  std::vector<gtirb::Module*> modules;
+  std::vector<uint64_t> sizes;
+  for (gtirb::Module& m : ir.modules()) {
+    uint64_t size = 0;
+    for (const gtirb::ByteInterval& bi : m.byte_intervals())
+      size += bi.getSize();
+    modules.push_back(&m);
+    sizes.push_back(size);
+  }
+  std::vector<size_t> order(modules.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+
+  std::vector<std::vector<std::pair<fs::path, bool>>> results(modules.size());
+  std::atomic<size_t> next{0};
+  auto worker = [&]() {
+    for (size_t k = next++; k < order.size(); k = next++)
+      results[order[k]] =
+          print(*modules[order[k]], static_cast<int>(order[k]));
+  };
+  std::vector<std::future<void>> workers;
+  for (size_t j = 0; j < std::min<size_t>(jobs, order.size()); ++j)
+    workers.push_back(std::async(std::launch::async, worker));
+  for (std::future<void>& w : workers)
+    w.get();
+  return results;
+}
+
+// Log the files written for each module, in module order.
+static bool logWrittenFiles(
+    const std::vector<std::vector<std::pair<fs::path, bool>>>& results) {
+  bool ok = true;
+  for (size_t i = 0; i < results.size(); ++i) {
+    for (const auto& [name, written] : results[i]) {
+      if (written) {
+        LOG_INFO << "Module " << i << "'s assembly written to: " << name
+                 << "\n";
+      } else {
+        LOG_ERROR << "Could not output assembly output file: " << name
+                  << "\n";
+        ok = false;
+      }
+    }
+  }
+  return ok;
+}
+
 static fs::path getAsmFileName(const fs::path& InitialPath, int Index) {
   if (Index == 0)
     return InitialPath;
@@ -30,6 +267,232 @@ static fs::path getAsmFileName(const fs::path& InitialPath, int Index) {
   return fs::path(InitialPath).replace_filename(Filename);
 }
 
+struct BatchJob {
+  std::string input;
+  fs::path output;
+};
+
+// Read the jobs of a batch, one `INPUT OUTPUT` pair per line. Blank lines
+// and lines starting with '#' are skipped.
+static std::optional<std::vector<BatchJob>> readBatch(std::istream& in) {
+  std::vector<BatchJob> jobs;
+  std::string line;
+  for (int lineNumber = 1; std::getline(in, line); ++lineNumber) {
+    std::istringstream fields(line);
+    std::string input, output, extra;
+    if (!(fields >> input) || input[0] == '#')
+      continue;
+    if (!(fields >> output) || fields >> extra) {
+      LOG_ERROR << "Invalid batch line " << lineNumber
+                << ", expected INPUT OUTPUT" << std::endl;
+      return std::nullopt;
+    }
+    jobs.push_back({input, output});
+  }
+  return jobs;
+}
+
+// Index \p m for printing, with computed addresses if it has none. Return
+// null, logging why, if it cannot be laid out.
+static std::shared_ptr<const gtirb_pprint::ModuleIndex>
+indexModule(gtirb::Context& ctx, gtirb::Module& m) {
+  auto index = std::make_shared<const gtirb_pprint::ModuleIndex>(ctx, m);
+  if (index->laidOut)
+    return index;
+  LOG_ERROR << "Module " << m.getUUID()
+            << " cannot be laid out: a code block falls through into "
+               "another section or into a block that cannot follow it"
+            << std::endl;
+  return nullptr;
+}
+
+// Print every module of the IR in input to output, numbered as with --asm.
+// Return an empty string on success, or what went wrong.
+static std::string printBatchJob(const po::variables_map& vm,
+                                 const gtirb_pprint::PrettyPrinter& config,
+                                 const BatchJob& job) {
+  if (!fs::exists(job.input))
+    return "IR not found";
+  gtirb::Context ctx;
+  gtirb::IR* ir = gtirb_pprint::loadIR(ctx, job.input);
+  if (!ir)
+    return "could not read the IR";
+  if (ir->modules().empty())
+    return "IR has no modules";
+
+  const std::string format =
+      vm.count("format")
+          ? vm["format"].as<std::string>()
+          : gtirb_pprint::getModuleFileFormat(*ir->modules().begin());
+  const std::string syntax =
+      vm.count("syntax") ? vm["syntax"].as<std::string>()
+                         : gtirb_pprint::getDefaultSyntax(format).value_or("");
+  auto target = std::make_tuple(format, syntax);
+  if (gtirb_pprint::getRegisteredTargets().count(target) == 0)
+    return "unsupported combination: format '" + format + "' and syntax '" +
+           syntax + "'";
+  gtirb_pprint::PrettyPrinter pp(config);
+  pp.setTarget(std::move(target));
+  setSidecar(vm, pp, job.input);
+
+  int i = 0;
+  for (gtirb::Module& m : ir->modules()) {
+    fs::path name = getAsmFileName(job.output, i++);
+    std::ofstream ofs(name);
+    if (!ofs)
+      return "could not open " + name.string();
+    if (vm.count("incbin") != 0)
+      pp.setIncbinFile(name.string() + ".bin",
+                       vm["incbin-threshold"].as<uint64_t>());
+    if (vm.count("source-map") != 0)
+      pp.setSourceMapFile(name.string() + ".map");
+    std::shared_ptr<const gtirb_pprint::ModuleIndex> index =
+        indexModule(ctx, m);
+    if (!index)
+      return "could not lay out module " + std::to_string(i - 1);
+    pp.setModuleIndex(std::move(index));
+    std::error_condition error = pp.print(ofs, ctx, m);
+    pp.setModuleIndex(nullptr);
+    if (error)
+      return "could not print module " + std::to_string(i - 1) + ": " +
+             error.message();
+    ofs.close();
+    if (ofs.fail())
+      return "could not write " + name.string();
+  }
+  return std::string();
+}
+
+// Run the jobs on a pool of workers threads. Each job loads its IR into a
+// context of its own; the printer registry and the Capstone handles of
+// each worker are shared by its jobs. A failing job is reported and the
+// others go on. Return false if any job failed.
+static bool runBatch(const po::variables_map& vm,
+                     const gtirb_pprint::PrettyPrinter& config,
+                     const std::vector<BatchJob>& jobs, unsigned workers) {
+  std::mutex logMutex;
+  std::atomic<size_t> next{0};
+  std::atomic<size_t> failed{0};
+  auto worker = [&]() {
+    for (size_t k = next++; k < jobs.size(); k = next++) {
+      auto start = std::chrono::steady_clock::now();
+      std::string error;
+      try {
+        error = printBatchJob(vm, config, jobs[k]);
+      } catch (const std::exception& e) {
+        error = e.what();
+        if (error.empty())
+          error = "unknown error";
+      }
+      auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+      std::lock_guard<std::mutex> lock(logMutex);
+      if (error.empty()) {
+        LOG_INFO << "Job " << k << " " << jobs[k].input << " -> "
+                 << jobs[k].output.string() << ": ok in " << ms << " ms\n";
+      } else {
+        ++failed;
+        LOG_ERROR << "Job " << k << " " << jobs[k].input << ": " << error
+                  << " after " << ms << " ms\n";
+      }
+    }
+  };
+  std::vector<std::future<void>> pool;
+  for (size_t j = 0; j < std::min<size_t>(workers, jobs.size()); ++j)
+    pool.push_back(std::async(std::launch::async, worker));
+  for (std::future<void>& w : pool)
+    w.get();
+  LOG_INFO << jobs.size() - failed << " of " << jobs.size()
+           << " jobs succeeded\n";
+  return failed == 0;
+}
+
+// Apply the printing options other than the target and the outputs to pp.
+// Return false if one of them is invalid.
+static bool configurePrinter(const po::variables_map& vm,
+                             gtirb_pprint::PrettyPrinter& pp) {
+  pp.setDebug(vm.count("debug"));
+
+  if (vm.count("keep-functions") != 0) {
+    for (const auto& keep :
+         vm["keep-functions"].as<std::vector<std::string>>()) {
+      pp.keepFunction(keep);
+    }
+  }
+
+  if (vm.count("skip-functions") != 0) {
+    for (const auto& skip :
+         vm["skip-functions"].as<std::vector<std::string>>()) {
+      pp.skipFunction(skip);
+    }
+  }
+
+  if (vm.count("function") != 0) {
+    for (const auto& name : vm["function"].as<std::vector<std::string>>())
+      pp.selectFunction(name);
+  }
+
+  if (vm.count("section") != 0) {
+    for (const auto& name : vm["section"].as<std::vector<std::string>>())
+      pp.selectSection(name);
+  }
+
+  if (vm.count("address-range") != 0) {
+    for (const auto& range :
+         vm["address-range"].as<std::vector<std::string>>()) {
+      std::optional<std::pair<uint64_t, uint64_t>> bounds =
+          parseAddressRange(range);
+      if (!bounds) {
+        LOG_ERROR << "Invalid address range '" << range
+                  << "', expected START-END" << std::endl;
+        return false;
+      }
+      pp.selectAddressRange(bounds->first, bounds->second);
+    }
+  }
+
+  pp.setPassthrough(vm.count("passthrough") != 0,
+                    vm.count("passthrough-comments") != 0);
+  pp.setMinimal(vm.count("minimal") != 0);
+  pp.setAssemblerFeatures(vm.count("nops-directive") != 0,
+                          vm.count("endbr64") != 0);
+
+  if (vm.count("render-cache") != 0 &&
+      createCacheDir(vm["render-cache"].as<std::string>()))
+    pp.setRenderCacheDir(vm["render-cache"].as<std::string>());
+  if (vm.count("render-cache-size") != 0)
+    pp.setRenderCacheSize(vm["render-cache-size"].as<uint64_t>());
+  if (vm.count("output-cache") != 0 &&
+      createCacheDir(vm["output-cache"].as<std::string>()))
+    pp.setOutputCacheDir(vm["output-cache"].as<std::string>());
+  if (vm.count("ir") != 0)
+    setSidecar(vm, pp, vm["ir"].as<std::string>());
+
+  if (vm.count("shard") != 0) {
+    std::optional<std::pair<size_t, size_t>> shard =
+        parseShard(vm["shard"].as<std::string>());
+    if (!shard) {
+      LOG_ERROR << "Invalid shard '" << vm["shard"].as<std::string>()
+                << "', expected I/N with I < N" << std::endl;
+      return false;
+    }
+    // Each shard would start its own binary file and source map, and
+    // selections are printed whole.
+    for (const char* option :
+         {"incbin", "source-map", "diff", "asm-att", "asm-intel", "function",
+          "section", "address-range"}) {
+      if (vm.count(option) != 0) {
+        LOG_ERROR << "--shard cannot be combined with --" << option
+                  << std::endl;
+        return false;
+      }
+    }
+    pp.setShard(shard->first, shard->second);
+  }
+  return true;
+}
+
 int main(int argc, char** argv) {
   gtirb_pprint::registerAuxDataTypes();
 
@@ -42,6 +505,17 @@ int main(int argc, char** argv) {
       "prints to the standard output. If the IR has more "
       "than one module, files of the form FILE, FILE_2 ... "
       "FILE_n with the content of each of the modules");
+  desc.add_options()("asm-att", po::value<std::string>(),
+                     "Also write the assembly in AT&T syntax to this file, "
+                     "in the same pass as the other outputs.");
+  desc.add_options()("asm-intel", po::value<std::string>(),
+                     "Also write the assembly in Intel syntax to this file, "
+                     "in the same pass as the other outputs.");
+  desc.add_options()(
+      "diff", po::value<std::string>(),
+      "Compare the module with the same index in this older gtirb file and "
+      "print the functions that changed as a unified diff of their "
+      "assembly, to --asm or to the standard output.");
   desc.add_options()("module,m", po::value<int>()->default_value(0),
                      "The index of the module to be printed if printing to the "
                      "standard output.");
@@ -57,6 +531,98 @@ int main(int argc, char** argv) {
   desc.add_options()("skip-functions,n",
                      po::value<std::vector<std::string>>()->multitoken(),
                      "Do not print the given functions.");
+  desc.add_options()("function",
+                     po::value<std::vector<std::string>>()->multitoken(),
+                     "Only print the given functions.");
+  desc.add_options()("section",
+                     po::value<std::vector<std::string>>()->multitoken(),
+                     "Only print the given sections.");
+  desc.add_options()("address-range",
+                     po::value<std::vector<std::string>>()->multitoken(),
+                     "Only print the blocks starting in the given address "
+                     "ranges, written as START-END (e.g. 0x401000-0x402000).");
+  desc.add_options()(
+      "passthrough",
+      "Print instructions without symbolic operands, labels or PC-relative "
+      "encodings as raw bytes instead of disassembling them.");
+  desc.add_options()("passthrough-comments",
+                     "Annotate instructions printed with --passthrough with "
+                     "their disassembly.");
+  desc.add_options()("minimal",
+                     "Omit comments, bars and indentation that are not needed "
+                     "by the assembler.");
+  desc.add_options()("nops-directive",
+                     "Print runs of padding NOPs as a single .nops directive "
+                     "(requires GNU as 2.31 or newer).");
+  desc.add_options()("endbr64",
+                     "Print endbr64 instructions instead of replacing them "
+                     "with nop (requires GNU as 2.29 or newer).");
+  desc.add_options()(
+      "render-cache", po::value<std::string>(),
+      "Keep the decoded and formatted text of non-symbolic instructions in "
+      "this directory and reuse it in later runs.");
+  desc.add_options()("render-cache-size", po::value<uint64_t>(),
+                     "The maximum number of distinct instructions whose text "
+                     "is cached (default 65536, 0 disables the cache).");
+  desc.add_options()(
+      "output-cache", po::value<std::string>(),
+      "Keep the printed text of code blocks in this directory and reuse it "
+      "for unchanged blocks in later runs.");
+  desc.add_options()(
+      "sidecar", po::value<std::string>(),
+      "Keep the decoded instructions and the indexes of each module in "
+      "this directory, keyed by the contents of the IR, and reuse them when "
+      "the same IR is printed again.");
+  desc.add_options()(
+      "incbin",
+      "Write long runs of non-symbolic data to a binary file FILE.bin next "
+      "to each assembly file and include them with .incbin. Requires --asm.");
+  desc.add_options()(
+      "source-map",
+      "Write a source map FILE.map next to each assembly file, mapping its "
+      "lines and offsets to the addresses they were printed from. Requires "
+      "--asm.");
+  desc.add_options()(
+      "shard", po::value<std::string>(),
+      "Print only shard I of N of each module, written as I/N (counting from "
+      "0). Shards can be printed by separate processes or machines and "
+      "joined with --merge.");
+  desc.add_options()(
+      "estimate",
+      "Instead of printing, predict from the sizes of each module the output "
+      "size, instruction count, memory and time of printing it, and write "
+      "them to the standard output as one JSON object per module, followed "
+      "by one for the whole job.");
+  desc.add_options()(
+      "merge", po::value<std::vector<std::string>>()->multitoken(),
+      "Join the outputs of all the shards of a module printed with --shard "
+      "into the output of printing it whole, written to --asm or to the "
+      "standard output. No IR is read.");
+  desc.add_options()(
+      "batch", po::value<std::string>(),
+      "Print many IRs in one process. FILE lists one job per line as INPUT "
+      "OUTPUT, where OUTPUT is named like --asm; '-' reads the jobs from the "
+      "standard input. The jobs run on --jobs workers, and a failing job "
+      "does not stop the others.");
+  desc.add_options()(
+      "serve", po::value<std::string>(),
+      "Serve print requests on the Unix domain socket SOCKET, with --jobs "
+      "workers, keeping the last --cache-size IRs loaded.");
+  desc.add_options()("cache-size", po::value<size_t>()->default_value(4),
+                     "The number of IRs kept loaded by --serve.");
+  desc.add_options()(
+      "connect", po::value<std::string>(),
+      "Ask the server listening on SOCKET to print --module of --ir, with "
+      "the given --format, --syntax, --function and --section, and copy "
+      "the assembly to the standard output.");
+  desc.add_options()(
+      "jobs,j", po::value<unsigned>()->default_value(1),
+      "Print up to N modules at once, each into its own file given by --asm, "
+      "--asm-att or --asm-intel. 0 uses one job per core.");
+  desc.add_options()("incbin-threshold",
+                     po::value<uint64_t>()->default_value(4096),
+                     "The minimum length in bytes of a data run written to "
+                     "the binary file when using --incbin.");
   po::positional_options_description pd;
   pd.add("ir", -1);
   po::variables_map vm;
@@ -75,6 +641,87 @@ int main(int argc, char** argv) {
   }
   po::notify(vm);
 
+  if (vm.count("merge") != 0) {
+    std::error_condition error;
+    if (vm.count("asm") != 0) {
+      std::ofstream ofs(vm["asm"].as<std::string>());
+      error = gtirb_pprint::mergeShards(
+          vm["merge"].as<std::vector<std::string>>(), ofs);
+    } else {
+      error = gtirb_pprint::mergeShards(
+          vm["merge"].as<std::vector<std::string>>(), std::cout);
+    }
+    if (error) {
+      LOG_ERROR << "Could not merge the shards: " << error.message()
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  unsigned jobs = vm["jobs"].as<unsigned>();
+  if (jobs == 0)
+    jobs = std::max(1u, std::thread::hardware_concurrency());
+
+  if (vm.count("connect") != 0) {
+    if (vm.count("ir") == 0) {
+      LOG_ERROR << "--connect requires an IR (--ir)" << std::endl;
+      return EXIT_FAILURE;
+    }
+    PrintRequest request;
+    // The server does not share our working directory.
+    request.ir = fs::absolute(vm["ir"].as<std::string>()).string();
+    request.module = vm["module"].as<int>();
+    if (vm.count("format") != 0)
+      request.format = vm["format"].as<std::string>();
+    if (vm.count("syntax") != 0)
+      request.syntax = vm["syntax"].as<std::string>();
+    if (vm.count("function") != 0)
+      request.functions = vm["function"].as<std::vector<std::string>>();
+    if (vm.count("section") != 0)
+      request.sections = vm["section"].as<std::vector<std::string>>();
+    return runPrintClient(vm["connect"].as<std::string>(), request,
+                          std::cout);
+  }
+
+  if (vm.count("serve") != 0) {
+    gtirb_pprint::PrettyPrinter config;
+    if (!configurePrinter(vm, config))
+      return EXIT_FAILURE;
+    return runPrintServer(vm["serve"].as<std::string>(), config, jobs,
+                          std::max<size_t>(1, vm["cache-size"].as<size_t>()));
+  }
+
+  if (vm.count("batch") != 0) {
+    for (const char* option :
+         {"ir", "asm", "asm-att", "asm-intel", "diff", "module"}) {
+      if (vm.count(option) != 0 && !vm[option].defaulted()) {
+        LOG_ERROR << "--batch cannot be combined with --" << option
+                  << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+    gtirb_pprint::PrettyPrinter config;
+    if (!configurePrinter(vm, config))
+      return EXIT_FAILURE;
+    const std::string& batchPath = vm["batch"].as<std::string>();
+    std::optional<std::vector<BatchJob>> batch;
+    if (batchPath == "-") {
+      batch = readBatch(std::cin);
+    } else {
+      std::ifstream in(batchPath);
+      if (!in) {
+        LOG_ERROR << "Batch file not found: \"" << batchPath << "\"."
+                  << std::endl;
+        return EXIT_FAILURE;
+      }
+      batch = readBatch(in);
+    }
+    if (!batch)
+      return EXIT_FAILURE;
+    return runBatch(vm, config, *batch, jobs) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
   gtirb::Context ctx;
   gtirb::IR* ir;
 
@@ -83,8 +730,13 @@ int main(int argc, char** argv) {
     if (fs::exists(irPath)) {
       LOG_INFO << std::setw(24) << std::left << "Reading IR: " << irPath
                << std::endl;
-      std::ifstream in(irPath.string(), std::ios::in | std::ios::binary);
-      ir = gtirb::IR::load(ctx, in);
+      auto start = std::chrono::steady_clock::now();
+      ir = gtirb_pprint::loadIR(ctx, irPath.string());
+      auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+      LOG_INFO << std::setw(24) << std::left << "IR loaded in: " << ms << " ms"
+               << std::endl;
     } else {
       LOG_ERROR << "IR not found: \"" << irPath << "\".";
       return EXIT_FAILURE;
@@ -92,13 +744,25 @@ int main(int argc, char** argv) {
   } else {
     ir = gtirb::IR::load(ctx, std::cin);
   }
+  if (!ir) {
+    LOG_ERROR << "Could not read the IR" << std::endl;
+    return EXIT_FAILURE;
+  }
   if (ir->modules().empty()) {
     LOG_ERROR << "IR has no modules";
     return EXIT_FAILURE;
   }
 
-  // Layout the modules so that evereything has nonoverlapping addresses if
-  // needed.
+  if (vm.count("estimate") != 0) {
+    const uint64_t irFileBytes =
+        vm.count("ir") != 0 ? fs::file_size(vm["ir"].as<std::string>()) : 0;
+    gtirb_pprint::writePrintEstimates(std::cout, *ir, irFileBytes);
+    return EXIT_SUCCESS;
+  }
+
+  // Modules without addresses are printed with computed ones, which are kept
+  // in the index of the module. Each module is indexed while the previous
+  // one is printed.
   for (auto& M : ir->modules()) {
     if (!M.getAddress()) {
       // FIXME: There could be other kinds of invalid layouts than one in which
@@ -106,13 +770,22 @@ int main(int argc, char** argv) {
       LOG_INFO << "Module " << M.getUUID()
                << " has invalid layout; laying out module automatically..."
                << std::endl;
-      gtirb_layout::layoutModule(M);
     }
   }
+  // Modules that cannot be laid out get no index, and are not printed. The
+  // slots are created up front, so that filling one while another is
+  // printed does not change the map.
+  std::unordered_map<const gtirb::Module*,
+                     std::shared_ptr<const gtirb_pprint::ModuleIndex>>
+      indexes;
+  for (const gtirb::Module& M : ir->modules())
+    indexes[&M];
+  auto layout = [&](gtirb::Module& M) {
+    indexes.at(&M) = indexModule(ctx, M);
+  };
 
   // Perform the Pretty Printing step.
   gtirb_pprint::PrettyPrinter pp;
-  pp.setDebug(vm.count("debug"));
   const std::string& format =
       vm.count("format")
           ? vm["format"].as<std::string>()
@@ -136,43 +809,262 @@ int main(int argc, char** argv) {
     return EXIT_FAILURE;
   }
   pp.setTarget(std::move(target));
+  if (!configurePrinter(vm, pp))
+    return EXIT_FAILURE;
 
-  if (vm.count("keep-functions") != 0) {
-    for (const auto& keep :
-         vm["keep-functions"].as<std::vector<std::string>>()) {
-      pp.keepFunction(keep);
-    }
+  if (vm.count("incbin") != 0 && vm.count("asm") == 0) {
+    LOG_ERROR << "--incbin requires an assembly output file (--asm)"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (vm.count("source-map") != 0 && vm.count("asm") == 0) {
+    LOG_ERROR << "--source-map requires an assembly output file (--asm)"
+              << std::endl;
+    return EXIT_FAILURE;
   }
 
-  if (vm.count("skip-functions") != 0) {
-    for (const auto& skip :
-         vm["skip-functions"].as<std::vector<std::string>>()) {
-      pp.skipFunction(skip);
+  if (vm.count("diff") != 0) {
+    fs::path oldPath = vm["diff"].as<std::string>();
+    if (!fs::exists(oldPath)) {
+      LOG_ERROR << "IR not found: \"" << oldPath << "\".";
+      return EXIT_FAILURE;
+    }
+    // The old IR has the same UUIDs as the new one, so it needs a context of
+    // its own.
+    gtirb::Context oldCtx;
+    gtirb::IR* oldIr = gtirb_pprint::loadIR(oldCtx, oldPath.string());
+    int index = vm["module"].as<int>();
+    if (index < 0 ||
+        index >= std::distance(ir->modules().begin(), ir->modules().end()) ||
+        index >=
+            std::distance(oldIr->modules().begin(), oldIr->modules().end())) {
+      LOG_ERROR << "Module with index " << index
+                << " cannot be compared: it is missing from one of the IRs"
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+    gtirb::Module& oldModule = *std::next(oldIr->modules().begin(), index);
+    gtirb::Module& module = *std::next(ir->modules().begin(), index);
+    std::error_condition error;
+    if (vm.count("asm") != 0) {
+      std::ofstream ofs(vm["asm"].as<std::string>());
+      error = pp.printDiff(ofs, oldCtx, oldModule, ctx, module);
+    } else {
+      error = pp.printDiff(std::cout, oldCtx, oldModule, ctx, module);
     }
+    if (error == std::errc::address_not_available) {
+      LOG_ERROR << "Module with index " << index
+                << " cannot be compared: it cannot be laid out in one of the "
+                   "IRs"
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
   }
 
-  // Do we write it to a file?
-  if (vm.count("asm") != 0) {
+  // Additional syntaxes are printed together with --asm, in one traversal of
+  // each module.
+  std::vector<std::pair<std::tuple<std::string, std::string>, fs::path>>
+      outputs;
+  for (const auto& [option, extraSyntax] :
+       {std::make_pair("asm-att", "att"),
+        std::make_pair("asm-intel", "intel")}) {
+    if (vm.count(option) == 0)
+      continue;
+    auto extraTarget = std::make_tuple(format, std::string(extraSyntax));
+    if (gtirb_pprint::getRegisteredTargets().count(extraTarget) == 0) {
+      LOG_ERROR << "Unsupported combination: format '" << format
+                << "' and syntax '" << extraSyntax << "'\n";
+      return EXIT_FAILURE;
+    }
+    outputs.emplace_back(extraTarget, vm[option].as<std::string>());
+  }
+  if (!outputs.empty()) {
+    for (const char* option : {"incbin", "source-map"}) {
+      if (vm.count(option) != 0) {
+        LOG_ERROR << "--" << option
+                  << " cannot be combined with --asm-att or --asm-intel"
+                  << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+    if (vm.count("asm") != 0)
+      outputs.emplace_back(std::make_tuple(format, syntax),
+                           vm["asm"].as<std::string>());
+    for (const auto& [outputTarget, path] : outputs) {
+      if (!path.has_filename()) {
+        LOG_ERROR << "The given path " << path << " has no filename"
+                  << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+    if (jobs > 1) {
+      // Each job prints its module straight into the files.
+      auto print = [&](gtirb::Module& m, int i) {
+        std::vector<std::pair<fs::path, bool>> written;
+        std::vector<std::ofstream> files;
+        for (const auto& [outputTarget, path] : outputs) {
+          written.emplace_back(getAsmFileName(path, i), false);
+          files.emplace_back(written.back().first);
+          if (!files.back())
+            return written;
+        }
+        std::vector<std::pair<std::tuple<std::string, std::string>,
+                              std::ostream*>>
+            streams;
+        for (size_t j = 0; j < outputs.size(); ++j)
+          streams.emplace_back(outputs[j].first, &files[j]);
+        std::shared_ptr<const gtirb_pprint::ModuleIndex> index =
+            indexModule(ctx, m);
+        if (!index)
+          return written;
+        gtirb_pprint::PrettyPrinter modulePP(pp);
+        modulePP.setModuleIndex(std::move(index));
+        if (std::error_condition error = modulePP.print(streams, ctx, m)) {
+          LOG_ERROR << "Could not print module " << i << ": "
+                    << error.message() << "\n";
+          return written;
+        }
+        for (size_t j = 0; j < outputs.size(); ++j) {
+          files[j].close();
+          written[j].second = !files[j].fail();
+        }
+        return written;
+      };
+      if (!logWrittenFiles(printModulesInParallel(*ir, jobs, print)))
+        return EXIT_FAILURE;
+      return EXIT_SUCCESS;
+    }
+    int i = 0;
+    auto print = [&](gtirb::Module& m) {
+      std::shared_ptr<const gtirb_pprint::ModuleIndex> index =
+          std::move(indexes.at(&m));
+      // The module could not be laid out.
+      if (!index)
+        return false;
+      std::vector<fs::path> names;
+      std::vector<std::unique_ptr<BackgroundFileStream>> files;
+      for (const auto& [outputTarget, path] : outputs) {
+        names.push_back(getAsmFileName(path, i));
+        std::ofstream file(names.back());
+        if (!file) {
+          LOG_ERROR << "Could not output assembly output file: "
+                    << names.back() << "\n";
+          return false;
+        }
+        files.push_back(
+            std::make_unique<BackgroundFileStream>(std::move(file)));
+      }
+      std::vector<std::pair<std::tuple<std::string, std::string>,
+                            std::ostream*>>
+          streams;
+      for (size_t j = 0; j < outputs.size(); ++j)
+        streams.emplace_back(outputs[j].first, files[j].get());
+      pp.setModuleIndex(std::move(index));
+      std::error_condition error = pp.print(streams, ctx, m);
+      pp.setModuleIndex(nullptr);
+      if (error) {
+        LOG_ERROR << "Could not print module " << i << ": "
+                  << error.message() << "\n";
+        return false;
+      }
+      bool ok = true;
+      for (size_t j = 0; j < outputs.size(); ++j) {
+        if (files[j]->close()) {
+          LOG_INFO << "Module " << i << "'s assembly written to: " << names[j]
+                   << "\n";
+        } else {
+          LOG_ERROR << "Could not write assembly output file: " << names[j]
+                    << "\n";
+          ok = false;
+        }
+      }
+      ++i;
+      return ok;
+    };
+    if (!gtirb_pprint::pipelineModules(*ir, layout, print))
+      return EXIT_FAILURE;
+    // Do we write it to a file?
+  } else if (vm.count("asm") != 0) {
     const auto asmPath = fs::path(vm["asm"].as<std::string>());
     if (!asmPath.has_filename()) {
       LOG_ERROR << "The given path " << asmPath << " has no filename"
                 << std::endl;
       return EXIT_FAILURE;
     }
+    if (jobs > 1) {
+      // Each job prints its module straight into the file, with a printer
+      // of its own for the per-file settings.
+      auto print = [&](gtirb::Module& m, int i) {
+        fs::path name = getAsmFileName(asmPath, i);
+        std::vector<std::pair<fs::path, bool>> written{{name, false}};
+        std::ofstream ofs(name);
+        if (!ofs)
+          return written;
+        gtirb_pprint::PrettyPrinter modulePP(pp);
+        if (vm.count("incbin") != 0)
+          modulePP.setIncbinFile(name.string() + ".bin",
+                                 vm["incbin-threshold"].as<uint64_t>());
+        if (vm.count("source-map") != 0)
+          modulePP.setSourceMapFile(name.string() + ".map");
+        std::shared_ptr<const gtirb_pprint::ModuleIndex> index =
+            indexModule(ctx, m);
+        if (!index)
+          return written;
+        modulePP.setModuleIndex(std::move(index));
+        if (std::error_condition error = modulePP.print(ofs, ctx, m)) {
+          LOG_ERROR << "Could not print module " << i << ": "
+                    << error.message() << "\n";
+          return written;
+        }
+        ofs.close();
+        written.front().second = !ofs.fail();
+        return written;
+      };
+      if (!logWrittenFiles(printModulesInParallel(*ir, jobs, print)))
+        return EXIT_FAILURE;
+      return EXIT_SUCCESS;
+    }
     int i = 0;
-    for (gtirb::Module& m : ir->modules()) {
-      fs::path name = getAsmFileName(asmPath, i);
+    auto print = [&](gtirb::Module& m) {
+      std::shared_ptr<const gtirb_pprint::ModuleIndex> moduleIndex =
+          std::move(indexes.at(&m));
+      // The module could not be laid out.
+      if (!moduleIndex)
+        return false;
+      int index = i++;
+      fs::path name = getAsmFileName(asmPath, index);
       std::ofstream ofs(name);
-      if (ofs) {
-        pp.print(ofs, ctx, m);
-        LOG_INFO << "Module " << i << "'s assembly written to: " << name
-                 << "\n";
-      } else {
-        LOG_ERROR << "Could not output assembly output file: " << asmPath
+      if (!ofs) {
+        LOG_ERROR << "Could not output assembly output file: " << name
                   << "\n";
+        return false;
       }
-      ++i;
-    }
+      if (vm.count("incbin") != 0)
+        pp.setIncbinFile(name.string() + ".bin",
+                         vm["incbin-threshold"].as<uint64_t>());
+      if (vm.count("source-map") != 0)
+        pp.setSourceMapFile(name.string() + ".map");
+      BackgroundFileStream file(std::move(ofs));
+      pp.setModuleIndex(std::move(moduleIndex));
+      std::error_condition error = pp.print(file, ctx, m);
+      pp.setModuleIndex(nullptr);
+      if (error) {
+        LOG_ERROR << "Could not print module " << index << ": "
+                  << error.message() << "\n";
+        return false;
+      }
+      if (!file.close()) {
+        LOG_ERROR << "Could not write assembly output file: " << name
+                  << "\n";
+        return false;
+      }
+      LOG_INFO << "Module " << index << "'s assembly written to: " << name
+               << "\n";
+      return true;
+    };
+    if (!gtirb_pprint::pipelineModules(*ir, layout, print))
+      return EXIT_FAILURE;
     // or to the standard output
   } else {
     gtirb::Module* module = nullptr;
@@ -189,7 +1081,16 @@ int main(int argc, char** argv) {
                 << vm["module"].as<int>() << " cannot be printed" << std::endl;
       return EXIT_FAILURE;
     }
-    pp.print(std::cout, ctx, *module);
+    std::shared_ptr<const gtirb_pprint::ModuleIndex> index =
+        indexModule(ctx, *module);
+    if (!index)
+      return EXIT_FAILURE;
+    pp.setModuleIndex(std::move(index));
+    if (std::error_condition error = pp.print(std::cout, ctx, *module)) {
+      LOG_ERROR << "Could not print module " << vm["module"].as<int>()
+                << ": " << error.message() << std::endl;
+      return EXIT_FAILURE;
+    }
   }
 
   return EXIT_SUCCESS;
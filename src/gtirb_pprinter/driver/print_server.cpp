@@ -0,0 +1,543 @@
+#include "print_server.hpp"
+#include "Logger.h"
+
+#ifdef _WIN32
+
+int runPrintServer(const std::string& /*socketPath*/,
+                   const gtirb_pprint::PrettyPrinter& /*config*/,
+                   unsigned /*workers*/, size_t /*cacheSize*/) {
+  LOG_ERROR << "The print server needs Unix domain sockets" << std::endl;
+  return EXIT_FAILURE;
+}
+
+int runPrintClient(const std::string& /*socketPath*/,
+                   const PrintRequest& /*request*/, std::ostream& /*os*/) {
+  LOG_ERROR << "The print server needs Unix domain sockets" << std::endl;
+  return EXIT_FAILURE;
+}
+
+#else
+
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <list>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#ifdef USE_STD_FILESYSTEM_LIB
+#include <filesystem>
+namespace fs = std::filesystem;
+#else
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#endif // USE_STD_FILESYSTEM_LIB
+
+namespace {
+
+// Serializes the log lines of the workers.
+std::mutex logMutex;
+
+// A stream buffer sending its output to a socket.
+class SocketBuf : public std::streambuf {
+public:
+  explicit SocketBuf(int fd_) : fd(fd_) {
+    setp(buffer, buffer + sizeof(buffer));
+  }
+  ~SocketBuf() override { flush(); }
+
+protected:
+  int_type overflow(int_type c) override {
+    if (!flush())
+      return traits_type::eof();
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+  int sync() override { return flush() ? 0 : -1; }
+
+public:
+  // The number of bytes written into the buffer so far.
+  size_t size() const { return sent + (pptr() - pbase()); }
+
+private:
+  bool flush() {
+    const char* pos = pbase();
+    while (pos < pptr()) {
+      ssize_t sent = ::send(fd, pos, pptr() - pos, 0);
+      if (sent < 0 && errno == EINTR)
+        continue;
+      if (sent <= 0)
+        return false;
+      pos += sent;
+    }
+    this->sent += pptr() - pbase();
+    setp(buffer, buffer + sizeof(buffer));
+    return true;
+  }
+
+  int fd;
+  size_t sent = 0;
+  char buffer[1 << 16];
+};
+
+// How long a client has to send its whole request, so that a client that
+// connects and sends nothing does not hold a worker.
+const std::chrono::seconds RequestTimeout(10);
+
+// Read a request, up to the empty line ending it. Set timedOut if the
+// client did not send it within RequestTimeout.
+std::optional<PrintRequest> readRequest(int fd, bool& timedOut) {
+  static const size_t MaxRequestSize = 1 << 16;
+  const auto deadline = std::chrono::steady_clock::now() + RequestTimeout;
+  timedOut = false;
+  std::string text;
+  char chunk[4096];
+  while (text.find("\n\n") == std::string::npos) {
+    // Each read waits for what is left of the time given to the request.
+    auto left = std::chrono::duration_cast<std::chrono::microseconds>(
+        deadline - std::chrono::steady_clock::now());
+    if (left.count() <= 0) {
+      timedOut = true;
+      return std::nullopt;
+    }
+    timeval timeout{};
+    timeout.tv_sec = static_cast<time_t>(left.count() / 1000000);
+    timeout.tv_usec = static_cast<suseconds_t>(left.count() % 1000000);
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ssize_t got = ::recv(fd, chunk, sizeof(chunk), 0);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      timedOut = true;
+      return std::nullopt;
+    }
+    if (got <= 0 || text.size() + got > MaxRequestSize)
+      return std::nullopt;
+    text.append(chunk, got);
+  }
+  text.resize(text.find("\n\n") + 1);
+
+  PrintRequest request;
+  std::istringstream lines(text);
+  std::string line;
+  while (std::getline(lines, line)) {
+    size_t space = line.find(' ');
+    if (space == std::string::npos)
+      return std::nullopt;
+    std::string field = line.substr(0, space);
+    std::string value = line.substr(space + 1);
+    if (field == "ir") {
+      request.ir = value;
+    } else if (field == "module") {
+      try {
+        request.module = std::stoi(value);
+      } catch (const std::logic_error&) {
+        return std::nullopt;
+      }
+    } else if (field == "format") {
+      request.format = value;
+    } else if (field == "syntax") {
+      request.syntax = value;
+    } else if (field == "function") {
+      request.functions.push_back(value);
+    } else if (field == "section") {
+      request.sections.push_back(value);
+    } else {
+      return std::nullopt;
+    }
+  }
+  if (request.ir.empty())
+    return std::nullopt;
+  return request;
+}
+
+// An IR kept loaded by the server, with the indexes of its modules, built
+// on first use.
+struct CachedIR {
+  std::string path;
+  fs::file_time_type mtime;
+  gtirb::Context context;
+  gtirb::IR* ir = nullptr;
+  std::vector<std::shared_ptr<const gtirb_pprint::ModuleIndex>> indexes;
+  // AuxData is deserialized on first use, so requests on the same IR are
+  // printed one at a time. Requests on different IRs run concurrently.
+  std::mutex mutex;
+};
+
+// The most recently used IRs, keyed by path and modification time.
+class IRCache {
+public:
+  explicit IRCache(size_t capacity_) : capacity(capacity_) {}
+
+  // Return the IR at path, loading it if it is not cached or if its file
+  // changed since. Set error and return null if it cannot be loaded. Each
+  // IR is loaded once: concurrent requests for it wait for that load.
+  std::shared_ptr<CachedIR> get(const std::string& path, std::string& error) {
+    std::error_code ec;
+    fs::file_time_type mtime = fs::last_write_time(path, ec);
+    if (ec) {
+      error = "IR not found";
+      return nullptr;
+    }
+    std::promise<Loaded> promise;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+      if ((*it)->path == path && (*it)->mtime == mtime) {
+        entries.splice(entries.begin(), entries, it);
+        return entries.front();
+      }
+    }
+    auto pending = loading.find(path);
+    if (pending != loading.end() && pending->second.first == mtime) {
+      std::shared_future<Loaded> loaded = pending->second.second;
+      lock.unlock();
+      error = loaded.get().second;
+      return loaded.get().first;
+    }
+    loading[path] = {mtime, promise.get_future().share()};
+    lock.unlock();
+
+    // Load outside of the lock, so that other requests go on meanwhile.
+    Loaded loaded;
+    try {
+      loaded = load(path, mtime);
+    } catch (...) {
+      lock.lock();
+      forget(path, mtime);
+      promise.set_exception(std::current_exception());
+      throw;
+    }
+
+    lock.lock();
+    forget(path, mtime);
+    if (loaded.first) {
+      entries.remove_if([&](const std::shared_ptr<CachedIR>& e) {
+        return e->path == path;
+      });
+      entries.push_front(loaded.first);
+      // Evicted IRs are freed once the requests using them are done.
+      while (entries.size() > capacity)
+        entries.pop_back();
+    }
+    promise.set_value(loaded);
+    error = loaded.second;
+    return loaded.first;
+  }
+
+private:
+  // A loaded IR, or null and why it could not be loaded.
+  using Loaded = std::pair<std::shared_ptr<CachedIR>, std::string>;
+
+  static Loaded load(const std::string& path, fs::file_time_type mtime) {
+    auto entry = std::make_shared<CachedIR>();
+    entry->path = path;
+    entry->mtime = mtime;
+    // The file is read as a stream rather than mapped: it may be rewritten
+    // while it loads, which would kill the server with SIGBUS.
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    entry->ir = gtirb::IR::load(entry->context, in);
+    if (!entry->ir)
+      return {nullptr, "could not read the IR"};
+    entry->indexes.resize(std::distance(entry->ir->modules().begin(),
+                                        entry->ir->modules().end()));
+    return {entry, ""};
+  }
+
+  // Forget the load of path, unless a newer version of it is loading.
+  void forget(const std::string& path, fs::file_time_type mtime) {
+    auto it = loading.find(path);
+    if (it != loading.end() && it->second.first == mtime)
+      loading.erase(it);
+  }
+
+  std::mutex mutex;
+  size_t capacity;
+  std::list<std::shared_ptr<CachedIR>> entries;
+  // The IRs being loaded, by path.
+  std::map<std::string,
+           std::pair<fs::file_time_type, std::shared_future<Loaded>>>
+      loading;
+};
+
+// Answer the request on the connection fd.
+void serve(int fd, IRCache& cache, const gtirb_pprint::PrettyPrinter& config) {
+  auto begin = std::chrono::steady_clock::now();
+  SocketBuf buf(fd);
+  std::ostream out(&buf);
+  bool timedOut;
+  std::optional<PrintRequest> request = readRequest(fd, timedOut);
+  if (!request) {
+    out << (timedOut ? "error timeout\n" : "error invalid request\n");
+    return;
+  }
+  std::string error;
+  std::shared_ptr<CachedIR> entry = cache.get(request->ir, error);
+  if (!entry) {
+    out << "error " << request->ir << ": " << error << "\n";
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(entry->mutex);
+  int count = static_cast<int>(entry->indexes.size());
+  if (request->module < 0 || request->module >= count) {
+    out << "error the IR has " << count << " modules, module with index "
+        << request->module << " cannot be printed\n";
+    return;
+  }
+  gtirb::Module& module =
+      *std::next(entry->ir->modules().begin(), request->module);
+  const std::string format = request->format.empty()
+                                 ? gtirb_pprint::getModuleFileFormat(module)
+                                 : request->format;
+  const std::string syntax =
+      request->syntax.empty()
+          ? gtirb_pprint::getDefaultSyntax(format).value_or("")
+          : request->syntax;
+  auto target = std::make_tuple(format, syntax);
+  if (gtirb_pprint::getRegisteredTargets().count(target) == 0) {
+    out << "error unsupported combination: format '" << format
+        << "' and syntax '" << syntax << "'\n";
+    return;
+  }
+  // Modules without addresses are printed with the computed ones the index
+  // keeps.
+  auto& index = entry->indexes[request->module];
+  if (!index)
+    index = std::make_shared<const gtirb_pprint::ModuleIndex>(entry->context,
+                                                              module);
+  if (!index->laidOut) {
+    out << "error module with index " << request->module
+        << " cannot be laid out\n";
+    return;
+  }
+
+  gtirb_pprint::PrettyPrinter pp(config);
+  pp.setTarget(std::move(target));
+  for (const std::string& name : request->functions)
+    pp.selectFunction(name);
+  for (const std::string& name : request->sections)
+    pp.selectSection(name);
+  pp.setModuleIndex(index);
+  out << "ok\n";
+  out.flush();
+  size_t start = buf.size();
+  pp.print(out, entry->context, module);
+  // The trailer tells the client that all of the output was sent.
+  size_t printed = buf.size() - start;
+  out << "end " << printed << "\n";
+  out.flush();
+
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - begin)
+                .count();
+  std::lock_guard<std::mutex> logLock(logMutex);
+  LOG_INFO << "Printed module " << request->module << " of " << request->ir
+           << " in " << ms << " ms\n";
+}
+
+} // namespace
+
+int runPrintServer(const std::string& socketPath,
+                   const gtirb_pprint::PrettyPrinter& config,
+                   unsigned workers, size_t cacheSize) {
+  // Clients closing the connection early must not stop the server.
+  std::signal(SIGPIPE, SIG_IGN);
+
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(addr.sun_path)) {
+    LOG_ERROR << "Socket path too long: " << socketPath << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::memcpy(addr.sun_path, socketPath.c_str(), socketPath.size() + 1);
+  // Replace the socket of a previous server, but nothing else.
+  struct stat st;
+  if (::stat(socketPath.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+    ::unlink(socketPath.c_str());
+  int listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenFd < 0 ||
+      ::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) !=
+          0 ||
+      ::listen(listenFd, 64) != 0) {
+    LOG_ERROR << "Could not listen on " << socketPath << ": "
+              << std::strerror(errno) << std::endl;
+    if (listenFd >= 0)
+      ::close(listenFd);
+    return EXIT_FAILURE;
+  }
+  LOG_INFO << "Serving on " << socketPath << std::endl;
+
+  IRCache cache(cacheSize);
+  std::mutex queueMutex;
+  std::condition_variable ready;
+  std::deque<int> connections;
+  bool stopping = false;
+  std::vector<std::thread> pool;
+  for (unsigned i = 0; i < workers; ++i) {
+    pool.emplace_back([&]() {
+      for (;;) {
+        int fd;
+        {
+          std::unique_lock<std::mutex> lock(queueMutex);
+          ready.wait(lock,
+                     [&]() { return stopping || !connections.empty(); });
+          if (connections.empty())
+            return;
+          fd = connections.front();
+          connections.pop_front();
+        }
+        try {
+          serve(fd, cache, config);
+        } catch (const std::exception& e) {
+          std::lock_guard<std::mutex> logLock(logMutex);
+          LOG_ERROR << "Request failed: " << e.what() << std::endl;
+        }
+        ::close(fd);
+      }
+    });
+  }
+
+  for (;;) {
+    int fd = ::accept(listenFd, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      std::lock_guard<std::mutex> logLock(logMutex);
+      LOG_ERROR << "Could not accept connections: " << std::strerror(errno)
+                << std::endl;
+      break;
+    }
+    {
+      std::lock_guard<std::mutex> lock(queueMutex);
+      connections.push_back(fd);
+    }
+    ready.notify_one();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    stopping = true;
+  }
+  ready.notify_all();
+  for (std::thread& t : pool)
+    t.join();
+  ::close(listenFd);
+  ::unlink(socketPath.c_str());
+  return EXIT_FAILURE;
+}
+
+int runPrintClient(const std::string& socketPath,
+                   const PrintRequest& request, std::ostream& os) {
+  std::signal(SIGPIPE, SIG_IGN);
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(addr.sun_path)) {
+    LOG_ERROR << "Socket path too long: " << socketPath << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::memcpy(addr.sun_path, socketPath.c_str(), socketPath.size() + 1);
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 ||
+      ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+    LOG_ERROR << "Could not connect to " << socketPath << ": "
+              << std::strerror(errno) << std::endl;
+    if (fd >= 0)
+      ::close(fd);
+    return EXIT_FAILURE;
+  }
+
+  {
+    SocketBuf buf(fd);
+    std::ostream out(&buf);
+    out << "ir " << request.ir << "\nmodule " << request.module << '\n';
+    if (!request.format.empty())
+      out << "format " << request.format << '\n';
+    if (!request.syntax.empty())
+      out << "syntax " << request.syntax << '\n';
+    for (const std::string& name : request.functions)
+      out << "function " << name << '\n';
+    for (const std::string& name : request.sections)
+      out << "section " << name << '\n';
+    out << '\n';
+  }
+
+  // Copy the output as it arrives, once the status line is read. The last
+  // bytes are held back until the trailer can be told from the output.
+  static const size_t MaxTrailerSize = 32;
+  std::string status;
+  std::string tail;
+  size_t copied = 0;
+  bool ok = false;
+  char chunk[1 << 16];
+  for (;;) {
+    ssize_t got = ::recv(fd, chunk, sizeof(chunk), 0);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got <= 0)
+      break;
+    const char* data = chunk;
+    size_t size = got;
+    if (!ok) {
+      const char* newline =
+          static_cast<const char*>(std::memchr(data, '\n', size));
+      if (!newline) {
+        status.append(data, size);
+        continue;
+      }
+      status.append(data, newline);
+      if (status != "ok")
+        break;
+      ok = true;
+      size -= newline + 1 - data;
+      data = newline + 1;
+    }
+    tail.append(data, size);
+    if (tail.size() > MaxTrailerSize) {
+      size_t ready = tail.size() - MaxTrailerSize;
+      os.write(tail.data(), ready);
+      tail.erase(0, ready);
+      copied += ready;
+    }
+  }
+  ::close(fd);
+  if (!ok) {
+    const std::string prefix = "error ";
+    if (status.compare(0, prefix.size(), prefix) == 0)
+      status.erase(0, prefix.size());
+    LOG_ERROR << (status.empty() ? "No answer from the server" : status)
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // The trailer is "end N\n", where N is where it starts in the output.
+  std::optional<size_t> end;
+  for (size_t pos = 0; pos < tail.size() && !end; ++pos) {
+    if (tail.compare(pos, std::string::npos,
+                     "end " + std::to_string(copied + pos) + "\n") == 0)
+      end = pos;
+  }
+  if (!end) {
+    LOG_ERROR << "The server did not send all of the output" << std::endl;
+    return EXIT_FAILURE;
+  }
+  os.write(tail.data(), *end);
+  os.flush();
+  return os ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif // _WIN32
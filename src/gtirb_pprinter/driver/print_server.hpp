@@ -0,0 +1,40 @@
+#pragma once
+
+#include <gtirb_pprinter/PrettyPrinter.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/// A request to a print server: what a gtirb-pprinter run printing one
+/// module to the standard output would be given.
+///
+/// On the socket, a request is a line per field, written as the field name,
+/// a space and the value (`function` and `section` may be repeated),
+/// followed by an empty line. The server answers with a line holding `ok`,
+/// followed by the assembly and a trailer line `end N`, where N is the size
+/// of the assembly in bytes, or with a line holding `error` and a message.
+/// An answer without the trailer is incomplete. A request that is not sent
+/// in full within 10 seconds of connecting is answered with `error
+/// timeout`.
+struct PrintRequest {
+  std::string ir;
+  int module = 0;
+  std::string format;
+  std::string syntax;
+  std::vector<std::string> functions;
+  std::vector<std::string> sections;
+};
+
+/// Serve print requests on the Unix domain socket at \p socketPath with
+/// \p workers threads, until the process is stopped. The last
+/// \p cacheSize IRs requested are kept loaded, together with the indexes
+/// of their modules, and reloaded when their file changes. The requests are
+/// printed with the options of \p config.
+int runPrintServer(const std::string& socketPath,
+                   const gtirb_pprint::PrettyPrinter& config,
+                   unsigned workers, size_t cacheSize);
+
+/// Send \p request to the server at \p socketPath and copy the assembly to
+/// \p os as it arrives. Fail if the server did not send all of it.
+int runPrintClient(const std::string& socketPath,
+                   const PrintRequest& request, std::ostream& os);
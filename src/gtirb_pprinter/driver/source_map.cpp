@@ -0,0 +1,84 @@
+#include "Logger.h"
+#include <boost/program_options.hpp>
+#include <boost/uuid/uuid_io.hpp>
+#include <gtirb_pprinter/SourceMap.hpp>
+#include <iostream>
+
+namespace po = boost::program_options;
+
+static void printEntry(const gtirb_pprint::SourceMap& map,
+                       const gtirb_pprint::SourceMap::Entry& entry) {
+  std::cout << "line " << entry.line << ", offset " << entry.offset
+            << ": address " << std::hex << std::showbase << entry.address
+            << std::dec << std::noshowbase << ", block " << entry.block;
+  if (entry.function != gtirb_pprint::SourceMap::NoFunction &&
+      entry.function < map.functions.size())
+    std::cout << ", function " << map.functions[entry.function];
+  std::cout << '\n';
+}
+
+int main(int argc, char** argv) {
+  po::options_description desc("Allowed options");
+  desc.add_options()("help,h", "Produce help message.");
+  desc.add_options()("map", po::value<std::string>(),
+                     "The source map written by gtirb-pprinter --source-map.");
+  desc.add_options()("line,l", po::value<std::vector<uint64_t>>(),
+                     "Find the address printed at this assembly line.");
+  desc.add_options()("offset,o", po::value<std::vector<uint64_t>>(),
+                     "Find the address printed at this byte offset of the "
+                     "assembly file.");
+  desc.add_options()("address,a", po::value<std::vector<std::string>>(),
+                     "Find the assembly line where this address is printed.");
+  po::positional_options_description pd;
+  pd.add("map", 1);
+  po::variables_map vm;
+  try {
+    po::store(
+        po::command_line_parser(argc, argv).options(desc).positional(pd).run(),
+        vm);
+    if (vm.count("help") != 0 || vm.count("map") == 0) {
+      std::cout << desc << "\n";
+      return 1;
+    }
+  } catch (std::exception& e) {
+    std::cerr << "Error: " << e.what() << "\nTry '" << argv[0]
+              << " --help' for more information.\n";
+    return 1;
+  }
+  po::notify(vm);
+
+  const std::string& path = vm["map"].as<std::string>();
+  std::optional<gtirb_pprint::SourceMap> map =
+      gtirb_pprint::SourceMap::load(path);
+  if (!map) {
+    LOG_ERROR << "Could not read the source map " << path << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  bool found = true;
+  auto print = [&](const gtirb_pprint::SourceMap::Entry* entry) {
+    if (entry)
+      printEntry(*map, *entry);
+    else
+      std::cout << "not found\n";
+    found = found && entry;
+  };
+  if (vm.count("line") != 0)
+    for (uint64_t line : vm["line"].as<std::vector<uint64_t>>())
+      print(map->findByLine(line));
+  if (vm.count("offset") != 0)
+    for (uint64_t offset : vm["offset"].as<std::vector<uint64_t>>())
+      print(map->findByOffset(offset));
+  if (vm.count("address") != 0) {
+    for (const std::string& address :
+         vm["address"].as<std::vector<std::string>>()) {
+      try {
+        print(map->findByAddress(std::stoull(address, nullptr, 0)));
+      } catch (const std::logic_error&) {
+        LOG_ERROR << "Invalid address '" << address << "'" << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+  return found ? EXIT_SUCCESS : EXIT_FAILURE;
+}
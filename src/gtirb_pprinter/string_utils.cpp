@@ -31,3 +31,9 @@ std::string ascii_str_toupper(std::string s) {
   });
   return s;
 }
+
+std::ostream& ascii_write_lower(std::ostream& os, const char* s) {
+  for (; *s != '\0'; ++s)
+    os.put(static_cast<char>(std::tolower(static_cast<unsigned char>(*s))));
+  return os;
+}
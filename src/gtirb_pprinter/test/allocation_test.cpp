@@ -0,0 +1,139 @@
+//===- allocation_test.cpp --------------------------------------*- C++ -*-===//
+//
+//  Copyright (C) 2020 GrammaTech, Inc.
+//
+//  This code is licensed under the MIT license. See the LICENSE file in the
+//  project root for license terms.
+//
+//  This project is sponsored by the Office of Naval Research, One Liberty
+//  Center, 875 N. Randolph Street, Arlington, VA 22203 under contract #
+//  N68335-17-C-0700.  The content of the information does not necessarily
+//  reflect the position or policy of the Government and no official
+//  endorsement should be inferred.
+//
+//===----------------------------------------------------------------------===//
+
+#include <gtirb_pprinter/PrettyPrinter.hpp>
+#include <boost/filesystem.hpp>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+// Printing an instruction should not allocate: a module with twice the
+// instructions is printed with about the same number of allocations.
+
+static uint64_t allocations = 0;
+
+void* operator new(std::size_t size) {
+  ++allocations;
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete[](void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+// Discards the output, without allocating.
+class NullBuf : public std::streambuf {
+protected:
+  int_type overflow(int_type c) override { return traits_type::not_eof(c); }
+  std::streamsize xsputn(const char*, std::streamsize n) override {
+    return n;
+  }
+};
+
+struct TestModule {
+  gtirb::Context context;
+  gtirb::Module* module;
+};
+
+// Return a module with one code block repeating a few instructions that
+// have no symbolic operands \p repeat times.
+std::unique_ptr<TestModule> makeModule(size_t repeat) {
+  // mov eax, ebx; add rax, 8; push rbp; pop rbp; xor ecx, ecx
+  static const uint8_t pattern[] = {0x89, 0xd8, 0x48, 0x83, 0xc0, 0x08,
+                                    0x55, 0x5d, 0x31, 0xc9};
+  std::vector<uint8_t> bytes;
+  for (size_t i = 0; i < repeat; ++i)
+    bytes.insert(bytes.end(), std::begin(pattern), std::end(pattern));
+
+  auto test = std::make_unique<TestModule>();
+  gtirb::IR* ir = gtirb::IR::Create(test->context);
+  test->module = ir->addModule(test->context, "test");
+  test->module->setISA(gtirb::ISA::X64);
+  test->module->setFileFormat(gtirb::FileFormat::ELF);
+  gtirb::Section* section = test->module->addSection(test->context, ".text");
+  gtirb::ByteInterval* interval = section->addByteInterval(
+      test->context, gtirb::Addr(0x1000), bytes.begin(), bytes.end());
+  interval->addBlock<gtirb::CodeBlock>(test->context, 0, bytes.size());
+  return test;
+}
+
+uint64_t countAllocations(const gtirb_pprint::PrettyPrinter& pp,
+                          TestModule& test) {
+  NullBuf buf;
+  std::ostream os(&buf);
+  uint64_t before = allocations;
+  pp.print(os, test.context, *test.module);
+  return allocations - before;
+}
+
+int failures = 0;
+
+// Print modules of 2000 and 4000 instructions with \p pp, after printing
+// one to set up what is set up once.
+void check(const std::string& name, const gtirb_pprint::PrettyPrinter& pp,
+           const std::function<void()>& beforeEach = [] {}) {
+  const size_t repeat = 400;
+  auto warmup = makeModule(repeat);
+  auto small = makeModule(repeat);
+  auto large = makeModule(2 * repeat);
+  beforeEach();
+  countAllocations(pp, *warmup);
+  beforeEach();
+  uint64_t smallCount = countAllocations(pp, *small);
+  beforeEach();
+  uint64_t largeCount = countAllocations(pp, *large);
+  // Buffers growing to the size of the output may allocate a few times.
+  if (largeCount > smallCount + 16) {
+    std::cerr << "FAILED: " << name << ": " << smallCount
+              << " allocations for " << 5 * repeat << " instructions, "
+              << largeCount << " for " << 10 * repeat << "\n";
+    ++failures;
+  }
+}
+} // namespace
+
+int main() {
+  gtirb_pprint::registerAuxDataTypes();
+
+  gtirb_pprint::PrettyPrinter pp;
+  pp.setTarget({"elf", "intel"});
+  check("render cache", pp);
+
+  gtirb_pprint::PrettyPrinter uncached = pp;
+  uncached.setRenderCacheSize(0);
+  check("no render cache", uncached);
+
+  // A new output cache for each print, so that no block is found in it.
+  namespace fs = boost::filesystem;
+  fs::path dir = fs::temp_directory_path() / fs::unique_path();
+  gtirb_pprint::PrettyPrinter outputCached = pp;
+  check("output cache", outputCached, [&]() {
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    outputCached.setOutputCacheDir(dir.string());
+  });
+  fs::remove_all(dir);
+
+  return failures == 0 ? 0 : 1;
+}
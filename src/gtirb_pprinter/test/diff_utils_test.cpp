@@ -0,0 +1,75 @@
+//===- diff_utils_test.cpp --------------------------------------*- C++ -*-===//
+//
+//  Copyright (C) 2020 GrammaTech, Inc.
+//
+//  This code is licensed under the MIT license. See the LICENSE file in the
+//  project root for license terms.
+//
+//  This project is sponsored by the Office of Naval Research, One Liberty
+//  Center, 875 N. Randolph Street, Arlington, VA 22203 under contract #
+//  N68335-17-C-0700.  The content of the information does not necessarily
+//  reflect the position or policy of the Government and no official
+//  endorsement should be inferred.
+//
+//===----------------------------------------------------------------------===//
+
+#include "diff_utils.hpp"
+#include <iostream>
+#include <sstream>
+
+// The expected outputs are the ones of Python's difflib.unified_diff.
+
+static int failures = 0;
+
+static void checkDiff(const std::string& name, const std::string& a,
+                      const std::string& b, const std::string& expected) {
+  std::ostringstream os;
+  write_unified_diff(os, split_lines(a), split_lines(b), "a/f", "b/f");
+  if (os.str() != expected) {
+    std::cerr << "FAILED: " << name << "\nexpected:\n"
+              << expected << "got:\n"
+              << os.str();
+    ++failures;
+  }
+}
+
+// Return the lines "l<first>" to "l<last>", with the lines in \p changed
+// replaced by "m<line>".
+static std::string numberedLines(int first, int last,
+                                 std::initializer_list<int> changed = {}) {
+  std::ostringstream os;
+  for (int i = first; i <= last; ++i) {
+    bool isChanged = false;
+    for (int c : changed)
+      isChanged = isChanged || c == i;
+    os << (isChanged ? 'm' : 'l') << i << '\n';
+  }
+  return os.str();
+}
+
+int main() {
+  checkDiff("equal", "a\nb\n", "a\nb\n", "");
+  checkDiff("replaced line", "a\nb\nc\n", "a\nx\nc\n",
+            "--- a/f\n+++ b/f\n"
+            "@@ -1,3 +1,3 @@\n a\n-b\n+x\n c\n");
+  checkDiff("added file", "", "x\ny\n",
+            "--- a/f\n+++ b/f\n"
+            "@@ -0,0 +1,2 @@\n+x\n+y\n");
+  checkDiff("removed file", "x\ny\n", "",
+            "--- a/f\n+++ b/f\n"
+            "@@ -1,2 +0,0 @@\n-x\n-y\n");
+  checkDiff("two hunks", numberedLines(1, 20), numberedLines(1, 20, {2, 19}),
+            "--- a/f\n+++ b/f\n"
+            "@@ -1,5 +1,5 @@\n l1\n-l2\n+m2\n l3\n l4\n l5\n"
+            "@@ -16,5 +16,5 @@\n l16\n l17\n l18\n-l19\n+m19\n l20\n");
+  checkDiff("merged hunk",
+            "l1\nl2\nl3\nl4\nl5\nl6\nl7\nl8\nl9\nl10\n",
+            "l1\nl2\nl3\nl4\nl6\nl7\nl8\nl9\nnew\nl10\n",
+            "--- a/f\n+++ b/f\n"
+            "@@ -2,9 +2,9 @@\n l2\n l3\n l4\n-l5\n l6\n l7\n l8\n l9\n+new\n"
+            " l10\n");
+  checkDiff("last line without a newline", "a\nb", "a\nc",
+            "--- a/f\n+++ b/f\n"
+            "@@ -1,2 +1,2 @@\n a\n-b\n+c\n");
+  return failures == 0 ? 0 : 1;
+}
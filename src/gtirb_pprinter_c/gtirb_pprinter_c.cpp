@@ -0,0 +1,463 @@
+//===- gtirb_pprinter_c.cpp -------------------------------------*- C++ -*-===//
+//
+//  Copyright (C) 2020 GrammaTech, Inc.
+//
+//  This code is licensed under the MIT license. See the LICENSE file in the
+//  project root for license terms.
+//
+//  This project is sponsored by the Office of Naval Research, One Liberty
+//  Center, 875 N. Randolph Street, Arlington, VA 22203 under contract #
+//  N68335-17-C-0700.  The content of the information does not necessarily
+//  reflect the position or policy of the Government and no official
+//  endorsement should be inferred.
+//
+//===----------------------------------------------------------------------===//
+#include "gtirb_pprinter.h"
+
+#include "ElfBinaryPrinter.hpp"
+#include "PrettyPrinter.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#define write _write
+#else
+#include <unistd.h>
+#endif
+
+struct gtirb_pprint_ir {
+  std::unique_ptr<gtirb::Context> ownedContext;
+  gtirb::Context* context = nullptr;
+  gtirb::IR* ir = nullptr;
+  std::vector<gtirb::Module*> modules;
+  std::vector<std::shared_ptr<const gtirb_pprint::ModuleIndex>> indexes;
+};
+
+struct gtirb_pprint_session {
+  gtirb_pprint::PrettyPrinter pp;
+  bool debug = false;
+};
+
+namespace {
+
+thread_local std::string lastError;
+
+int fail(std::string message) {
+  lastError = std::move(message);
+  return -1;
+}
+
+// Return what body returns, or onError if it throws. No exception may
+// cross the C interface.
+template <typename Result, typename Body>
+Result guard(Result onError, Body body) {
+  try {
+    return body();
+  } catch (const std::exception& e) {
+    fail(e.what());
+  } catch (...) {
+    fail("unknown error");
+  }
+  return onError;
+}
+
+void registerTypes() {
+  static std::once_flag once;
+  std::call_once(once, gtirb_pprint::registerAuxDataTypes);
+}
+
+gtirb_pprint_ir* wrap(std::unique_ptr<gtirb_pprint_ir> handle) {
+  for (gtirb::Module& m : handle->ir->modules())
+    handle->modules.push_back(&m);
+  handle->indexes.resize(handle->modules.size());
+  return handle.release();
+}
+
+// Load the IR with \p read, which is given the context to allocate it in.
+template <typename ReadIR> gtirb_pprint_ir* load(ReadIR read) {
+  registerTypes();
+  auto handle = std::make_unique<gtirb_pprint_ir>();
+  handle->ownedContext = std::make_unique<gtirb::Context>();
+  handle->context = handle->ownedContext.get();
+  handle->ir = read(*handle->context);
+  if (!handle->ir) {
+    lastError = "could not read the IR";
+    return nullptr;
+  }
+  return wrap(std::move(handle));
+}
+
+// Index the module, with computed addresses if it has none, and return it,
+// or null if there is no such module or it cannot be laid out.
+gtirb::Module* prepare(gtirb_pprint_ir* ir, int module) {
+  if (module < 0 || module >= static_cast<int>(ir->modules.size())) {
+    fail("the IR has " + std::to_string(ir->modules.size()) +
+         " modules, module with index " + std::to_string(module) +
+         " cannot be printed");
+    return nullptr;
+  }
+  gtirb::Module& m = *ir->modules[module];
+  auto& index = ir->indexes[module];
+  if (!index)
+    index = std::make_shared<const gtirb_pprint::ModuleIndex>(*ir->context, m);
+  if (!index->laidOut) {
+    fail("module with index " + std::to_string(module) +
+         " cannot be laid out");
+    return nullptr;
+  }
+  return &m;
+}
+
+int print(gtirb_pprint_session* session, gtirb_pprint_ir* ir, int module,
+          std::ostream& os) {
+  gtirb::Module* m = prepare(ir, module);
+  if (!m)
+    return -1;
+  gtirb_pprint::PrettyPrinter pp(session->pp);
+  pp.setModuleIndex(ir->indexes[module]);
+  std::error_condition ec = pp.print(os, *ir->context, *m);
+  if (ec)
+    return fail("could not print module " + std::to_string(module) + ": " +
+                ec.message());
+  if (!os)
+    return fail("could not write the output");
+  return 0;
+}
+
+// A stream buffer writing its output to a file descriptor.
+class FdBuf : public std::streambuf {
+public:
+  explicit FdBuf(int fd_) : fd(fd_) { setp(buffer, buffer + sizeof(buffer)); }
+  ~FdBuf() override { flush(); }
+
+protected:
+  int_type overflow(int_type c) override {
+    if (!flush())
+      return traits_type::eof();
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+  int sync() override { return flush() ? 0 : -1; }
+
+private:
+  bool flush() {
+    const char* p = pbase();
+    while (p < pptr()) {
+      auto n = ::write(fd, p, static_cast<unsigned>(pptr() - p));
+      if (n <= 0)
+        return false;
+      p += n;
+    }
+    setp(buffer, buffer + sizeof(buffer));
+    return true;
+  }
+
+  int fd;
+  char buffer[1 << 14];
+};
+
+// A stream buffer writing its output into a buffer allocated with malloc,
+// which grows as needed and is then handed to the caller.
+class MallocBuf : public std::streambuf {
+public:
+  ~MallocBuf() override { std::free(buffer); }
+
+  // Return the buffer, with a NUL byte after the text, and set size to the
+  // size of the text. The caller frees the buffer. Return null if there is
+  // no memory left.
+  char* release(size_t& size) {
+    size = pptr() - pbase();
+    if (!reserve(size + 1))
+      return nullptr;
+    buffer[size] = '\0';
+    char* result = buffer;
+    buffer = nullptr;
+    capacity = 0;
+    setp(nullptr, nullptr);
+    return result;
+  }
+
+protected:
+  int_type overflow(int_type c) override {
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+      return traits_type::not_eof(c);
+    if (!reserve(pptr() - pbase() + 1))
+      return traits_type::eof();
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+    return c;
+  }
+
+private:
+  // Make room for at least needed bytes, doubling the capacity.
+  bool reserve(size_t needed) {
+    if (needed <= capacity)
+      return true;
+    size_t used = pptr() - pbase();
+    size_t grown = std::max(needed, std::max<size_t>(capacity * 2, 1 << 16));
+    char* p = static_cast<char*>(std::realloc(buffer, grown));
+    if (!p)
+      return false;
+    buffer = p;
+    capacity = grown;
+    setp(buffer, buffer + capacity);
+    // pbump takes an int, which a large output does not fit in.
+    for (size_t left = used; left > 0;) {
+      int step = static_cast<int>(
+          std::min<size_t>(left, std::numeric_limits<int>::max()));
+      pbump(step);
+      left -= step;
+    }
+    return true;
+  }
+
+  char* buffer = nullptr;
+  size_t capacity = 0;
+};
+
+} // namespace
+
+extern "C" {
+
+const char* gtirb_pprint_last_error(void) { return lastError.c_str(); }
+
+gtirb_pprint_ir* gtirb_pprint_ir_load(const char* path) {
+  if (!path) {
+    fail("a path is needed");
+    return nullptr;
+  }
+  return guard<gtirb_pprint_ir*>(nullptr, [&]() -> gtirb_pprint_ir* {
+    // The file is read as a stream rather than mapped, so that the host
+    // process is not killed with SIGBUS if the file is rewritten meanwhile.
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if (!in) {
+      fail(std::string(path) + ": could not open the file");
+      return nullptr;
+    }
+    return load([&in](gtirb::Context& context) {
+      return gtirb::IR::load(context, in);
+    });
+  });
+}
+
+gtirb_pprint_ir* gtirb_pprint_ir_load_buffer(const void* data, size_t size) {
+  if (!data && size != 0) {
+    fail("a buffer is needed");
+    return nullptr;
+  }
+  return guard<gtirb_pprint_ir*>(nullptr, [&]() {
+    std::istringstream in(
+        std::string(static_cast<const char*>(data), size),
+        std::ios::in | std::ios::binary);
+    return load([&in](gtirb::Context& context) {
+      return gtirb::IR::load(context, in);
+    });
+  });
+}
+
+gtirb_pprint_ir* gtirb_pprint_ir_borrow(void* context, void* ir) {
+  if (!context || !ir) {
+    fail("a context and an IR are needed");
+    return nullptr;
+  }
+  return guard<gtirb_pprint_ir*>(nullptr, [&]() {
+    registerTypes();
+    auto handle = std::make_unique<gtirb_pprint_ir>();
+    handle->context = static_cast<gtirb::Context*>(context);
+    handle->ir = static_cast<gtirb::IR*>(ir);
+    return wrap(std::move(handle));
+  });
+}
+
+void gtirb_pprint_ir_free(gtirb_pprint_ir* ir) { delete ir; }
+
+int gtirb_pprint_ir_module_count(const gtirb_pprint_ir* ir) {
+  if (!ir)
+    return fail("an IR is needed");
+  return static_cast<int>(ir->modules.size());
+}
+
+const char* gtirb_pprint_ir_module_name(const gtirb_pprint_ir* ir,
+                                        int module) {
+  if (!ir) {
+    fail("an IR is needed");
+    return nullptr;
+  }
+  if (module < 0 || module >= static_cast<int>(ir->modules.size())) {
+    fail("no module with index " + std::to_string(module));
+    return nullptr;
+  }
+  return ir->modules[module]->getName().c_str();
+}
+
+gtirb_pprint_session* gtirb_pprint_session_create(void) {
+  return guard<gtirb_pprint_session*>(nullptr, []() {
+    registerTypes();
+    return new gtirb_pprint_session;
+  });
+}
+
+void gtirb_pprint_session_free(gtirb_pprint_session* session) {
+  delete session;
+}
+
+int gtirb_pprint_session_set_target(gtirb_pprint_session* session,
+                                    const char* format, const char* syntax) {
+  if (!session)
+    return fail("a session is needed");
+  return guard(-1, [&]() {
+    const std::string f = format ? format : "";
+    std::string s = syntax ? syntax : "";
+    if (f.empty()) {
+      if (!s.empty())
+        return fail("a syntax needs a format");
+      session->pp.setFormat("");
+      return 0;
+    }
+    if (s.empty())
+      s = gtirb_pprint::getDefaultSyntax(f).value_or("");
+    auto target = std::make_tuple(f, s);
+    if (gtirb_pprint::getRegisteredTargets().count(target) == 0)
+      return fail("unsupported combination: format '" + f +
+                  "' and syntax '" + s + "'");
+    session->pp.setTarget(std::move(target));
+    return 0;
+  });
+}
+
+int gtirb_pprint_session_select_function(gtirb_pprint_session* session,
+                                         const char* name) {
+  if (!session || !name)
+    return fail("a session and a name are needed");
+  return guard(-1, [&]() {
+    session->pp.selectFunction(name);
+    return 0;
+  });
+}
+
+int gtirb_pprint_session_select_section(gtirb_pprint_session* session,
+                                        const char* name) {
+  if (!session || !name)
+    return fail("a session and a name are needed");
+  return guard(-1, [&]() {
+    session->pp.selectSection(name);
+    return 0;
+  });
+}
+
+int gtirb_pprint_session_skip_function(gtirb_pprint_session* session,
+                                       const char* name) {
+  if (!session || !name)
+    return fail("a session and a name are needed");
+  return guard(-1, [&]() {
+    session->pp.skipFunction(name);
+    return 0;
+  });
+}
+
+int gtirb_pprint_session_keep_function(gtirb_pprint_session* session,
+                                       const char* name) {
+  if (!session || !name)
+    return fail("a session and a name are needed");
+  return guard(-1, [&]() {
+    session->pp.keepFunction(name);
+    return 0;
+  });
+}
+
+int gtirb_pprint_session_set_minimal(gtirb_pprint_session* session,
+                                     int minimal) {
+  if (!session)
+    return fail("a session is needed");
+  session->pp.setMinimal(minimal != 0);
+  return 0;
+}
+
+int gtirb_pprint_session_set_debug(gtirb_pprint_session* session,
+                                   int debug) {
+  if (!session)
+    return fail("a session is needed");
+  session->debug = debug != 0;
+  session->pp.setDebug(session->debug);
+  return 0;
+}
+
+int gtirb_pprint_session_set_passthrough(gtirb_pprint_session* session,
+                                         int passthrough, int comments) {
+  if (!session)
+    return fail("a session is needed");
+  session->pp.setPassthrough(passthrough != 0, comments != 0);
+  return 0;
+}
+
+int gtirb_pprint_print(gtirb_pprint_session* session, gtirb_pprint_ir* ir,
+                       int module, char** text, size_t* size) {
+  if (!session || !ir || !text)
+    return fail("a session, an IR and a text pointer are needed");
+  return guard(-1, [&]() {
+    MallocBuf buf;
+    std::ostream os(&buf);
+    if (print(session, ir, module, os) != 0)
+      return -1;
+    size_t length;
+    char* buffer = buf.release(length);
+    if (!buffer)
+      return fail("out of memory");
+    *text = buffer;
+    if (size)
+      *size = length;
+    return 0;
+  });
+}
+
+int gtirb_pprint_print_fd(gtirb_pprint_session* session, gtirb_pprint_ir* ir,
+                          int module, int fd) {
+  if (!session || !ir)
+    return fail("a session and an IR are needed");
+  return guard(-1, [&]() {
+    FdBuf buf(fd);
+    std::ostream os(&buf);
+    if (print(session, ir, module, os) != 0)
+      return -1;
+    if (!os.flush())
+      return fail("could not write the output");
+    return 0;
+  });
+}
+
+int gtirb_pprint_link(gtirb_pprint_session* session, gtirb_pprint_ir* ir,
+                      const char* output, const char* const* compilerArgs,
+                      size_t argCount) {
+  if (!session || !ir || !output || (!compilerArgs && argCount != 0))
+    return fail("a session, an IR and an output are needed");
+  for (size_t i = 0; i < argCount; ++i)
+    if (!compilerArgs[i])
+      return fail("compiler argument " + std::to_string(i) + " is NULL");
+  return guard(-1, [&]() {
+    gtirb_bprint::ElfBinaryPrinter binaryPrinter(session->debug);
+    std::vector<std::string> args(compilerArgs, compilerArgs + argCount);
+    if (binaryPrinter.link(output, args, {}, session->pp, *ir->context,
+                           *ir->ir) != 0)
+      return fail(std::string("could not build ") + output);
+    return 0;
+  });
+}
+
+void gtirb_pprint_free(void* buffer) { std::free(buffer); }
+
+} // extern "C"
@@ -1,3 +1,4 @@
+import json
 import unittest
 from pathlib import Path
 import subprocess
@@ -24,3 +25,56 @@ class TestBinaryGeneration(unittest.TestCase):
             sys.stdout.encoding
         )
         self.assertTrue("!!!Hello World!!!" in output_bin)
+
+    def test_generate_binary_releasing_modules(self):
+        output = subprocess.check_output(
+            [
+                "gtirb-binary-printer",
+                "--ir",
+                str(two_modules_gtirb),
+                "-b",
+                "/tmp/two_modules_released",
+                "--release-modules",
+                "--compiler-args",
+                "-no-pie",
+            ]
+        ).decode(sys.stdout.encoding)
+        # The libraries are still passed to the compiler.
+        self.assertTrue("Calling compiler" in output)
+        output_bin = subprocess.check_output(
+            "/tmp/two_modules_released"
+        ).decode(sys.stdout.encoding)
+        self.assertTrue("!!!Hello World!!!" in output_bin)
+
+
+class TestEstimate(unittest.TestCase):
+    def test_estimate_includes_compile_step(self):
+        def estimate(printer):
+            output = subprocess.check_output(
+                [printer, "--ir", str(two_modules_gtirb), "--estimate"]
+            ).decode(sys.stdout.encoding)
+            return [
+                json.loads(line)
+                for line in output.splitlines()
+                if line.startswith("{")
+            ]
+
+        *modules, total = estimate("gtirb-binary-printer")
+        *print_modules, print_total = estimate("gtirb-pprinter")
+        for module in modules:
+            self.assertGreater(module["assemble_seconds"], 0)
+            self.assertGreater(module["assemble_memory_bytes"], 0)
+        self.assertGreater(total["link_seconds"], 0)
+        self.assertGreater(total["link_memory_bytes"], 0)
+        self.assertAlmostEqual(
+            total["seconds"],
+            print_total["seconds"]
+            + total["assemble_seconds"]
+            + total["link_seconds"],
+            # The values are written with six significant digits.
+            delta=total["seconds"] * 1e-4,
+        )
+        self.assertGreaterEqual(
+            total["peak_memory_bytes"], print_total["peak_memory_bytes"]
+        )
+        self.assertNotIn("link_seconds", print_total)
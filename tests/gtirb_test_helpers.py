@@ -0,0 +1,137 @@
+"""Build small GTIRB files for the end-to-end tests, and print them."""
+import os
+import subprocess
+import sys
+import tempfile
+import uuid
+
+import gtirb
+
+ProgramSectionFlags = {
+    gtirb.Section.Flag.Readable,
+    gtirb.Section.Flag.Executable,
+    gtirb.Section.Flag.Loaded,
+    gtirb.Section.Flag.Initialized,
+}
+DataSectionFlags = {
+    gtirb.Section.Flag.Readable,
+    gtirb.Section.Flag.Writable,
+    gtirb.Section.Flag.Loaded,
+    gtirb.Section.Flag.Initialized,
+}
+BssSectionFlags = {
+    gtirb.Section.Flag.Readable,
+    gtirb.Section.Flag.Writable,
+    gtirb.Section.Flag.Loaded,
+}
+
+
+def create_test_module(
+    isa=gtirb.Module.ISA.X64, file_format=gtirb.Module.FileFormat.ELF
+):
+    """Return a new IR holding one empty module, and the module."""
+    ir = gtirb.IR()
+    module = gtirb.Module(name="test", isa=isa, file_format=file_format, ir=ir)
+    for name in ["functionBlocks", "functionEntries"]:
+        module.aux_data[name] = gtirb.AuxData(
+            type_name="mapping<UUID,set<UUID>>", data={}
+        )
+    module.aux_data["encodings"] = gtirb.AuxData(
+        type_name="mapping<UUID,string>", data={}
+    )
+    return ir, module
+
+
+def add_section(module, name, address, flags=ProgramSectionFlags):
+    """Add a section with a single byte interval at address."""
+    section = gtirb.Section(name=name, flags=flags, module=module)
+    byte_interval = gtirb.ByteInterval(address=address, section=section)
+    return section, byte_interval
+
+
+def add_byte_block(
+    byte_interval, block_type, content, symbolic_expressions=None
+):
+    """Append a block of the given type holding content to the interval.
+    The offsets of the symbolic expressions are relative to the block."""
+    block = block_type(offset=byte_interval.size, size=len(content))
+    block.byte_interval = byte_interval
+    old_size = byte_interval.size
+    byte_interval.size += len(content)
+    byte_interval.contents += content
+    for offset, expr in (symbolic_expressions or {}).items():
+        byte_interval.symbolic_expressions[old_size + offset] = expr
+    return block
+
+
+def add_code_block(byte_interval, content, symbolic_expressions=None):
+    return add_byte_block(
+        byte_interval, gtirb.CodeBlock, content, symbolic_expressions
+    )
+
+
+def add_data_block(byte_interval, content, symbolic_expressions=None):
+    return add_byte_block(
+        byte_interval, gtirb.DataBlock, content, symbolic_expressions
+    )
+
+
+def add_bss_block(byte_interval, size):
+    """Append an uninitialized data block of size bytes."""
+    block = gtirb.DataBlock(offset=byte_interval.size, size=size)
+    block.byte_interval = byte_interval
+    byte_interval.size += size
+    return block
+
+
+def add_symbol(module, name, payload=None, at_end=False):
+    symbol = gtirb.Symbol(name, payload=payload, at_end=at_end)
+    module.symbols.add(symbol)
+    return symbol
+
+
+def add_function(module, name, entry_block, other_blocks=()):
+    """Add a function and a symbol naming it at its entry block."""
+    symbol = add_symbol(module, name, entry_block)
+    function = uuid.uuid4()
+    module.aux_data["functionEntries"].data[function] = {entry_block}
+    module.aux_data["functionBlocks"].data[function] = {entry_block} | set(
+        other_blocks
+    )
+    return symbol
+
+
+def run_pprinter(ir, args=(), binary="gtirb-pprinter"):
+    """Save ir to a temporary file and return what the printer writes to
+    the standard output, failing if it fails."""
+    with tempfile.TemporaryDirectory() as tmpdir:
+        path = os.path.join(tmpdir, "test.gtirb")
+        ir.save_protobuf(path)
+        return subprocess.check_output(
+            [binary, "--ir", path, *args], cwd=tmpdir
+        ).decode(sys.stdout.encoding)
+
+
+def print_asm(ir, args=()):
+    """Return the assembly printed for the first module of ir."""
+    with tempfile.TemporaryDirectory() as tmpdir:
+        path = os.path.join(tmpdir, "test.gtirb")
+        asm = os.path.join(tmpdir, "test.s")
+        ir.save_protobuf(path)
+        subprocess.check_call(
+            ["gtirb-pprinter", "--ir", path, "--asm", asm, *args],
+            stdout=subprocess.DEVNULL,
+        )
+        with open(asm) as f:
+            return f.read()
+
+
+def assembles(asm_path, cwd=None):
+    """Return whether the assembler accepts the file at asm_path."""
+    obj = asm_path + ".o"
+    result = subprocess.run(
+        ["as", "-o", obj, asm_path], cwd=cwd, stderr=subprocess.PIPE
+    )
+    if os.path.exists(obj):
+        os.remove(obj)
+    return result.returncode == 0
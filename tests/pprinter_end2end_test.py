@@ -1,7 +1,12 @@
+import json
+import re
+import struct
 import unittest
 from pathlib import Path
 import subprocess
 import sys
+import tempfile
+import time
 
 two_modules_gtirb = Path("tests", "two_modules.gtirb")
 
@@ -37,3 +42,596 @@ class TestPrintToFile(unittest.TestCase):
             self.assertTrue(".globl main" in f.read())
         with open("/tmp/two_modules1.s", "r") as f:
             self.assertTrue(".globl fun" in f.read())
+
+    def test_print_two_modules_in_parallel(self):
+        with tempfile.TemporaryDirectory() as out_dir:
+            serial = Path(out_dir, "serial.s")
+            parallel = Path(out_dir, "parallel.s")
+            for path, jobs in ((serial, "1"), (parallel, "2")):
+                subprocess.check_output(
+                    [
+                        "gtirb-pprinter",
+                        "--ir",
+                        str(two_modules_gtirb),
+                        "--asm",
+                        str(path),
+                        "--jobs",
+                        jobs,
+                    ]
+                )
+            self.assertEqual(parallel.read_text(), serial.read_text())
+            self.assertEqual(
+                Path(out_dir, "parallel1.s").read_text(),
+                Path(out_dir, "serial1.s").read_text(),
+            )
+
+    def test_parallel_log_order(self):
+        with tempfile.TemporaryDirectory() as out_dir:
+            output = subprocess.check_output(
+                [
+                    "gtirb-pprinter",
+                    "--ir",
+                    str(two_modules_gtirb),
+                    "--asm",
+                    str(Path(out_dir, "two_modules.s")),
+                    "--jobs",
+                    "2",
+                ]
+            ).decode(sys.stdout.encoding)
+        # The modules are printed largest first, but logged in IR order.
+        logged = re.findall(r"Module (\d+)'s assembly written to", output)
+        self.assertEqual(logged, ["0", "1"])
+
+    def test_parallel_write_failure(self):
+        with tempfile.TemporaryDirectory() as out_dir:
+            result = subprocess.run(
+                [
+                    "gtirb-pprinter",
+                    "--ir",
+                    str(two_modules_gtirb),
+                    "--asm",
+                    str(Path(out_dir, "missing", "two_modules.s")),
+                    "--jobs",
+                    "2",
+                ],
+                stdout=subprocess.PIPE,
+            )
+        self.assertNotEqual(result.returncode, 0)
+        self.assertTrue(b"Could not output assembly" in result.stdout)
+
+    def test_parallel_caches(self):
+        def print_modules(out_dir, *args):
+            subprocess.check_output(
+                [
+                    "gtirb-pprinter",
+                    "--ir",
+                    str(two_modules_gtirb),
+                    "--asm",
+                    str(Path(out_dir, "two_modules.s")),
+                    *args,
+                ]
+            )
+            return [
+                Path(out_dir, name).read_text()
+                for name in ["two_modules.s", "two_modules1.s"]
+            ]
+
+        with tempfile.TemporaryDirectory() as out_dir:
+            expected = print_modules(out_dir, "--render-cache-size", "0")
+            with tempfile.TemporaryDirectory() as cache_dir:
+                # Both jobs fill the same caches at once, then read them.
+                caches = [
+                    "--jobs",
+                    "2",
+                    "--render-cache",
+                    str(Path(cache_dir, "render")),
+                    "--output-cache",
+                    str(Path(cache_dir, "output")),
+                    "--sidecar",
+                    str(Path(cache_dir, "sidecar")),
+                ]
+                for run in ["cold", "warm"]:
+                    with self.subTest(run=run):
+                        self.assertEqual(
+                            print_modules(out_dir, *caches), expected
+                        )
+
+
+class TestPrintBatch(unittest.TestCase):
+    def test_batch_with_bad_input(self):
+        with tempfile.TemporaryDirectory() as out_dir:
+            good = Path(out_dir, "good.s")
+            bad = Path(out_dir, "bad.s")
+            missing = Path(out_dir, "missing.gtirb")
+            manifest = Path(out_dir, "batch.txt")
+            manifest.write_text(
+                "# input output\n%s %s\n%s %s\n"
+                % (missing, bad, two_modules_gtirb, good)
+            )
+            result = subprocess.run(
+                ["gtirb-pprinter", "--batch", str(manifest), "--jobs", "2"],
+                stdout=subprocess.PIPE,
+            )
+            # The missing input fails without stopping the other job.
+            self.assertNotEqual(result.returncode, 0)
+            self.assertTrue(b"1 of 2 jobs succeeded" in result.stdout)
+            subprocess.check_output(
+                [
+                    "gtirb-pprinter",
+                    "--ir",
+                    str(two_modules_gtirb),
+                    "--asm",
+                    str(Path(out_dir, "single.s")),
+                ]
+            )
+            self.assertEqual(
+                good.read_text(), Path(out_dir, "single.s").read_text()
+            )
+            self.assertTrue(Path(out_dir, "good1.s").exists())
+
+
+class TestPrintIncbin(unittest.TestCase):
+    def test_incbin_output_assembles(self):
+        with tempfile.TemporaryDirectory() as tmpdir:
+            # The quote and the space must be escaped in the directives.
+            outdir = Path(tmpdir, 'out "dir"')
+            outdir.mkdir()
+            asm = outdir / "two_modules.s"
+            subprocess.check_output(
+                [
+                    "gtirb-pprinter",
+                    "--ir",
+                    str(two_modules_gtirb.resolve()),
+                    "--asm",
+                    str(asm),
+                    "--incbin",
+                    "--incbin-threshold",
+                    "0",
+                ],
+                cwd=tmpdir,
+            )
+            text = asm.read_text()
+            self.assertIn(".incbin", text)
+            self.assertNotRegex(text, r"\.incbin .*, 0\n")
+            # Assemble from another directory than the assembly file's.
+            obj = Path(tmpdir, "two_modules.o")
+            subprocess.check_call(["as", "-o", str(obj), str(asm)], cwd=tmpdir)
+            self.assertTrue(obj.exists())
+
+
+class TestPrintMinimal(unittest.TestCase):
+    def test_print_minimal(self):
+        full = subprocess.check_output(
+            ["gtirb-pprinter", "--ir", str(two_modules_gtirb), "-m", "0"]
+        ).decode(sys.stdout.encoding)
+        output = subprocess.check_output(
+            [
+                "gtirb-pprinter",
+                "--ir",
+                str(two_modules_gtirb),
+                "-m",
+                "0",
+                "--minimal",
+            ]
+        ).decode(sys.stdout.encoding)
+        self.assertTrue(".globl main" in output)
+        self.assertFalse("Function Header" in output)
+        self.assertFalse("=====" in output)
+        # Nothing is indented, instructions included.
+        self.assertNotRegex(output, r"(?m)^[ \t]")
+        self.assertRegex(output, r"(?m)^ret")
+        self.assertLess(len(output), len(full))
+
+
+class TestPrintCaches(unittest.TestCase):
+    def test_render_cache_reuse(self):
+        with tempfile.TemporaryDirectory() as cache_dir:
+            args = [
+                "gtirb-pprinter",
+                "--ir",
+                str(two_modules_gtirb),
+                "-m",
+                "0",
+                "--render-cache",
+                cache_dir,
+            ]
+            first = subprocess.check_output(args).decode(sys.stdout.encoding)
+            self.assertTrue(any(Path(cache_dir).iterdir()))
+            second = subprocess.check_output(args).decode(sys.stdout.encoding)
+            self.assertEqual(first, second)
+
+    def test_render_cache_does_not_change_output(self):
+        def pprint(*args):
+            return subprocess.check_output(
+                ["gtirb-pprinter", "--ir", str(two_modules_gtirb), *args]
+            ).decode(sys.stdout.encoding)
+
+        for syntax in ["intel", "att"]:
+            with self.subTest(syntax=syntax):
+                uncached = pprint(
+                    "-m", "0", "--syntax", syntax, "--render-cache-size", "0"
+                )
+                cached = pprint("-m", "0", "--syntax", syntax)
+                self.assertEqual(cached, uncached)
+                with tempfile.TemporaryDirectory() as cache_dir:
+                    # Fill the cache from the other module first.
+                    cache = ["--syntax", syntax, "--render-cache", cache_dir]
+                    pprint("-m", "1", *cache)
+                    self.assertEqual(pprint("-m", "0", *cache), uncached)
+
+    def test_concurrent_render_cache_updates_are_merged(self):
+        def run(cache_dir, modules):
+            procs = [
+                subprocess.Popen(
+                    [
+                        "gtirb-pprinter",
+                        "--ir",
+                        str(two_modules_gtirb),
+                        "-m",
+                        module,
+                        "--render-cache",
+                        cache_dir,
+                    ],
+                    stdout=subprocess.DEVNULL,
+                )
+                for module in modules
+            ]
+            for proc in procs:
+                self.assertEqual(proc.wait(), 0)
+            (cache,) = Path(cache_dir).glob("*.cache")
+            return cache.stat().st_size
+
+        with tempfile.TemporaryDirectory() as serial_dir:
+            run(serial_dir, ["0"])
+            serial = run(serial_dir, ["1"])
+            with tempfile.TemporaryDirectory() as concurrent_dir:
+                concurrent = run(concurrent_dir, ["0", "1"])
+        self.assertEqual(concurrent, serial)
+
+    def test_sidecar_reuse(self):
+        def pprint(*args):
+            return subprocess.check_output(
+                ["gtirb-pprinter", "--ir", str(two_modules_gtirb), *args]
+            ).decode(sys.stdout.encoding)
+
+        for syntax in ["intel", "att"]:
+            with self.subTest(syntax=syntax):
+                args = ["-m", "0", "--syntax", syntax]
+                uncached = pprint(*args, "--render-cache-size", "0")
+                with tempfile.TemporaryDirectory() as sidecar_dir:
+                    sidecar = [
+                        "--render-cache-size",
+                        "0",
+                        "--sidecar",
+                        sidecar_dir,
+                    ]
+                    # The shards merge their instructions into one file.
+                    for shard in ["0/2", "1/2"]:
+                        pprint(*args, *sidecar, "--shard", shard)
+                    files = list(Path(sidecar_dir).glob("*.sidecar"))
+                    self.assertEqual(len(files), 1)
+                    inode = files[0].stat().st_ino
+                    self.assertEqual(pprint(*args, *sidecar), uncached)
+                    # Nothing was missing, so the file was not rewritten.
+                    self.assertEqual(files[0].stat().st_ino, inode)
+
+    def test_output_cache_reuse(self):
+        with tempfile.TemporaryDirectory() as cache_dir:
+            args = [
+                "gtirb-pprinter",
+                "--ir",
+                str(two_modules_gtirb),
+                "-m",
+                "0",
+                "--output-cache",
+                cache_dir,
+            ]
+            first = subprocess.check_output(args).decode(sys.stdout.encoding)
+            self.assertTrue(any(Path(cache_dir).iterdir()))
+            second = subprocess.check_output(args).decode(sys.stdout.encoding)
+            self.assertEqual(first, second)
+
+
+class TestPrintSyntaxes(unittest.TestCase):
+    def test_print_att_and_intel(self):
+        with tempfile.TemporaryDirectory() as out_dir:
+            att = Path(out_dir, "att.s")
+            intel = Path(out_dir, "intel.s")
+            subprocess.check_output(
+                [
+                    "gtirb-pprinter",
+                    "--ir",
+                    str(two_modules_gtirb),
+                    "--asm-att",
+                    str(att),
+                    "--asm-intel",
+                    str(intel),
+                ]
+            )
+            # The instructions decoded once for both syntaxes print as
+            # when each syntax is printed alone.
+            for syntax, path in [("intel", intel), ("att", att)]:
+                single = subprocess.check_output(
+                    [
+                        "gtirb-pprinter",
+                        "--ir",
+                        str(two_modules_gtirb),
+                        "-m",
+                        "0",
+                        "--syntax",
+                        syntax,
+                    ]
+                ).decode(sys.stdout.encoding)
+                self.assertEqual(path.read_text(), single)
+            self.assertTrue(".intel_syntax" not in att.read_text())
+            self.assertTrue(Path(out_dir, "att1.s").exists())
+
+
+class TestPrintListing(unittest.TestCase):
+    def test_print_json_listing(self):
+        output = subprocess.check_output(
+            [
+                "gtirb-pprinter",
+                "--ir",
+                str(two_modules_gtirb),
+                "-m",
+                "0",
+                "--syntax",
+                "listing-json",
+            ]
+        ).decode(sys.stdout.encoding)
+        records = [json.loads(line) for line in output.splitlines()]
+        self.assertTrue(
+            any(
+                r["kind"] == "instruction" and r["function"] == "main"
+                for r in records
+            )
+        )
+
+    def test_print_binary_listing(self):
+        output = subprocess.check_output(
+            [
+                "gtirb-pprinter",
+                "--ir",
+                str(two_modules_gtirb),
+                "-m",
+                "0",
+                "--syntax",
+                "listing",
+            ]
+        )
+        self.assertEqual(output[:8], b"GTLIST01")
+        pos = 8
+        count = 0
+        while pos < len(output):
+            (length,) = struct.unpack_from("<I", output, pos)
+            pos += 4 + length
+            count += 1
+        self.assertEqual(pos, len(output))
+        self.assertGreater(count, 0)
+
+
+class TestSourceMap(unittest.TestCase):
+    def test_source_map_round_trip(self):
+        with tempfile.TemporaryDirectory() as out_dir:
+            asm = Path(out_dir, "out.s")
+            subprocess.check_output(
+                [
+                    "gtirb-pprinter",
+                    "--ir",
+                    str(two_modules_gtirb),
+                    "--asm",
+                    str(asm),
+                    "--source-map",
+                ]
+            )
+            source_map = str(asm) + ".map"
+            lines = asm.read_text().splitlines()
+            line = next(i + 1 for i, text in enumerate(lines) if "ret" in text)
+            by_line = subprocess.check_output(
+                ["gtirb-source-map", source_map, "--line", str(line)]
+            ).decode(sys.stdout.encoding)
+            self.assertTrue(by_line.startswith("line {},".format(line)))
+            address = by_line.split("address ")[1].split(",")[0]
+            by_address = subprocess.check_output(
+                ["gtirb-source-map", source_map, "--address", address]
+            ).decode(sys.stdout.encoding)
+            self.assertEqual(by_line, by_address)
+
+
+class TestPrintDiff(unittest.TestCase):
+    def test_diff_unchanged(self):
+        output = subprocess.check_output(
+            [
+                "gtirb-pprinter",
+                "--ir",
+                str(two_modules_gtirb),
+                "--diff",
+                str(two_modules_gtirb),
+            ]
+        ).decode(sys.stdout.encoding)
+        self.assertEqual(output, "")
+
+
+class TestPrintShards(unittest.TestCase):
+    def test_merged_shards_match_serial(self):
+        serial = subprocess.check_output(
+            ["gtirb-pprinter", "--ir", str(two_modules_gtirb), "-m", "0"]
+        ).decode(sys.stdout.encoding)
+        with tempfile.TemporaryDirectory() as out_dir:
+            shards = []
+            for i in range(3):
+                shard = Path(out_dir, "shard%d.s" % i)
+                shard.write_bytes(
+                    subprocess.check_output(
+                        [
+                            "gtirb-pprinter",
+                            "--ir",
+                            str(two_modules_gtirb),
+                            "-m",
+                            "0",
+                            "--shard",
+                            "%d/3" % i,
+                        ]
+                    )
+                )
+                shards.append(str(shard))
+            # The shards may be given in any order.
+            merged = subprocess.check_output(
+                ["gtirb-pprinter", "--merge"] + shards[::-1]
+            ).decode(sys.stdout.encoding)
+            self.assertEqual(merged, serial)
+
+            result = subprocess.run(["gtirb-pprinter", "--merge"] + shards[1:])
+            self.assertNotEqual(result.returncode, 0)
+
+
+class TestPrintServer(unittest.TestCase):
+    def test_serve_requests(self):
+        with tempfile.TemporaryDirectory() as out_dir:
+            socket_path = Path(out_dir, "pprinter.sock")
+            server = subprocess.Popen(
+                ["gtirb-pprinter", "--serve", str(socket_path), "--jobs", "2"],
+                stdout=subprocess.DEVNULL,
+            )
+            try:
+                for _ in range(100):
+                    if socket_path.exists():
+                        break
+                    time.sleep(0.1)
+                for module in ("0", "1", "0"):
+                    direct = subprocess.check_output(
+                        [
+                            "gtirb-pprinter",
+                            "--ir",
+                            str(two_modules_gtirb),
+                            "-m",
+                            module,
+                        ]
+                    ).decode(sys.stdout.encoding)
+                    served = subprocess.check_output(
+                        [
+                            "gtirb-pprinter",
+                            "--connect",
+                            str(socket_path),
+                            "--ir",
+                            str(two_modules_gtirb),
+                            "-m",
+                            module,
+                        ]
+                    ).decode(sys.stdout.encoding)
+                    self.assertEqual(served, direct)
+
+                result = subprocess.run(
+                    [
+                        "gtirb-pprinter",
+                        "--connect",
+                        str(socket_path),
+                        "--ir",
+                        str(two_modules_gtirb),
+                        "-m",
+                        "7",
+                    ],
+                    stdout=subprocess.DEVNULL,
+                )
+                self.assertNotEqual(result.returncode, 0)
+            finally:
+                server.terminate()
+                server.wait()
+
+    def test_concurrent_requests(self):
+        with tempfile.TemporaryDirectory() as out_dir:
+            socket_path = Path(out_dir, "pprinter.sock")
+            server = subprocess.Popen(
+                ["gtirb-pprinter", "--serve", str(socket_path), "--jobs", "4"],
+                stdout=subprocess.DEVNULL,
+            )
+            try:
+                for _ in range(100):
+                    if socket_path.exists():
+                        break
+                    time.sleep(0.1)
+                direct = subprocess.check_output(
+                    ["gtirb-pprinter", "--ir", str(two_modules_gtirb)]
+                )
+                # The requests arrive before the IR is loaded.
+                clients = [
+                    subprocess.Popen(
+                        [
+                            "gtirb-pprinter",
+                            "--connect",
+                            str(socket_path),
+                            "--ir",
+                            str(two_modules_gtirb),
+                        ],
+                        stdout=subprocess.PIPE,
+                    )
+                    for _ in range(4)
+                ]
+                for client in clients:
+                    served, _ = client.communicate()
+                    self.assertEqual(client.returncode, 0)
+                    self.assertEqual(served, direct)
+            finally:
+                server.terminate()
+                server.wait()
+
+
+class TestEstimate(unittest.TestCase):
+    def test_estimate_two_modules(self):
+        output = subprocess.check_output(
+            ["gtirb-pprinter", "--ir", str(two_modules_gtirb), "--estimate"]
+        ).decode(sys.stdout.encoding)
+        estimates = [
+            json.loads(line)
+            for line in output.splitlines()
+            if line.startswith("{")
+        ]
+        self.assertEqual(len(estimates), 3)
+        *modules, total = estimates
+        self.assertEqual([m["module"] for m in modules], [0, 1])
+        self.assertEqual(total["modules"], 2)
+        for field in ["instructions", "output_bytes", "symbols"]:
+            self.assertEqual(total[field], sum(m[field] for m in modules))
+        self.assertGreater(total["peak_memory_bytes"], 0)
+
+        # The prediction is within an order of magnitude of the output.
+        for module in modules:
+            assembly = subprocess.check_output(
+                [
+                    "gtirb-pprinter",
+                    "--ir",
+                    str(two_modules_gtirb),
+                    "-m",
+                    str(module["module"]),
+                ]
+            )
+            self.assertGreater(module["instructions"], 0)
+            self.assertLess(module["output_bytes"], 10 * len(assembly))
+            self.assertGreater(module["output_bytes"], len(assembly) / 10)
+
+
+class TestPrintRegions(unittest.TestCase):
+    def test_print_function(self):
+        def functions(*args):
+            output = subprocess.check_output(
+                ["gtirb-pprinter", "--ir", str(two_modules_gtirb), "-m", "0"]
+                + list(args)
+            ).decode(sys.stdout.encoding)
+            return re.findall(r"\.type (\S+), @function", output)
+
+        # The other functions printed by default are left out.
+        self.assertGreater(len(set(functions()) - {"main"}), 0)
+        self.assertEqual(functions("--function", "main"), ["main"])
+
+    def test_print_invalid_range(self):
+        result = subprocess.run(
+            [
+                "gtirb-pprinter",
+                "--ir",
+                str(two_modules_gtirb),
+                "--address-range",
+                "0x2000",
+            ]
+        )
+        self.assertNotEqual(result.returncode, 0)
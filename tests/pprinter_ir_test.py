@@ -0,0 +1,285 @@
+"""End-to-end tests printing small IRs built with the GTIRB Python API."""
+import json
+import os
+import re
+import struct
+import subprocess
+import tempfile
+import unittest
+from pathlib import Path
+
+try:
+    import gtirb
+    from gtirb_test_helpers import (
+        BssSectionFlags,
+        DataSectionFlags,
+        add_bss_block,
+        add_code_block,
+        add_data_block,
+        add_function,
+        add_section,
+        add_symbol,
+        assembles,
+        create_test_module,
+        print_asm,
+        run_pprinter,
+    )
+except ImportError:
+    raise unittest.SkipTest("the gtirb Python package is not installed")
+
+
+def create_code_module():
+    """Return an IR whose .text holds the functions main, f1 and f2, each a
+    single ret, and the module and its symbols."""
+    ir, module = create_test_module()
+    _, text = add_section(module, ".text", 0x1000)
+    symbols = [
+        add_function(module, name, add_code_block(text, b"\xc3"))
+        for name in ["main", "f1", "f2"]
+    ]
+    return ir, module, symbols
+
+
+class TestSymbolicDataRuns(unittest.TestCase):
+    def test_consecutive_pointers_share_a_directive(self):
+        ir, module, (main, f1, f2) = create_code_module()
+        _, data = add_section(module, ".data", 0x2000, DataSectionFlags)
+        table = add_data_block(
+            data, bytes(8), {0: gtirb.SymAddrConst(0, main)}
+        )
+        add_symbol(module, "table", table)
+        for symbol in [f1, f2]:
+            add_data_block(data, bytes(8), {0: gtirb.SymAddrConst(0, symbol)})
+        # A label ends the run.
+        other = add_data_block(
+            data, bytes(8), {0: gtirb.SymAddrConst(0, main)}
+        )
+        add_symbol(module, "other", other)
+        # So does a change of width.
+        add_data_block(data, bytes(4), {0: gtirb.SymAddrConst(0, f1)})
+
+        asm = print_asm(ir)
+        self.assertRegex(asm, r"table:\s*\n\s*\.quad main, f1, f2\n")
+        self.assertRegex(asm, r"other:\s*\n\s*\.quad main\n\s*\.long f1\n")
+
+
+class TestPassthrough(unittest.TestCase):
+    def test_plain_instructions_are_printed_as_bytes(self):
+        ir, module = create_test_module()
+        _, text = add_section(module, ".text", 0x1000)
+        # push rbp; mov rbp, rsp; call next; pop rbp; ret
+        add_function(
+            module,
+            "main",
+            add_code_block(
+                text, b"\x55\x48\x89\xe5\xe8\x00\x00\x00\x00\x5d\xc3"
+            ),
+        )
+
+        asm = print_asm(ir, ["--passthrough"])
+        # The labelled entry and the PC-relative call are disassembled; the
+        # runs around them are not.
+        self.assertRegex(asm, r"main:\s*\n\s*push ")
+        self.assertRegex(asm, r"\n\s*\.byte 0x48,0x89,0xe5\n\s*call ")
+        self.assertRegex(asm, r"\n\s*\.byte 0x5d,0xc3\n")
+
+        asm = print_asm(ir)
+        self.assertNotRegex(asm, r"\.byte 0x")
+
+
+class TestAssemblerFeatures(unittest.TestCase):
+    def create_ir(self):
+        ir, module = create_test_module()
+        _, text = add_section(module, ".text", 0x1000)
+        # endbr64; nop; nop; nop; ret
+        add_function(
+            module,
+            "main",
+            add_code_block(text, b"\xf3\x0f\x1e\xfa\x90\x90\x90\xc3"),
+        )
+        return ir
+
+    def test_features_are_off_by_default(self):
+        asm = print_asm(self.create_ir())
+        self.assertNotIn(".nops", asm)
+        self.assertNotIn("endbr64", asm)
+        self.assertEqual(len(re.findall(r"^\s*nop\s*$", asm, re.M)), 4)
+
+    def test_features_can_be_enabled(self):
+        asm = print_asm(self.create_ir(), ["--nops-directive", "--endbr64"])
+        self.assertRegex(asm, r"main:\s*\n\s*endbr64\s*\n\s*\.nops 3\n")
+        self.assertNotRegex(asm, r"(?m)^\s*nop\s*$")
+
+
+class TestOutputCache(unittest.TestCase):
+    def create_ir(self, address, code, data=b""):
+        ir, module = create_test_module()
+        _, text = add_section(module, ".text", address)
+        add_function(module, "main", add_code_block(text, code))
+        if data:
+            _, section = add_section(
+                module, ".data", address + 0x1000, DataSectionFlags
+            )
+            for i in range(0, len(data), 4):
+                block = add_data_block(section, data[i : i + 4])
+                add_symbol(module, "d%d" % i, block)
+        return ir
+
+    def print_cached(self, ir, cache_dir):
+        asm = print_asm(ir, ["--output-cache", cache_dir])
+        self.assertEqual(asm, print_asm(ir))
+        (blocks,) = Path(cache_dir).glob("*.blocks")
+        return blocks.stat().st_size
+
+    def test_moved_blocks_are_reused(self):
+        # push rbp; mov rbp, rsp; pop rbp; ret
+        code = b"\x55\x48\x89\xe5\x5d\xc3"
+        with tempfile.TemporaryDirectory() as cache_dir:
+            size = self.print_cached(self.create_ir(0x1000, code), cache_dir)
+            moved = self.print_cached(self.create_ir(0x2000, code), cache_dir)
+            self.assertEqual(moved, size)
+
+    def test_moved_data_is_reused(self):
+        code = b"\xc3"
+        data = bytes(range(64))
+        with tempfile.TemporaryDirectory() as cache_dir:
+            size = self.print_cached(
+                self.create_ir(0x1000, code, data), cache_dir
+            )
+            moved = self.print_cached(
+                self.create_ir(0x4000, code, data), cache_dir
+            )
+            self.assertEqual(moved, size)
+
+    def test_address_dependent_blocks_are_not_moved(self):
+        # call next; ret, with a non-symbolic call target
+        code = b"\xe8\x00\x00\x00\x00\xc3"
+        with tempfile.TemporaryDirectory() as cache_dir:
+            size = self.print_cached(self.create_ir(0x1000, code), cache_dir)
+            moved = self.print_cached(self.create_ir(0x2000, code), cache_dir)
+            self.assertGreater(moved, size)
+            again = self.print_cached(self.create_ir(0x2000, code), cache_dir)
+            self.assertEqual(again, moved)
+
+
+class TestPrintRegions(unittest.TestCase):
+    def test_outside_symbols_are_set(self):
+        ir, module = create_test_module()
+        _, text = add_section(module, ".text", 0x1000)
+        # call f1; ret
+        main = add_code_block(text, b"\xe8\x00\x00\x00\x00\xc3")
+        add_function(module, "main", main)
+        f1 = add_function(module, "f1", add_code_block(text, b"\xc3"))
+        text.symbolic_expressions[1] = gtirb.SymAddrConst(0, f1)
+
+        asm = print_asm(ir, ["--function", "main"])
+        self.assertRegex(asm, r"main:\s*\n\s*call f1\n")
+        self.assertNotIn("f1:", asm)
+        self.assertIn(".set f1, 0x1006\n", asm)
+        with tempfile.TemporaryDirectory() as tmpdir:
+            path = os.path.join(tmpdir, "main.s")
+            with open(path, "w") as f:
+                f.write(asm)
+            self.assertTrue(assembles(path))
+
+
+class TestLayout(unittest.TestCase):
+    def add_fallthrough(self, ir, source, target):
+        label = gtirb.Edge.Label(type=gtirb.Edge.Type.Fallthrough)
+        ir.cfg.add(gtirb.Edge(source, target, label))
+
+    def test_fallthrough_intervals_are_placed_together(self):
+        ir, module = create_test_module()
+        text, first = add_section(module, ".text", None)
+        tail = add_code_block(first, b"\xc3")
+        add_symbol(module, "tail", tail)
+        # nop, falling through to tail in the first interval
+        main = add_code_block(gtirb.ByteInterval(section=text), b"\x90")
+        add_function(module, "main", main, [tail])
+        add_function(
+            module,
+            "other",
+            add_code_block(gtirb.ByteInterval(section=text), b"\xc3"),
+        )
+        self.add_fallthrough(ir, main, tail)
+
+        asm = print_asm(ir)
+        self.assertRegex(asm, r"main:\s*\n\s*nop\s*\n\s*tail:\s*\n\s*ret")
+        self.assertIn("other:", asm)
+
+    def test_fallthrough_into_another_section_is_rejected(self):
+        ir, module = create_test_module()
+        _, text = add_section(module, ".text", None)
+        _, other = add_section(module, ".text2", None)
+        main = add_code_block(text, b"\x90")
+        add_function(module, "main", main)
+        self.add_fallthrough(ir, main, add_code_block(other, b"\xc3"))
+
+        with self.assertRaises(subprocess.CalledProcessError):
+            print_asm(ir)
+
+
+class TestListing(unittest.TestCase):
+    def create_ir(self):
+        """Return an IR with a symbol at the end of .bss, which is also the
+        end of the module."""
+        ir, module, _ = create_code_module()
+        _, bss = add_section(module, ".bss", 0x2000, BssSectionFlags)
+        add_symbol(module, "_end", add_bss_block(bss, 16), at_end=True)
+        return ir
+
+    def test_json_listing_holds_records_only(self):
+        output = run_pprinter(self.create_ir(), ["--syntax", "listing-json"])
+        records = [json.loads(line) for line in output.splitlines()]
+        self.assertIn("main", [r["function"] for r in records])
+
+    def test_binary_listing_holds_records_only(self):
+        with tempfile.TemporaryDirectory() as tmpdir:
+            path = os.path.join(tmpdir, "test.gtirb")
+            self.create_ir().save_protobuf(path)
+            output = subprocess.check_output(
+                ["gtirb-pprinter", "--ir", path, "--syntax", "listing"]
+            )
+        self.assertEqual(output[:8], b"GTLIST01")
+        pos = 8
+        while pos < len(output):
+            (length,) = struct.unpack_from("<I", output, pos)
+            pos += 4 + length
+        self.assertEqual(pos, len(output))
+        self.assertNotIn(b"_end:", output)
+
+
+class TestDiff(unittest.TestCase):
+    def create_ir(self, functions):
+        ir, module = create_test_module()
+        _, text = add_section(module, ".text", 0x1000)
+        for name, code in functions:
+            add_function(module, name, add_code_block(text, code))
+        return ir
+
+    def test_changed_added_and_removed_functions(self):
+        old = self.create_ir(
+            [("main", b"\xc3"), ("f1", b"\xc3"), ("f2", b"\xc3")]
+        )
+        # main gains a nop, f1 is removed, f3 is added and f2 moves.
+        new = self.create_ir(
+            [("main", b"\x90\xc3"), ("f2", b"\xc3"), ("f3", b"\xc3")]
+        )
+        with tempfile.TemporaryDirectory() as tmpdir:
+            old_path = os.path.join(tmpdir, "old.gtirb")
+            new_path = os.path.join(tmpdir, "new.gtirb")
+            old.save_protobuf(old_path)
+            new.save_protobuf(new_path)
+            output = subprocess.check_output(
+                ["gtirb-pprinter", "--ir", new_path, "--diff", old_path]
+            ).decode()
+
+        self.assertRegex(output, r"--- a/main\n\+\+\+ b/main\n@@ -\d")
+        self.assertRegex(output, r"\n\+\s*nop\n")
+        self.assertRegex(
+            output, r"--- a/f1\n\+\+\+ /dev/null\n@@ -1,\d+ \+0,0"
+        )
+        self.assertRegex(
+            output, r"--- /dev/null\n\+\+\+ b/f3\n@@ -0,0 \+1,"
+        )
+        self.assertNotIn("f2", output)
@@ -0,0 +1,71 @@
+import os
+import subprocess
+import sys
+import tempfile
+import unittest
+from pathlib import Path
+
+try:
+    import gtirb_pprint
+except ImportError:
+    gtirb_pprint = None
+
+two_modules_gtirb = Path("tests", "two_modules.gtirb")
+
+
+@unittest.skipIf(gtirb_pprint is None, "the Python binding is not available")
+class TestPythonBinding(unittest.TestCase):
+    def test_print_matches_command_line(self):
+        ir = gtirb_pprint.IR.load(str(two_modules_gtirb))
+        session = gtirb_pprint.Session()
+        for module in range(len(ir.module_names)):
+            expected = subprocess.check_output(
+                [
+                    "gtirb-pprinter",
+                    "--ir",
+                    str(two_modules_gtirb),
+                    "-m",
+                    str(module),
+                ]
+            ).decode(sys.stdout.encoding)
+            # Printing twice reuses the indexes of the module.
+            self.assertEqual(session.print(ir, module), expected)
+            self.assertEqual(session.print(ir, module), expected)
+
+    def test_print_from_bytes_to_fd(self):
+        ir = gtirb_pprint.IR.from_bytes(two_modules_gtirb.read_bytes())
+        session = gtirb_pprint.Session(format="elf", syntax="intel")
+        session.select_function("main")
+        with tempfile.TemporaryFile() as f:
+            session.print_to_fd(ir, f.fileno(), module=0)
+            f.seek(0)
+            text = f.read().decode()
+        self.assertIn(".globl main", text)
+        self.assertEqual(text, session.print(ir, 0))
+
+    def test_errors(self):
+        ir = gtirb_pprint.IR.load(str(two_modules_gtirb))
+        session = gtirb_pprint.Session()
+        with self.assertRaises(gtirb_pprint.PrinterError):
+            session.print(ir, module=2)
+        with self.assertRaises(gtirb_pprint.PrinterError):
+            session.set_target("elf", "no-such-syntax")
+        with self.assertRaises(gtirb_pprint.PrinterError):
+            gtirb_pprint.IR.load(os.devnull)
+
+    def test_null_arguments(self):
+        lib = gtirb_pprint._lib
+        session = gtirb_pprint.Session()
+        # NULL arguments fail with a message instead of crashing.
+        self.assertIsNone(lib.gtirb_pprint_ir_load(None))
+        self.assertIn(b"path", lib.gtirb_pprint_last_error())
+        self.assertEqual(
+            lib.gtirb_pprint_session_select_function(session._handle, None),
+            -1,
+        )
+        self.assertEqual(lib.gtirb_pprint_ir_module_count(None), -1)
+        self.assertEqual(lib.gtirb_pprint_print(None, None, 0, None, None), -1)
+
+
+if __name__ == "__main__":
+    unittest.main()